@@ -0,0 +1,289 @@
+/*
+
+Copyright (C) 2018-2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This file is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Noddy benchmarks of the memory orders used for mark_ptr_type operations,
+derived from castest.
+    1) maximum contention CAS, all threads push nodes to the head of a list.
+    2) traversal of a list, loading next pointers.
+    3) maximum contention CAS push, tagged_mark_ptr vs mark_ptr_type.
+    4) free list pop and push with node recycling (ABA prone),
+       using tagged_mark_ptr generations.
+Sanitizers distort the numbers, build without them, e.g.
+    make SANITIZE= bin/casbench
+*/
+#include "mark_ptr_type.hpp"
+#include "tagged_mark_ptr.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::mark_ptr_type;
+using   benedias::concurrent::tagged_mark_ptr;
+
+struct  B
+{
+    mark_ptr_type<B>  next;
+    std::size_t v=0;
+};
+
+struct  TB
+{
+    mark_ptr_type<TB>  next;
+    std::size_t v=0;
+};
+
+constexpr   std::size_t num_nodes = 20000;
+constexpr   std::size_t num_traversals = 20;
+
+const char* order_name(std::memory_order order)
+{
+    switch(order)
+    {
+        case std::memory_order_relaxed: return "relaxed";
+        case std::memory_order_acquire: return "acquire";
+        case std::memory_order_release: return "release";
+        case std::memory_order_acq_rel: return "acq_rel";
+        case std::memory_order_seq_cst: return "seq_cst";
+        default: return "?";
+    }
+}
+
+// Run fn on num_threads threads, starting them together,
+// return elapsed time in microseconds.
+template <typename F> double run_threads(std::size_t num_threads, F fn)
+{
+    std::atomic<bool>   go{false};
+    std::atomic<std::size_t>   ready{0};
+    std::vector<std::thread> threads;
+    for(std::size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&, t]{
+            ++ready;
+            while(!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            fn(t);
+        });
+    }
+    while(ready.load() < num_threads)
+    {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for(auto &th : threads)
+    {
+        th.join();
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void bench_push(std::size_t num_threads, std::memory_order order)
+{
+    B  head;
+    std::vector<std::vector<B>> nodes(num_threads, std::vector<B>(num_nodes));
+    std::atomic<std::size_t> cas_count{0};
+
+    double us = run_threads(num_threads, [&](std::size_t t){
+        std::size_t count = 0;
+        for(auto& b: nodes[t])
+        {
+            B* expected;
+            do
+            {
+                expected = head.next.load(std::memory_order_relaxed);
+                b.next.store(expected, std::memory_order_relaxed);
+                ++count;
+            }while(!head.next.CAS(expected, &b, order));
+        }
+        cas_count += count;
+    });
+
+    std::size_t len = 0;
+    for(auto b=head.next(); nullptr != b; b=b->next())
+    {
+        ++len;
+    }
+    if (len != num_threads * num_nodes)
+    {
+        std::cout << "Failed! list length " << len << std::endl;
+    }
+    std::cout << "push    CAS " << order_name(order) << "\t" << num_threads << " threads "
+        << (len / us) << " ops/us, "
+        << (cas_count * 100) / len << "% CAS attempts" << std::endl;
+}
+
+void bench_traverse(std::size_t num_threads, std::memory_order order)
+{
+    B  head;
+    std::vector<B> nodes(num_nodes);
+    for(auto& b: nodes)
+    {
+        b.next.store(head.next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        head.next.store(&b, std::memory_order_relaxed);
+    }
+
+    std::atomic<std::size_t> total{0};
+    double us = run_threads(num_threads, [&](std::size_t t){
+        std::size_t sum = 0;
+        for(std::size_t i = 0; i < num_traversals; ++i)
+        {
+            for(auto b=head.next.load(order); nullptr != b; b=b->next.load(order))
+            {
+                ++sum;
+            }
+        }
+        total += sum;
+    });
+
+    if (total != num_threads * num_nodes * num_traversals)
+    {
+        std::cout << "Failed! traversal count " << total << std::endl;
+    }
+    std::cout << "traverse load " << order_name(order) << "\t" << num_threads << " threads "
+        << (total / us) << " nodes/us" << std::endl;
+}
+
+void bench_tagged_push(std::size_t num_threads, std::memory_order order)
+{
+    tagged_mark_ptr<TB>  head;
+    std::vector<std::vector<TB>> nodes(num_threads, std::vector<TB>(num_nodes));
+    std::atomic<std::size_t> cas_count{0};
+
+    double us = run_threads(num_threads, [&](std::size_t t){
+        std::size_t count = 0;
+        for(auto& b: nodes[t])
+        {
+            TB* expected;
+            do
+            {
+                expected = head.load(std::memory_order_relaxed);
+                b.next.store(expected, std::memory_order_relaxed);
+                ++count;
+            }while(!head.CAS(expected, &b, order));
+        }
+        cas_count += count;
+    });
+
+    std::size_t len = 0;
+    for(auto b=head.load(); nullptr != b; b=b->next())
+    {
+        ++len;
+    }
+    if (len != num_threads * num_nodes || head.generation() != len)
+    {
+        std::cout << "Failed! tagged list length " << len
+            << " generation " << head.generation() << std::endl;
+    }
+    std::cout << "push    tagged CAS " << order_name(order) << "\t" << num_threads << " threads "
+        << (len / us) << " ops/us, "
+        << (cas_count * 100) / len << "% CAS attempts" << std::endl;
+}
+
+// Free list of recycled nodes, every thread repeatedly pops a node and
+// pushes it back, a pop CAS with a stale head->next is the classic ABA
+// failure, the generation check in CAS_gen prevents it.
+void bench_tagged_freelist(std::size_t num_threads)
+{
+    constexpr std::size_t rounds = num_nodes * 4;
+    tagged_mark_ptr<TB>  head;
+    std::vector<TB> nodes(num_threads * 4);
+    for(auto& b: nodes)
+    {
+        b.next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        head.store(&b, std::memory_order_relaxed);
+    }
+
+    double us = run_threads(num_threads, [&](std::size_t t){
+        for(std::size_t i = 0; i < rounds; ++i)
+        {
+            TB* b;
+            bool marked;
+            uintptr_t gen;
+            do
+            {
+                b = head.load(&marked, &gen);
+                if (nullptr == b)
+                {
+                    break;
+                }
+            }while(!head.CAS_gen(b, gen, b->next.load(std::memory_order_relaxed)));
+            if (nullptr == b)
+            {
+                continue;
+            }
+            // The node is now owned by this thread.
+            ++b->v;
+            TB* expected;
+            do
+            {
+                expected = head.load(std::memory_order_relaxed);
+                b->next.store(expected, std::memory_order_relaxed);
+            }while(!head.CAS(expected, b, std::memory_order_release));
+        }
+    });
+
+    std::size_t len = 0;
+    std::size_t total = 0;
+    for(auto b=head.load(); nullptr != b && len <= nodes.size(); b=b->next())
+    {
+        ++len;
+        total += b->v;
+    }
+    if (len != nodes.size() || total > num_threads * rounds)
+    {
+        std::cout << "Failed! free list length " << len << " of " << nodes.size()
+            << ", pops " << total << std::endl;
+    }
+    std::cout << "freelist tagged pop/push\t" << num_threads << " threads "
+        << (total / us) << " ops/us" << std::endl;
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    std::size_t num_threads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    if (argc > 1)
+    {
+        num_threads = strtoul(argv[1], nullptr, 0);
+    }
+
+    for(auto order: {std::memory_order_seq_cst, std::memory_order_acq_rel, std::memory_order_release})
+    {
+        bench_push(num_threads, order);
+    }
+    for(auto order: {std::memory_order_seq_cst, std::memory_order_acquire, std::memory_order_relaxed})
+    {
+        bench_traverse(num_threads, order);
+    }
+    for(auto order: {std::memory_order_acq_rel, std::memory_order_release})
+    {
+        bench_tagged_push(num_threads, order);
+    }
+    bench_tagged_freelist(num_threads);
+    std::cout << "All Done. " << std::endl;
+    return 0;
+}
@@ -21,6 +21,8 @@ operations.
 Needs further work, checking in for now so that it doesn't get lost.
 */
 #include "mark_ptr_type.hpp"
+#include "tagged_mark_ptr.hpp"
+#include <cassert>
 #include <clocale>
 #include <cstdio>
 #include <cstdlib>
@@ -33,6 +35,7 @@ Needs further work, checking in for now so that it doesn't get lost.
 #include <chrono>
 
 using   benedias::concurrent::mark_ptr_type;
+using   benedias::concurrent::tagged_mark_ptr;
 using namespace std::chrono_literals;
 
 struct  B
@@ -238,10 +241,104 @@ void check_test_1(B& head, std::vector<test_thread_args>& th_args, std::vector<s
 {
 }
 
+// tagged_mark_ptr, generation (ABA) semantics, the mark bit and
+// CAS failure behaviour.
+void test_tagged_mark_ptr()
+{
+    struct N { int v; };
+    N a{1}, b{2}, c{3}, d{4};
+    bool mark = true;
+    uintptr_t gen = 1;
+
+    tagged_mark_ptr<N> p;
+    assert(nullptr == p.load(&mark, &gen));
+    assert(!mark && 0 == gen);
+    p.store(&a);
+    assert(&a == p.load(&mark, &gen));
+    assert(!mark && 1 == gen);
+
+    // A failed CAS changes neither the pointer nor the generation.
+    assert(!p.CAS(&b, &c));
+    assert(!p.CAS(&a, true, &c, false));
+    assert(&a == p.load(&mark, &gen));
+    assert(!mark && 1 == gen);
+
+    // ABA, the pointer changes and changes back, a CAS_gen with the
+    // stale generation fails, a plain CAS succeeds.
+    uintptr_t stale = gen;
+    assert(p.CAS(&a, &b));
+    assert(p.CAS(&b, &a));
+    assert(&a == p.load(&mark, &gen));
+    assert(stale + 2 == gen);
+    assert(!p.CAS_gen(&a, stale, &c));
+    assert(&a == p.load(&mark, &gen));
+    assert(stale + 2 == gen);
+    assert(p.CAS_gen(&a, gen, &c));
+    assert(&c == p.load(&mark, &gen));
+    assert(stale + 3 == gen);
+
+    // The mark, set once, preserved by store, and an unmarked expected
+    // value does not match a marked pointer.
+    assert(p.mark());
+    assert(&c == p.load(&mark, &gen));
+    assert(mark && stale + 4 == gen);
+    assert(!p.mark());
+    assert(stale + 4 == p.generation());
+    assert(!p.CAS(&c, &d));
+    assert(!p.CAS_gen(&c, false, gen, &d, false));
+    assert(p.CAS_gen(&c, true, gen, &d, true));
+    assert(&d == p.load(&mark, &gen));
+    assert(mark && stale + 5 == gen);
+    p.store(&a);
+    assert(&a == p.load(&mark, &gen));
+    assert(mark && stale + 6 == gen);
+    assert(p.CAS(&a, true, &b, false));
+    assert(&b == p.load(&mark, &gen));
+    assert(!mark && stale + 7 == gen);
+
+    // reset clears the pointer and mark but not the generation history.
+    stale = gen;
+    p.reset();
+    assert(nullptr == p.load(&mark, &gen));
+    assert(!mark && stale + 1 == gen);
+    assert(!p.CAS_gen(nullptr, stale, &a));
+    assert(p.CAS_gen(nullptr, gen, &a));
+
+    // Concurrent CAS_gen, every success increments the generation once,
+    // failures leave it unchanged.
+    constexpr unsigned n_threads = 4;
+    constexpr unsigned n_ops = 1000;
+    tagged_mark_ptr<N> q(&a);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < n_threads; ++t)
+    {
+        workers.emplace_back([&q, &a, &b]() {
+            for (unsigned i = 0; i < n_ops; ++i)
+            {
+                bool m;
+                uintptr_t g;
+                N* cur;
+                do
+                {
+                    cur = q.load(&m, &g);
+                }while(!q.CAS_gen(cur, g, cur == &a ? &b : &a));
+            }
+        });
+    }
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+    assert(n_threads * n_ops == q.generation());
+    assert(((n_threads * n_ops) % 2 ? &b : &a) == q.load());
+    std::cout << "tagged_mark_ptr checks passed" << std::endl;
+}
+
 int main( int argc, char* argv[] )
 {
     std::setlocale(LC_ALL, "en_US.UTF-8");
     std::srand(std::time(nullptr)); // use current time as seed for random generator
+    test_tagged_mark_ptr();
 
     std::vector<test_thread_args> th_args;
     std::vector<std::thread> threads;
@@ -15,7 +15,9 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with this file.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <map>
 #include <mutex>
+#include <thread>
 #include "hazard_pointer.hpp"
 
 namespace benedias {
@@ -39,6 +41,27 @@ void hazard_pointer_global_init()
     }
 }
 
+std::shared_ptr<hazptr_domain> hazptr_global_domain()
+{
+    static std::shared_ptr<hazptr_domain> global_domain = hazptr_domain::make();
+    return global_domain;
+}
+
+std::shared_ptr<hazptr_domain> hazptr_group_domain(const std::string& name)
+{
+    // Lookups are blocking, they are expected to occur when containers
+    // are created.
+    static std::mutex   registry_mutex;
+    static std::map<std::string, std::shared_ptr<hazptr_domain>>  registry;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto& dom = registry[name];
+    if (!dom)
+    {
+        dom = hazptr_domain::make();
+    }
+    return dom;
+}
+
 // hazptr_pool member functions
         hazptr_pool::hazptr_pool(std::size_t blocksize):blk_size(blocksize),hp_count(blocksize * HAZPTR_POOL_BLOCKS)
         {
@@ -188,6 +211,9 @@ void hazard_pointer_global_init()
             // of the list. 
             // So it is safe to iterate of the list as we have it now,
             // and calcuate the number of hazard pointers.
+            // The fence orders the unlinking of retired objects before
+            // the reads of the hazard pointers.
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
             for(auto p = pools; nullptr != p; p=p->next)
             {
                 size += p->count();
@@ -232,7 +258,7 @@ void hazard_pointer_global_init()
                     p < reinterpret_cast<uintptr_t*>(end);
                     ++p)
             {
-                *p &= mark_bits_maskoff;
+                *p &= mark_ptr_value_mask;
             }
         }
 
@@ -257,7 +283,7 @@ void hazard_pointer_global_init()
                     pool->next = *phead;
                 }while(!__atomic_compare_exchange(phead, &pool->next, &pool,
                             false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
-                hp_count += pool->count(); 
+                __atomic_add_fetch(&hp_count, pool->count(), __ATOMIC_RELEASE);
             }
 
             /// Attempt to fulfil a reservation request by requesting
@@ -273,7 +299,7 @@ void hazard_pointer_global_init()
             generic_hazptr_t* hazptr_domain::pools_reserve(hazptr_pool* head, std::size_t blocklen)
             {
                 generic_hazptr_t* reservation = nullptr;
-                for(auto p = head; nullptr != p && nullptr == reservation; )
+                for(auto p = head; nullptr != p && nullptr == reservation; p = p->next)
                 {
                     reservation = p->reserve_impl(blocklen);
                 }
@@ -307,11 +333,11 @@ void hazard_pointer_global_init()
             {
                 // The domain is being destroyed, so all items scheduled for delete
                 // should be deleted first.
-//                collect(); type agnostic so we cannot realistically delete anything
-
-                //This class is type agnostic, so cannot delete objects pointed to,
-                //however we have restricted construction to the hazard_pointer_domain
-                //which always run a collect cycle on destruction.
+                // This class is type agnostic, objects are deleted by the
+                // reclaimer queued with each object.
+                // The last reference to the domain has gone, so there are
+                // no hazard pointers live and everything can be reclaimed.
+                collect();
 
                 assert(nullptr == delete_head);
                 //Deep hole :-(.
@@ -366,6 +392,8 @@ void hazard_pointer_global_init()
             {
                 //FIXME: use non-blocking allocator.
                 auto del_entry = new hazp_delete_node(item_ptr, reclaimer);
+                __atomic_add_fetch(&pending_count, 1, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&pending_size, reclaimer.object_size(item_ptr), __ATOMIC_RELAXED);
                 push_delete_node(del_entry);
             }
 
@@ -379,6 +407,8 @@ void hazard_pointer_global_init()
                 {
                     if (nullptr != items_ptr[x])
                     {
+                        __atomic_add_fetch(&pending_count, 1, __ATOMIC_RELAXED);
+                        __atomic_add_fetch(&pending_size, reclaimer.object_size(items_ptr[x]), __ATOMIC_RELAXED);
                         //FIXME: use non-blocking allocator.
                         push_delete_node(new hazp_delete_node(items_ptr[x], reclaimer));
                         items_ptr[x] = nullptr;
@@ -410,6 +440,49 @@ void hazard_pointer_global_init()
                     collect();
             }
 
+            void hazptr_domain::set_pending_limit(std::size_t max_count, std::size_t max_size,
+                    hazptr_backpressure policy, std::chrono::microseconds wait)
+            {
+                max_pending_count.store(max_count, std::memory_order_relaxed);
+                max_pending_size.store(max_size, std::memory_order_relaxed);
+                backpressure.store(policy, std::memory_order_relaxed);
+                max_wait.store(wait, std::memory_order_relaxed);
+            }
+
+            /// Unreclaimed memory can only exceed the limits if collect cycles
+            /// fail to reclaim objects, typically because a thread has stalled
+            /// holding hazard pointers, so helping may not succeed.
+            hazptr_status hazptr_domain::throttle()
+            {
+                if (!over_limit())
+                {
+                    return hazptr_status::ok;
+                }
+
+                switch(backpressure.load(std::memory_order_relaxed))
+                {
+                    case hazptr_backpressure::help:
+                        collect();
+                        break;
+                    case hazptr_backpressure::wait:
+                        {
+                            auto deadline = std::chrono::steady_clock::now()
+                                + max_wait.load(std::memory_order_relaxed);
+                            collect();
+                            while(over_limit() && std::chrono::steady_clock::now() < deadline)
+                            {
+                                std::this_thread::yield();
+                                collect();
+                            }
+                        }
+                        break;
+                    case hazptr_backpressure::fail:
+                        break;
+                }
+
+                return over_limit() ? hazptr_status::over_limit : hazptr_status::ok;
+            }
+
             /// Delete objects on the delete list if no live pointers to
             /// those objects exist.
             /// Serialising the execution of this function, is not required,
@@ -450,7 +523,10 @@ void hazard_pointer_global_init()
                     {
                         // delink
                         *pprev = cur->next;
+                        __atomic_sub_fetch(&pending_size,
+                                cur->reclaimer.object_size(cur->payload), __ATOMIC_RELAXED);
                         cur->reclaimer.reclaim_object(cur->payload);
+                        __atomic_sub_fetch(&pending_count, 1, __ATOMIC_RELAXED);
                         delete cur;
                     }
                     else
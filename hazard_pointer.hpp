@@ -26,6 +26,9 @@ along with this file.  If not, see <http://www.gnu.org/licenses/>.
 #include <utility>
 #include <memory>
 #include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
 #include "mark_ptr_type.hpp"
 
 #if 0
@@ -88,6 +91,18 @@ along with this file.  If not, see <http://www.gnu.org/licenses/>.
 ///  constant, actual deletions are only performed when the number of deletions is
 ///  > than the total number of hazard pointers.
 ///
+///  Unreclaimed memory on a domain can be bounded, see
+///  hazptr_domain::set_pending_limit. When the number of objects (or bytes)
+///  queued on the domain delete list exceeds the limit, mutators are
+///  throttled according to the hazptr_backpressure policy, they either help
+///  reclaim, wait briefly for reclamation to catch up, or are told to fail
+///  fast via hazptr_status::over_limit.
+///
+///  Containers of different types can share a single type agnostic hazptr_domain,
+///  every thread then uses a single type agnostic hazptr_context per domain,
+///  (see hazptr_context::local), with one reservation of hazard pointers and
+///  one retire buffer serving all the containers.
+///
 ///  Notable features of this scheme and implementation
 ///         - hazard pointer pool creation is linked to creation of hazard pointer 
 ///             contexts.
@@ -178,7 +193,6 @@ namespace benedias {
             }
         };
 
-        // constexpr uintptr_t mark_bits_maskoff = ~1;
 
         /// Class to snapshot the set of hazard pointers in a domain at a given
         /// point in time.
@@ -285,6 +299,35 @@ namespace benedias {
         struct domain_reclaimer
         {
             virtual void reclaim_object(generic_hazptr_t item_ptr)=0;
+
+            /// Size in bytes of the object pointed to, used to account for
+            /// unreclaimed memory on a domain.
+            virtual std::size_t object_size(generic_hazptr_t item_ptr)
+            {
+                return 0;
+            }
+        };
+
+        /// Status returned to mutators retiring objects on to a domain.
+        enum class hazptr_status
+        {
+            /// Unreclaimed memory is within the domain limit.
+            ok,
+            /// Unreclaimed memory exceeds the domain limit, the mutator
+            /// should back off.
+            over_limit
+        };
+
+        /// Policy applied when unreclaimed memory on a domain exceeds the limit.
+        enum class hazptr_backpressure
+        {
+            /// Mutator runs a collect cycle.
+            help,
+            /// Mutator runs collect cycles, yielding in between,
+            /// until the domain is within its limit or the wait time expires.
+            wait,
+            /// Mutator does no work, and is returned hazptr_status::over_limit.
+            fail
         };
 
         /// A type agnostic hazard pointer domain defines the set of pointers protected
@@ -338,6 +381,20 @@ namespace benedias {
             // deletes.
             int    delete_count=0;
 
+            // Number of objects and bytes on the delete list.
+            // Unlike delete_count these are only decremented when objects
+            // are actually reclaimed.
+            std::size_t pending_count=0;
+            std::size_t pending_size=0;
+
+            // Limits on unreclaimed memory, 0 means no limit.
+            // Atomic, the limits may be changed while mutators read them,
+            // the global domain is shared by the whole process.
+            std::atomic<std::size_t> max_pending_count{0};
+            std::atomic<std::size_t> max_pending_size{0};
+            std::atomic<hazptr_backpressure>   backpressure{hazptr_backpressure::help};
+            std::atomic<std::chrono::microseconds>   max_wait{std::chrono::microseconds(100)};
+
             /// For lock-free operation, we push new hazard pointer pools
             /// to head of the list (pool) atomically.
             void pools_new(hazptr_pool** phead, std::size_t blocklen);
@@ -379,9 +436,12 @@ namespace benedias {
 
             template <typename U, class Allocator> friend class hazard_pointer_domain;
 
+            public:
             /// Create a hazard pointer domain object. 
             /// The return type is std::shared ptr for safe access across
             /// multiple thread scopes.
+            /// A domain created this way can be shared by containers of
+            /// different types, see hazptr_context.
             /// \return shared pointer to the domain object.
             static std::shared_ptr<hazptr_domain> make()
             {
@@ -393,7 +453,6 @@ namespace benedias {
                 return std::make_shared<makeT>();
             }
 
-            public:
             /// Fulfill a reservation request using the set of hazard pointer pools
             /// creating a new instance of hazard pointer pool if required.
             /// \@param blocklen - the number of hazard pointers required.
@@ -426,6 +485,46 @@ namespace benedias {
 
             void collect_if_required();
 
+            /// Bound the unreclaimed memory for this domain.
+            /// \@param max_count - maximum number of objects pending reclamation,
+            ///         0 for no limit.
+            /// \@param max_size - maximum number of bytes pending reclamation,
+            ///         0 for no limit.
+            /// \@param policy - action taken by mutators when a limit is exceeded.
+            /// \@param wait - maximum time a mutator waits, for the wait policy.
+            /// May be called while the domain is in use, each limit takes
+            /// effect independently for subsequent mutations.
+            void set_pending_limit(std::size_t max_count, std::size_t max_size,
+                    hazptr_backpressure policy=hazptr_backpressure::help,
+                    std::chrono::microseconds wait=std::chrono::microseconds(100));
+
+            inline std::size_t pending_objects() const
+            {
+                return __atomic_load_n(&pending_count, __ATOMIC_RELAXED);
+            }
+
+            inline std::size_t pending_bytes() const
+            {
+                return __atomic_load_n(&pending_size, __ATOMIC_RELAXED);
+            }
+
+            /// \@return true if unreclaimed memory exceeds the domain limits.
+            inline bool over_limit() const
+            {
+                std::size_t max_count = max_pending_count.load(std::memory_order_relaxed);
+                std::size_t max_size = max_pending_size.load(std::memory_order_relaxed);
+                return (0 != max_count && pending_objects() > max_count)
+                    || (0 != max_size && pending_bytes() > max_size);
+            }
+
+            /// Apply the backpressure policy if unreclaimed memory exceeds
+            /// the domain limits.
+            /// Mutators should call this function after retiring objects,
+            /// or before mutating, to fail fast.
+            /// \@return hazptr_status::over_limit if the domain is still
+            /// over its limits.
+            hazptr_status throttle();
+
             inline hazptrs_snapshot snapshot()
             {
                 // std::move prevents copy elision
@@ -435,6 +534,16 @@ namespace benedias {
         };
 
 
+        /// Process wide type agnostic hazard pointer domain,
+        /// shared by default by containers.
+        std::shared_ptr<hazptr_domain> hazptr_global_domain();
+
+        /// Type agnostic hazard pointer domain shared by a named group of
+        /// containers, created on first use.
+        /// Grouping containers limits the size of snapshots and the
+        /// reach of a stalled thread, while keeping per container costs low.
+        std::shared_ptr<hazptr_domain> hazptr_group_domain(const std::string& name);
+
         /// A hazard pointer domain defines the set of pointers protected
         /// and checked against for safe memory reclamation.
         /// Typically a hazard pointer domain instance will be associated with
@@ -452,6 +561,10 @@ namespace benedias {
                 hp_dom = hazptr_domain::make();
             }
 
+            explicit hazard_pointer_domain(std::shared_ptr<hazptr_domain> dom):hp_dom(dom)
+            {
+            }
+
             /// Since the instances of domain pointers are only accessible, 
             /// through shared pointers, this will be run when the last live
             /// reference (shared pointer) to this domain is destroyed.
@@ -482,6 +595,18 @@ namespace benedias {
                 return std::make_shared<makeT>();
             }
 
+            /// Create a hazard pointer domain object bound to a shared
+            /// type agnostic domain.
+            /// \return shared pointer to the domain object.
+            static std::shared_ptr<hazard_pointer_domain<T>> make(std::shared_ptr<hazptr_domain> dom)
+            {
+                struct makeT:public hazard_pointer_domain<T>
+                {
+                    explicit makeT(std::shared_ptr<hazptr_domain> d):hazard_pointer_domain<T>(d) {}
+                };
+                return std::make_shared<makeT>(dom);
+            }
+
             /// Fulfill a reservation request using the set of hazard pointer pools
             /// creating a new instance of hazard pointer pool if required.
             /// \@param blocklen - the number of hazard pointers required.
@@ -505,21 +630,46 @@ namespace benedias {
             /// Add a pointer to the delete list.
             /// Creates and pushes a delete node onto the delete list,
             /// lock free and wait free.
-            inline void enqueue_for_delete(T* item_ptr, bool can_collect=true)
+            /// \@return status of unreclaimed memory on the domain,
+            /// after applying the backpressure policy if can_collect is true.
+            inline hazptr_status enqueue_for_delete(T* item_ptr, bool can_collect=true)
             {
                 hp_dom->enqueue_for_delete(reinterpret_cast<generic_hazptr_t>(item_ptr), *this);
-                if (can_collect)
-                    hp_dom->collect_if_required();
+                if (!can_collect)
+                    return hp_dom->over_limit() ? hazptr_status::over_limit : hazptr_status::ok;
+                hp_dom->collect_if_required();
+                return hp_dom->throttle();
             }
 
             /// Add a set of pointers to the delete list.
             /// Creates and pushes a delete nodes onto the delete list,
             /// lock free and wait free.
-            inline void enqueue_for_delete(T** items_ptr, std::size_t count, bool can_collect=true)
+            inline hazptr_status enqueue_for_delete(T** items_ptr, std::size_t count, bool can_collect=true)
             {
                 hp_dom->enqueue_for_delete(reinterpret_cast<generic_hazptr_t*>(items_ptr), *this, count);
-                if (can_collect)
-                    hp_dom->collect_if_required();
+                if (!can_collect)
+                    return hp_dom->over_limit() ? hazptr_status::over_limit : hazptr_status::ok;
+                hp_dom->collect_if_required();
+                return hp_dom->throttle();
+            }
+
+            /// See hazptr_domain::set_pending_limit
+            inline void set_pending_limit(std::size_t max_count, std::size_t max_size,
+                    hazptr_backpressure policy=hazptr_backpressure::help,
+                    std::chrono::microseconds wait=std::chrono::microseconds(100))
+            {
+                hp_dom->set_pending_limit(max_count, max_size, policy, wait);
+            }
+
+            /// See hazptr_domain::throttle
+            inline hazptr_status throttle()
+            {
+                return hp_dom->throttle();
+            }
+
+            inline std::size_t pending_objects() const
+            {
+                return hp_dom->pending_objects();
             }
 
             /// Delete objects on the delete list if no live pointers to
@@ -542,6 +692,11 @@ namespace benedias {
                 allocatorT.deallocate(ptr, 1);
             }
 
+            std::size_t object_size(generic_hazptr_t item_ptr)
+            {
+                return sizeof(T);
+            }
+
             inline hazptrs_snapshot snapshot()
             {
                 return hp_dom->snapshot();
@@ -611,7 +766,10 @@ namespace benedias {
             }
 
             /// Safely delete an object or schedule the object deletion.
-            void delete_item(T* item_ptr)
+            /// The object is always retired, the return value
+            /// reports the state of unreclaimed memory on the domain.
+            /// \@return hazptr_status::over_limit if the mutator should back off.
+            hazptr_status delete_item(T* item_ptr)
             {
                 if (R > 0)
                 {
@@ -624,18 +782,26 @@ namespace benedias {
                     if (del_index == R)
                     {
                         // overflow
-                        reclaim();
+                        return reclaim();
                     }
+                    return hazptr_status::ok;
                 }
                 else
                 {
-                    domain->enqueue_for_delete(item_ptr);
+                    return domain->enqueue_for_delete(item_ptr);
                 }
             }
 
+            /// Check unreclaimed memory on the domain before mutating,
+            /// applying the domain backpressure policy.
+            inline hazptr_status admit()
+            {
+                return domain->throttle();
+            }
+
             /// Safely reclaim storage for deleted objects
             /// or schedule reclamation for deleted object.
-            void reclaim()
+            hazptr_status reclaim()
             {
                 hazptrs_snapshot  hps = domain->snapshot();
                 for(std::size_t ix=0; ix < R; ++ix)
@@ -655,8 +821,8 @@ namespace benedias {
                 {
                     // Could not delete anything, so enqueue for delete
                     // on the domain.
-                    domain->enqueue_for_delete(deleted, R);
                     del_index = 0;
+                    return domain->enqueue_for_delete(deleted, R);
                 }
                 else
                 {
@@ -678,6 +844,7 @@ namespace benedias {
                         }
                     }
                 }
+                return hazptr_status::ok;
             }
 
             T* store(std::size_t index, T** pptr)
@@ -700,12 +867,243 @@ namespace benedias {
             }
         };
 
+        /// Type agnostic reclaimer, objects are reclaimed using delete.
+        /// A single stateless instance exists per type, so delete nodes
+        /// referring to it can never outlive it.
+        template <typename T> struct hazptr_reclaimer: public domain_reclaimer
+        {
+            void reclaim_object(generic_hazptr_t item_ptr)
+            {
+                delete reinterpret_cast<T*>(item_ptr);
+            }
+
+            std::size_t object_size(generic_hazptr_t item_ptr)
+            {
+                return sizeof(T);
+            }
+
+            static hazptr_reclaimer<T>& instance()
+            {
+                // Never destroyed, domains may be destroyed, and so
+                // reclaim objects, after static destructors have run.
+                static hazptr_reclaimer<T>* reclaimer = new hazptr_reclaimer<T>();
+                return *reclaimer;
+            }
+        };
+
+        /// Type agnostic execution context required for use of hazard
+        /// pointers by a single thread, bound to a type agnostic hazard
+        /// pointer domain.
+        /// Unlike hazard_pointer_context, a single instance can serve every
+        /// container, of any type, that uses the domain.
+        /// So a thread accessing many containers holds a single reservation
+        /// of S hazard pointers and a single retire buffer of length R,
+        /// which keeps snapshots small.
+        /// The hazard pointers are used for the duration of a single
+        /// container operation, operations on containers sharing a context
+        /// cannot be interleaved.
+        template <std::size_t S, std::size_t R> class hazptr_context
+        {
+            private:
+            struct retired_item
+            {
+                generic_hazptr_t ptr;
+                domain_reclaimer* reclaimer;
+            };
+
+            // Contexts of a thread, see local.
+            struct local_contexts
+            {
+                std::vector<std::unique_ptr<hazptr_context>> contexts;
+                hazptr_context* last = nullptr;
+            };
+
+            std::shared_ptr<hazptr_domain> domain;
+            retired_item deleted[R]={};
+            std::size_t del_index=0;
+            generic_hazptr_t* const hazard_ptrs;
+
+            public:
+            // Non copyable.
+            hazptr_context(const hazptr_context&) = delete;
+            hazptr_context& operator=(const hazptr_context&) = delete;
+            // Non movable.
+            hazptr_context(hazptr_context&& other) = delete;
+            hazptr_context& operator=(const hazptr_context&& other)=delete;
+
+            explicit hazptr_context(std::shared_ptr<hazptr_domain> dom):
+                domain(dom), hazard_ptrs(domain->reserve(S))
+            {
+                //FIXME: throw exception.
+                assert(hazard_ptrs != nullptr);
+            }
+
+            ~hazptr_context()
+            {
+                clear();
+                domain->release(hazard_ptrs, S);
+                // Delegate deletion of retired objects to the domain.
+                for(std::size_t ix=0; ix < del_index; ++ix)
+                {
+                    domain->enqueue_for_delete(deleted[ix].ptr, *deleted[ix].reclaimer);
+                }
+                domain->collect();
+            }
+
+            /// Return the context of the calling thread, for a domain.
+            /// The context is created on first use and destroyed on thread
+            /// exit, or once no container shares its domain any longer.
+            static hazptr_context& local(const std::shared_ptr<hazptr_domain>& dom)
+            {
+                thread_local local_contexts locals;
+                // Consecutive operations of a thread mostly use the same
+                // domain, the list is only searched when the domain changes.
+                if (nullptr != locals.last && locals.last->domain == dom)
+                {
+                    return *locals.last;
+                }
+                locals.last = nullptr;
+                auto& contexts = locals.contexts;
+                for(auto it = contexts.begin(); it != contexts.end();)
+                {
+                    if ((*it)->domain == dom)
+                    {
+                        locals.last = it->get();
+                        ++it;
+                    }
+                    else if (1 == (*it)->domain.use_count())
+                    {
+                        // The context is the last owner of the domain, no
+                        // container or accessor can use it, drop it with its
+                        // reservation so the domain is destroyed.
+                        it = contexts.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+                if (nullptr == locals.last)
+                {
+                    contexts.emplace_back(new hazptr_context(dom));
+                    locals.last = contexts.back().get();
+                }
+                return *locals.last;
+            }
+
+            inline const std::shared_ptr<hazptr_domain>& get_domain() const
+            {
+                return domain;
+            }
+
+            /// Set a hazard pointer.
+            /// The store is sequentially consistent, so that it is ordered
+            /// before subsequent loads validating the pointer.
+            template <typename T> inline void store(std::size_t index, T* ptr)
+            {
+                assert(index < S);
+                __atomic_store_n(hazard_ptrs + index,
+                        reinterpret_cast<generic_hazptr_t>(ptr), __ATOMIC_SEQ_CST);
+            }
+
+            template <typename T> inline T* at(std::size_t index) const
+            {
+                assert(index < S);
+                return reinterpret_cast<T*>(__atomic_load_n(hazard_ptrs + index, __ATOMIC_RELAXED));
+            }
+
+            /// Clear all hazard pointers.
+            inline void clear()
+            {
+                for(std::size_t ix=0; ix < S; ++ix)
+                {
+                    __atomic_store_n(hazard_ptrs + ix, nullptr, __ATOMIC_RELEASE);
+                }
+            }
+
+            /// Safely delete an object or schedule the object deletion.
+            /// \@return hazptr_status::over_limit if the mutator should back off.
+            inline hazptr_status retire(generic_hazptr_t item_ptr, domain_reclaimer& reclaimer)
+            {
+                if (R > 0)
+                {
+                    assert(del_index < R);
+                    deleted[del_index].ptr = item_ptr;
+                    deleted[del_index].reclaimer = &reclaimer;
+                    ++del_index;
+                    if (del_index == R)
+                    {
+                        return reclaim();
+                    }
+                    return hazptr_status::ok;
+                }
+                domain->enqueue_for_delete(item_ptr, reclaimer);
+                domain->collect_if_required();
+                return domain->throttle();
+            }
+
+            template <typename T> inline hazptr_status retire(T* item_ptr)
+            {
+                return retire(reinterpret_cast<generic_hazptr_t>(item_ptr),
+                        hazptr_reclaimer<T>::instance());
+            }
+
+            /// See hazptr_domain::throttle
+            inline hazptr_status admit()
+            {
+                return domain->throttle();
+            }
+
+            /// Safely reclaim storage for retired objects
+            /// or schedule reclamation for retired objects.
+            hazptr_status reclaim()
+            {
+                hazptrs_snapshot  hps = domain->snapshot();
+                std::size_t kept = 0;
+                for(std::size_t ix=0; ix < del_index; ++ix)
+                {
+                    if (hps.search(deleted[ix].ptr))
+                    {
+                        deleted[kept++] = deleted[ix];
+                    }
+                    else
+                    {
+                        deleted[ix].reclaimer->reclaim_object(deleted[ix].ptr);
+                    }
+                }
+                del_index = kept;
+
+                if (del_index == R)
+                {
+                    // Could not delete anything, so enqueue for delete
+                    // on the domain.
+                    for(std::size_t ix=0; ix < R; ++ix)
+                    {
+                        domain->enqueue_for_delete(deleted[ix].ptr, *deleted[ix].reclaimer);
+                    }
+                    del_index = 0;
+                    domain->collect_if_required();
+                    return domain->throttle();
+                }
+                return hazptr_status::ok;
+            }
+        };
+
         // Demo class to demonstrate how a container class should handle
         // creation of associated hazard_pointer_context objects.
         template <typename T, std::size_t S, std::size_t R> class hazard_pointer_assoc
         {
-            std::shared_ptr<hazard_pointer_domain<T>> dom = hazard_pointer_domain<T>::make();
+            std::shared_ptr<hazard_pointer_domain<T>> dom;
             public:
+            hazard_pointer_assoc():dom(hazard_pointer_domain<T>::make())
+            {
+            }
+
+            explicit hazard_pointer_assoc(std::shared_ptr<hazptr_domain> hpdom):
+                dom(hazard_pointer_domain<T>::make(hpdom))
+            {
+            }
+
             hazard_pointer_context<T, S, R> context()
             {
                 return std::move(hazard_pointer_context<T, S, R>(dom));
@@ -23,11 +23,17 @@ along with this file.  If not, see <http://www.gnu.org/licenses/>.
 #include <ctime>
 #include <iostream>
 #include <memory>
+#include <array>
+#include <thread>
 
 using   benedias::concurrent::hazard_pointer_assoc;
 using   benedias::concurrent::hazard_pointer_domain;
 using   benedias::concurrent::hazard_pointer_context;
 using   benedias::concurrent::hazard_pointer;
+using   benedias::concurrent::hazptr_domain;
+using   benedias::concurrent::hazptr_context;
+using   benedias::concurrent::hazptr_status;
+using   benedias::concurrent::hazptr_backpressure;
 
 unsigned scope = 0;
 void indent()
@@ -254,11 +260,137 @@ indent();std::cout << "hp1 scope end" << std::endl;
 indent();std::cout << "hpdom scope end" << std::endl;
 }
 
+const char* status_str(hazptr_status status)
+{
+    return hazptr_status::ok == status ? "ok" : "over_limit";
+}
+
+// Test of bounded unreclaimed memory,
+// hazard pointers held by one context prevent reclamation.
+void test4()
+{
+indent();std::cout << "test4 bounded unreclaimed memory, fail and help backpressure policies." << std::endl;
+    std::array<B*, 4> tcs;
+    for(unsigned i=0; i < tcs.size(); ++i)
+    {
+        tcs[i] = new B(i);
+    }
+indent();std::cout << "hpdom scope start" << std::endl;
+    {
+        ++scope;
+        auto hpdom = hazard_pointer_domain<B>::make();
+        hpdom->set_pending_limit(2, 0, hazptr_backpressure::fail);
+        auto hpc1 = hazard_pointer_context<B, 3, 0>(hpdom);
+        auto hpc2 = hazard_pointer_context<B, 3, 0>(hpdom);
+        hpc1.store(0, tcs[0]);
+        hpc1.store(1, tcs[1]);
+        hpc1.store(2, tcs[2]);
+        for(unsigned i=0; i < 3; ++i)
+        {
+            hazptr_status status = hpc2.delete_item(tcs[i]);
+indent();std::cout << "hp2 delete " << tcs[i] << " pending=" << hpdom->pending_objects()
+                    << " status=" << status_str(status) << std::endl;
+            assert((i < 2) == (hazptr_status::ok == status));
+        }
+        hpdom->set_pending_limit(2, 0, hazptr_backpressure::help);
+        hazptr_status status = hpc2.delete_item(tcs[3]);
+indent();std::cout << "hp2 delete " << tcs[3] << " pending=" << hpdom->pending_objects()
+                    << " status=" << status_str(status) << std::endl;
+        assert(hazptr_status::over_limit == status);
+        assert(3 == hpdom->pending_objects());
+        hpc1.store(0, static_cast<B*>(nullptr));
+        hpc1.store(1, static_cast<B*>(nullptr));
+        status = hpc2.admit();
+indent();std::cout << "hp1 cleared hazps 0,1 pending=" << hpdom->pending_objects()
+                    << " status=" << status_str(status) << std::endl;
+        assert(hazptr_status::ok == status);
+        assert(1 == hpdom->pending_objects());
+        hpc1.store(2, static_cast<B*>(nullptr));
+    }
+    --scope;
+indent();std::cout << "hpdom scope end" << std::endl;
+}
+
+struct  C
+{
+    unsigned v;
+    explicit C(unsigned x):v(x)
+    {
+        indent(); std::cout << "CTOR C " << this << ", v=" << v << std::endl;
+    }
+    ~C()
+    {
+        indent(); 
+        std::cout << "DTOR C ";
+        std::cout << this;
+        std::cout << ", v=" << v;
+        std::cout << std::endl;
+    }
+};
+
+// Test of a type agnostic thread context, shared by objects of different types.
+// The context is destroyed on thread exit.
+void test5()
+{
+indent();std::cout << "test5 type agnostic hazptr_context, objects of different types in one domain." << std::endl;
+    auto hpdom = hazptr_domain::make();
+indent();std::cout << "thread scope start" << std::endl;
+    std::thread th([hpdom]{
+        ++scope;
+        auto& hpc = hazptr_context<3, 4>::local(hpdom);
+        assert((&hpc == &hazptr_context<3, 4>::local(hpdom)));
+        B* b0 = new B(0);
+        B* b1 = new B(1);
+        C* c0 = new C(0);
+        C* c1 = new C(1);
+        hpc.store(0, b0);
+        hpc.store(1, c1);
+indent();std::cout << "hazps are " << hpc.at<B>(0) << ", " << hpc.at<C>(1) << std::endl;
+indent();std::cout << "retire all, expect " << b1 << " and " << c0 << " to be deleted" << std::endl;
+        hpc.retire(b0);
+        hpc.retire(b1);
+        hpc.retire(c0);
+        hpc.retire(c1);
+        hpc.clear();
+        --scope;
+    });
+    th.join();
+indent();std::cout << "thread scope end" << std::endl;
+}
+
+// Test that a thread does not keep contexts of abandoned domains alive,
+// a context is dropped once it is the last owner of its domain.
+void test6()
+{
+indent();std::cout << "test6 contexts of abandoned domains are dropped." << std::endl;
+    std::thread th([]{
+        auto kept = hazptr_domain::make();
+        auto& kept_hpc = hazptr_context<3, 4>::local(kept);
+        std::weak_ptr<hazptr_domain> first;
+        for(unsigned n = 0; n < 4; ++n)
+        {
+            auto hpdom = hazptr_domain::make();
+            if (0 == n)
+            {
+                first = hpdom;
+            }
+            auto& hpc = hazptr_context<3, 4>::local(hpdom);
+            B* b = new B(n);
+            hpc.retire(b);
+            assert((&hpc == &hazptr_context<3, 4>::local(hpdom)));
+        }
+        // The lookup for another domain drops the abandoned contexts.
+        assert((&kept_hpc == &hazptr_context<3, 4>::local(kept)));
+        assert(first.expired());
+indent();std::cout << "abandoned domains destroyed" << std::endl;
+    });
+    th.join();
+}
 
 int main( int argc, char* argv[] )
 {
     typedef void(*testfuncptr)();
-    std::array<testfuncptr, 4> testfuncs{{test0, test1, test2, test3}};
+    std::array<testfuncptr, 7> testfuncs{{test0, test1, test2, test3, test4, test5, test6}};
 //    std::array<testfuncptr, 4> testfuncs{{test0}};
     std::setlocale(LC_ALL, "en_US.UTF-8");
     std::srand(std::time(nullptr)); // use current time as seed for random generator
@@ -0,0 +1,475 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Load generator and functional test for the solist key value server.
+    kvload [-u unix_socket_path | -p tcp_port] [-c connections] [-n keys]
+           [-r requests] [-d pipeline_depth] [-t server_threads]
+Without -u or -p an embedded server is started on a Unix socket in /tmp.
+Every connection is driven by its own thread, on a disjoint range of keys,
+    1) set, get, mget and delete the keys, checking the responses.
+    2) pipelined mixed get/mget/set requests, reporting the throughput.
+*/
+#include "solist_kvserver.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using   benedias::concurrent::solist_kvserver;
+namespace kv = benedias::concurrent::kv;
+
+struct  load_config
+{
+    std::string unix_path;
+    uint16_t    tcp_port = 0;
+    unsigned    connections = 4;
+    unsigned    keys = 2000;
+    unsigned    requests = 20000;
+    unsigned    depth = 16;
+    unsigned    mget_count = 8;
+};
+
+// Blocking client, requests are queued and sent in a batch,
+// responses are read back in order.
+class kv_client
+{
+    int     fd = -1;
+    std::vector<char>   out;
+    std::vector<char>   in;
+    std::size_t         in_pos = 0;
+
+    void request(uint8_t op, uint16_t count, const void* body, std::size_t length)
+    {
+        kv::header h{op, 0, count, static_cast<uint32_t>(length)};
+        const char* hp = reinterpret_cast<const char*>(&h);
+        out.insert(out.end(), hp, hp + sizeof(h));
+        const char* bp = static_cast<const char*>(body);
+        out.insert(out.end(), bp, bp + length);
+    }
+
+    public:
+    ~kv_client()
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    bool connect_to(const load_config& cfg)
+    {
+        if (!cfg.unix_path.empty())
+        {
+            sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, cfg.unix_path.c_str(), sizeof(addr.sun_path) - 1);
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            return fd >= 0 && 0 == connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        }
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(cfg.tcp_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || 0 != connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)))
+        {
+            return false;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return true;
+    }
+
+    void get(kv::key k)
+    {
+        request(kv::op_get, 0, &k, sizeof(k));
+    }
+
+    void del(kv::key k)
+    {
+        request(kv::op_del, 0, &k, sizeof(k));
+    }
+
+    void set(kv::key k, const std::string& v)
+    {
+        std::string body(reinterpret_cast<const char*>(&k), sizeof(k));
+        body += v;
+        request(kv::op_set, 0, body.data(), body.size());
+    }
+
+    void mget(const std::vector<kv::key>& keys)
+    {
+        request(kv::op_mget, keys.size(), keys.data(), keys.size() * sizeof(kv::key));
+    }
+
+    bool send_all()
+    {
+        std::size_t pos = 0;
+        while(pos < out.size())
+        {
+            ssize_t n = send(fd, out.data() + pos, out.size() - pos, MSG_NOSIGNAL);
+            if (n <= 0)
+            {
+                return false;
+            }
+            pos += n;
+        }
+        out.clear();
+        return true;
+    }
+
+    bool receive(kv::header& h, std::string& body)
+    {
+        while(true)
+        {
+            std::size_t avail = in.size() - in_pos;
+            if (avail >= sizeof(h))
+            {
+                memcpy(&h, in.data() + in_pos, sizeof(h));
+                if (avail >= sizeof(h) + h.length)
+                {
+                    body.assign(in.data() + in_pos + sizeof(h), h.length);
+                    in_pos += sizeof(h) + h.length;
+                    return true;
+                }
+            }
+            if (in_pos > 0)
+            {
+                in.erase(in.begin(), in.begin() + in_pos);
+                in_pos = 0;
+            }
+            char buf[64 * 1024];
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0)
+            {
+                return false;
+            }
+            in.insert(in.end(), buf, buf + n);
+        }
+    }
+};
+
+std::atomic<std::size_t>  failures{0};
+
+#define CHECK(cond, what) \
+    do { if (!(cond)) { ++failures; std::cout << "Failed! " << what << std::endl; } } while(0)
+
+inline std::string value_of(kv::key k, unsigned version)
+{
+    return "value-" + std::to_string(k) + "-" + std::to_string(version);
+}
+
+// Check the value entries of an mget response body.
+void check_mget(const std::string& body, const std::vector<kv::key>& keys, unsigned version)
+{
+    std::size_t pos = 0;
+    for(auto k : keys)
+    {
+        uint32_t len;
+        CHECK(pos + sizeof(len) <= body.size(), "mget short body");
+        if (pos + sizeof(len) > body.size())
+        {
+            return;
+        }
+        memcpy(&len, body.data() + pos, sizeof(len));
+        pos += sizeof(len);
+        CHECK(len != kv::absent, "mget key not found " << k);
+        if (len != kv::absent)
+        {
+            CHECK(body.compare(pos, len, value_of(k, version)) == 0, "mget value " << k);
+            pos += len;
+        }
+    }
+    CHECK(pos == body.size(), "mget body length");
+}
+
+// Requests are sent in chunks, the server stops reading from a connection
+// while responses are pending, so a client must not send unbounded
+// amounts without reading.
+constexpr unsigned chunk_keys = 256;
+
+void functional_chunk(const load_config& cfg, kv_client& client, kv::key base, kv::key end)
+{
+    kv::header h;
+    std::string body;
+
+    for(unsigned version = 0; version < 2; ++version)
+    {
+        // the second round replaces the values.
+        for(kv::key k = base; k < end; ++k)
+        {
+            client.set(k, value_of(k, version));
+        }
+        client.send_all();
+        for(kv::key k = base; k < end; ++k)
+        {
+            CHECK(client.receive(h, body) && kv::op_set == h.op && kv::st_ok == h.status,
+                    "set " << k << " status " << unsigned(h.status));
+        }
+    }
+
+    for(kv::key k = base; k < end; ++k)
+    {
+        client.get(k);
+    }
+    client.send_all();
+    for(kv::key k = base; k < end; ++k)
+    {
+        CHECK(client.receive(h, body) && kv::st_ok == h.status && body == value_of(k, 1),
+                "get " << k);
+    }
+
+    std::vector<std::vector<kv::key>> mgets;
+    for(kv::key k = base; k < end; k += cfg.mget_count)
+    {
+        std::vector<kv::key> keys;
+        for(kv::key mk = k; mk < k + cfg.mget_count && mk < end; ++mk)
+        {
+            keys.push_back(mk);
+        }
+        client.mget(keys);
+        mgets.push_back(keys);
+    }
+    client.send_all();
+    for(auto& keys : mgets)
+    {
+        CHECK(client.receive(h, body) && kv::st_ok == h.status && h.count == keys.size(), "mget");
+        check_mget(body, keys, 1);
+    }
+
+    // delete the even keys, twice.
+    for(unsigned pass = 0; pass < 2; ++pass)
+    {
+        for(kv::key k = base; k < end; k += 2)
+        {
+            client.del(k);
+        }
+        client.send_all();
+        for(kv::key k = base; k < end; k += 2)
+        {
+            CHECK(client.receive(h, body) && (0 == pass ? kv::st_ok : kv::st_not_found) == h.status,
+                    "del " << k << " pass " << pass);
+        }
+    }
+    for(kv::key k = base; k < end; ++k)
+    {
+        client.get(k);
+    }
+    client.send_all();
+    for(kv::key k = base; k < end; ++k)
+    {
+        bool ok = client.receive(h, body);
+        if (k & 1)
+        {
+            CHECK(ok && kv::st_ok == h.status && body == value_of(k, 1), "get after del " << k);
+        }
+        else
+        {
+            CHECK(ok && kv::st_not_found == h.status, "get deleted " << k);
+        }
+    }
+
+}
+
+void functional(const load_config& cfg, unsigned index)
+{
+    kv_client client;
+    if (!client.connect_to(cfg))
+    {
+        CHECK(false, "connect " << strerror(errno));
+        return;
+    }
+    kv::key base = index * cfg.keys;
+    for(kv::key k = base; k < base + cfg.keys; k += chunk_keys)
+    {
+        functional_chunk(cfg, client, k, std::min(k + chunk_keys, base + cfg.keys));
+    }
+
+    // invalid key, the top bit is reserved.
+    kv::header h;
+    std::string body;
+    client.get(kv::max_key + 1);
+    client.send_all();
+    CHECK(client.receive(h, body) && kv::st_error == h.status, "invalid key");
+}
+
+void load(const load_config& cfg, unsigned index, std::atomic<std::size_t>& ops)
+{
+    kv_client client;
+    if (!client.connect_to(cfg))
+    {
+        CHECK(false, "connect " << strerror(errno));
+        return;
+    }
+    std::mt19937 rng(index);
+    kv::key base = index * cfg.keys;
+    std::uniform_int_distribution<kv::key> key_dist(base, base + cfg.keys - 1);
+    std::uniform_int_distribution<unsigned> op_dist(0, 99);
+    kv::header h;
+    std::string body;
+    std::vector<kv::key> keys(cfg.mget_count);
+    std::size_t count = 0;
+
+    for(unsigned sent = 0; sent < cfg.requests; sent += cfg.depth)
+    {
+        for(unsigned d = 0; d < cfg.depth; ++d)
+        {
+            unsigned op = op_dist(rng);
+            if (op < 80)
+            {
+                client.get(key_dist(rng));
+            }
+            else if (op < 90)
+            {
+                for(auto& k : keys)
+                {
+                    k = key_dist(rng);
+                }
+                client.mget(keys);
+            }
+            else
+            {
+                kv::key k = key_dist(rng);
+                client.set(k, value_of(k, 2));
+            }
+        }
+        client.send_all();
+        for(unsigned d = 0; d < cfg.depth; ++d)
+        {
+            CHECK(client.receive(h, body) && kv::st_error != h.status && kv::st_busy != h.status,
+                    "load response status " << unsigned(h.status));
+            count += kv::op_mget == h.op ? h.count : 1;
+        }
+    }
+    ops += count;
+}
+
+template <typename F> double run_clients(const load_config& cfg, F fn)
+{
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i = 0; i < cfg.connections; ++i)
+    {
+        threads.emplace_back(fn, i);
+    }
+    for(auto& th : threads)
+    {
+        th.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    load_config cfg;
+    unsigned server_threads = 2;
+    for(int i = 1; i < argc; ++i)
+    {
+        if (i + 1 >= argc)
+        {
+            std::cerr << "missing argument for " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (0 == strcmp(argv[i], "-u"))
+        {
+            cfg.unix_path = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "-p"))
+        {
+            cfg.tcp_port = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (0 == strcmp(argv[i], "-c"))
+        {
+            cfg.connections = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (0 == strcmp(argv[i], "-n"))
+        {
+            cfg.keys = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (0 == strcmp(argv[i], "-r"))
+        {
+            cfg.requests = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (0 == strcmp(argv[i], "-d"))
+        {
+            cfg.depth = std::max(1ul, strtoul(argv[++i], nullptr, 0));
+        }
+        else if (0 == strcmp(argv[i], "-t"))
+        {
+            server_threads = strtoul(argv[++i], nullptr, 0);
+        }
+        else
+        {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::unique_ptr<solist_kvserver> server;
+    if (cfg.unix_path.empty() && 0 == cfg.tcp_port)
+    {
+        solist_kvserver::config scfg;
+        scfg.unix_path = "/tmp/kvload-" + std::to_string(getpid()) + ".sock";
+        scfg.threads = server_threads;
+        server.reset(new solist_kvserver(scfg));
+        if (!server->start())
+        {
+            return EXIT_FAILURE;
+        }
+        cfg.unix_path = scfg.unix_path;
+        std::cout << "embedded server on " << cfg.unix_path << ", " << server_threads << " threads" << std::endl;
+    }
+
+    double secs = run_clients(cfg, [&](unsigned i){ functional(cfg, i); });
+    std::cout << "functional " << cfg.connections << " connections, " << cfg.keys
+        << " keys each, " << secs << "s" << std::endl;
+
+    std::atomic<std::size_t> ops{0};
+    secs = run_clients(cfg, [&](unsigned i){ load(cfg, i, ops); });
+    std::cout << "load " << cfg.connections << " connections, depth " << cfg.depth
+        << ", " << ops << " key lookups/updates, " << (ops / secs) << " ops/s" << std::endl;
+
+    if (server)
+    {
+        std::cout << "items " << server->store()->item_count() << std::endl;
+        server->stop();
+    }
+    if (0 != failures)
+    {
+        std::cout << "Failed! " << failures << " failures" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All Done. " << std::endl;
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+solist key value server.
+    kvserver [-u unix_socket_path | -p tcp_port] [-t threads] [-b buckets]
+Runs until SIGINT or SIGTERM.
+*/
+#include "solist_kvserver.hpp"
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+
+using   benedias::concurrent::solist_kvserver;
+
+int main( int argc, char* argv[] )
+{
+    solist_kvserver::config cfg;
+    for(int i = 1; i < argc; ++i)
+    {
+        if (0 == strcmp(argv[i], "-u") && i + 1 < argc)
+        {
+            cfg.unix_path = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "-p") && i + 1 < argc)
+        {
+            cfg.tcp_port = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (0 == strcmp(argv[i], "-t") && i + 1 < argc)
+        {
+            cfg.threads = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (0 == strcmp(argv[i], "-b") && i + 1 < argc)
+        {
+            cfg.buckets = strtoul(argv[++i], nullptr, 0);
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                << " [-u unix_socket_path | -p tcp_port] [-t threads] [-b buckets]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Block the signals before the workers are started,
+    // so that they are delivered to sigwait.
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
+
+    solist_kvserver server(cfg);
+    if (!server.start())
+    {
+        return EXIT_FAILURE;
+    }
+    if (cfg.unix_path.empty())
+    {
+        std::cout << "listening on 127.0.0.1:" << server.port() << std::endl;
+    }
+    else
+    {
+        std::cout << "listening on " << cfg.unix_path << std::endl;
+    }
+
+    int sig;
+    sigwait(&sigs, &sig);
+    server.stop();
+    std::cout << "stopped, " << server.store()->item_count() << " items" << std::endl;
+    return EXIT_SUCCESS;
+}
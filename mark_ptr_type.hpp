@@ -21,6 +21,7 @@ along with this file.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <atomic>
 #include <cassert>
+#include <cstdint>
 
 namespace benedias {
 namespace concurrent {
@@ -28,31 +29,141 @@ namespace concurrent {
 constexpr   uintptr_t   mark_bits_mask=1;
 constexpr   uintptr_t   mark_bits_maskoff=~mark_bits_mask;
 
+// On x86-64 and AArch64 user space addresses fit in the lower 48 bits,
+// the upper 16 bits of a pointer can be used to store a tag.
+#if defined(__x86_64__) || defined(__aarch64__)
+#define MARK_PTR_TAG_BITS   16
+#else
+#define MARK_PTR_TAG_BITS   0
+#endif
+
+constexpr   unsigned    mark_ptr_tag_bits=MARK_PTR_TAG_BITS;
+constexpr   unsigned    mark_ptr_tag_shift=(0 == mark_ptr_tag_bits) ? 0 : (sizeof(uintptr_t) * 8) - mark_ptr_tag_bits;
+constexpr   uintptr_t   mark_ptr_tag_mask=(0 == mark_ptr_tag_bits) ? 0 : (~uintptr_t(0) << mark_ptr_tag_shift);
+// Mask to extract the pointer value, independent of mark and tag bits.
+constexpr   uintptr_t   mark_ptr_value_mask=~(mark_bits_mask | mark_ptr_tag_mask);
+
+/// Traits for an optional tag stored in the unused upper bits of a
+/// mark_ptr_type, by default no tag is stored.
+/// Specialisations with enabled == true, derive the tag from the object
+/// pointed to (or nullptr), the tag is kept consistent with the pointer
+/// on every write, so a tag can be read without dereferencing the pointer.
+template <typename T> struct mark_ptr_tag
+{
+    static constexpr bool enabled = false;
+    static inline uintptr_t tag(const T* p)
+    {
+        return 0;
+    }
+};
+
+/// Pointer with a mark bit (and optionally a tag), which can be read and
+/// updated atomically.
+/// All accesses are atomic, the memory order of loads, stores and CAS
+/// operations can be specified, the defaults are acquire for loads,
+/// release for stores and acq_rel for CAS and mark operations.
+/// Failed CAS operations are always relaxed.
 template <typename T> class mark_ptr_type
 {
     private:
-        uintptr_t   upv = 0;
+        std::atomic<uintptr_t>   upv{0};
+
+        static constexpr bool tagged = mark_ptr_tag<T>::enabled && (0 != mark_ptr_tag_bits);
+        static constexpr uintptr_t ptr_mask = tagged ? mark_ptr_value_mask : mark_bits_maskoff;
+
+        static inline uintptr_t encode(T* p)
+        {
+            uintptr_t pv = reinterpret_cast<uintptr_t>(p);
+            if (tagged)
+            {
+                pv |= (mark_ptr_tag<T>::tag(p) << mark_ptr_tag_shift) & mark_ptr_tag_mask;
+            }
+            return pv;
+        }
+
+        // Expected value for CAS, the tag bits are a function of the
+        // pointer, so if the pointers match the current tag bits match.
+        inline uintptr_t encode_expected(T* p) const
+        {
+            uintptr_t pv = reinterpret_cast<uintptr_t>(p);
+            if (tagged)
+            {
+                pv |= upv.load(std::memory_order_relaxed) & mark_ptr_tag_mask;
+            }
+            return pv;
+        }
+
+        // Desired value for CAS, reuse the tag bits of the expected value
+        // if the pointer is unchanged.
+        static inline uintptr_t encode_desired(T* desired, T* expected, uintptr_t pv_expected)
+        {
+            if (tagged && desired == expected)
+            {
+                return reinterpret_cast<uintptr_t>(desired) | (pv_expected & mark_ptr_tag_mask);
+            }
+            return encode(desired);
+        }
+
+        inline bool cas_value(uintptr_t pv_expected, uintptr_t pv_desired, std::memory_order order)
+        {
+            return upv.compare_exchange_strong(pv_expected, pv_desired,
+                    order, std::memory_order_relaxed);
+        }
+
     public:
 
+    inline T* load(std::memory_order order=std::memory_order_acquire) const
+    {
+        return reinterpret_cast<T*>(upv.load(order) & ptr_mask);
+    }
+
+    inline T* load(bool *mark, std::memory_order order=std::memory_order_acquire) const
+    {
+        uintptr_t v = upv.load(order);
+        *mark = (0 != (v & mark_bits_mask));
+        return reinterpret_cast<T*>(v & ptr_mask);
+    }
+
+    /// Read the pointer, mark and tag with a single load.
+    inline T* load(bool *mark, uintptr_t *tag, std::memory_order order=std::memory_order_acquire) const
+    {
+        uintptr_t v = upv.load(order);
+        *mark = (0 != (v & mark_bits_mask));
+        *tag = tagged ? (v >> mark_ptr_tag_shift) : 0;
+        return reinterpret_cast<T*>(v & ptr_mask);
+    }
+
+    /// Store a pointer, preserving the mark.
+    /// The mark is preserved by a separate load, so the store should
+    /// not race with marking.
+    inline void store(T* p, std::memory_order order=std::memory_order_release)
+    {
+        upv.store(encode(p) | (upv.load(std::memory_order_relaxed) & mark_bits_mask), order);
+    }
+
     inline void operator=(T* p)
     {
-        upv = reinterpret_cast<uintptr_t>(p) | (upv & mark_bits_mask);
+        store(p);
     }
 
     inline T* operator()(bool *mark)
     {
-        *mark = (0 != (upv & mark_bits_mask));
-        return reinterpret_cast<T*>(upv & mark_bits_maskoff);
+        return load(mark);
+    }
+
+    inline T* operator()(bool *mark, uintptr_t *tag)
+    {
+        return load(mark, tag);
     }
 
     inline T* operator()()
     {
-        return reinterpret_cast<T*>(upv & mark_bits_maskoff);
+        return load();
     }
 
     inline T* operator->()
     {
-        return reinterpret_cast<T*>(upv & mark_bits_maskoff);
+        return load();
     }
 
     inline T** address()
@@ -64,53 +175,77 @@ template <typename T> class mark_ptr_type
     {
     }
 
-    explicit mark_ptr_type(T* p)
+    explicit mark_ptr_type(T* p):upv(encode(p))
     {
-        upv =  reinterpret_cast<uintptr_t>(p);
     }
 
-    inline bool CAS(T* expected, T* desired)
+    // Copies are relaxed, copying is intended for initialisation
+    // of objects which are not yet shared.
+    mark_ptr_type(const mark_ptr_type& other):upv(other.upv.load(std::memory_order_relaxed))
     {
-        uintptr_t pv_expected = reinterpret_cast<uintptr_t>(expected);
-        uintptr_t pv_desired = reinterpret_cast<uintptr_t>(desired);
-        return __atomic_compare_exchange(&upv, &pv_expected, &pv_desired,
-                   false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
     }
 
-    inline bool CAS(T* expected, T* desired, bool mark)
+    mark_ptr_type& operator=(const mark_ptr_type& other)
     {
-        uintptr_t pv_expected = reinterpret_cast<uintptr_t>(expected);
-        uintptr_t pv_desired = reinterpret_cast<uintptr_t>(desired);
+        upv.store(other.upv.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    inline bool CAS(T* expected, T* desired, std::memory_order order=std::memory_order_acq_rel)
+    {
+        uintptr_t pv_expected = encode_expected(expected);
+        uintptr_t pv_desired = encode_desired(desired, expected, pv_expected);
+        return cas_value(pv_expected, pv_desired, order);
+    }
+
+    inline bool CAS(T* expected, T* desired, bool mark, std::memory_order order=std::memory_order_acq_rel)
+    {
+        uintptr_t pv_expected = encode_expected(expected);
+        uintptr_t pv_desired = encode_desired(desired, expected, pv_expected);
         if (mark)
         {
             pv_desired |= mark_bits_mask;
         }
-        return __atomic_compare_exchange(&upv, &pv_expected, &pv_desired,
-                   false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+        return cas_value(pv_expected, pv_desired, order);
     }
 
-    inline bool CAS(T* expected, bool mark)
+    inline bool CAS(T* expected, bool mark, std::memory_order order=std::memory_order_acq_rel)
     {
-        uintptr_t pv_expected = reinterpret_cast<uintptr_t>(expected);
-        uintptr_t pv_desired = reinterpret_cast<uintptr_t>(expected);
+        uintptr_t pv_expected = encode_expected(expected);
+        uintptr_t pv_desired = pv_expected;
         if (mark)
         {
             pv_desired |= mark_bits_mask;
         }
-        return __atomic_compare_exchange(&upv, &pv_expected, &pv_desired,
-                   false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+        return cas_value(pv_expected, pv_desired, order);
     }
 
-    inline bool mark()
+    /// CAS with the tag of desired supplied by the caller, as returned by
+    /// load, so desired is not dereferenced, for when desired may have
+    /// been reclaimed, in which case the CAS fails.
+    inline bool CAS_tagged(T* expected, T* desired, uintptr_t desired_tag,
+            std::memory_order order=std::memory_order_acq_rel)
     {
-        uintptr_t v = __atomic_fetch_or(&upv, mark_bits_mask, __ATOMIC_ACQ_REL);
+        uintptr_t pv_expected = encode_expected(expected);
+        uintptr_t pv_desired = reinterpret_cast<uintptr_t>(desired);
+        if (tagged)
+        {
+            pv_desired |= (desired_tag << mark_ptr_tag_shift) & mark_ptr_tag_mask;
+        }
+        return cas_value(pv_expected, pv_desired, order);
+    }
+
+    inline bool mark(std::memory_order order=std::memory_order_acq_rel)
+    {
+        uintptr_t v = upv.fetch_or(mark_bits_mask, order);
         return (0 == (mark_bits_mask & v));
     }
 
-    inline bool CAS(T* expected, bool marked, T* desired, bool mark)
+    inline bool CAS(T* expected, bool marked, T* desired, bool mark,
+            std::memory_order order=std::memory_order_acq_rel)
     {
-        uintptr_t pv_expected = reinterpret_cast<uintptr_t>(expected);
-        uintptr_t pv_desired = reinterpret_cast<uintptr_t>(desired);
+        uintptr_t pv_expected = encode_expected(expected);
+        uintptr_t pv_desired = encode_desired(desired, expected, pv_expected);
 
         if (marked)
         {
@@ -122,19 +257,20 @@ template <typename T> class mark_ptr_type
             pv_desired |= mark_bits_mask;
         }
 
-        return __atomic_compare_exchange(&upv, &pv_expected, &pv_desired,
-                   false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+        return cas_value(pv_expected, pv_desired, order);
     }
     
-    inline void reset()
+    inline void reset(std::memory_order order=std::memory_order_release)
     {
-        upv = 0;
+        upv.store(0, order);
     }
 
     ~mark_ptr_type() = default;
 };
 
+static_assert(sizeof(std::atomic<uintptr_t>) == sizeof(uintptr_t),
+        "mark_ptr_type must be layout compatible with a pointer.");
+
 } // namespace concurrent
 } // namespace benedias
 #endif // _MARK_PTR_TYPE_HPP_INCLUDED
-
@@ -0,0 +1,118 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "shm_region.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace benedias {
+    namespace concurrent {
+
+namespace {
+
+void report(const char* what, const std::string& name)
+{
+    std::cerr << "shm_region: " << what << " " << name << ": " << strerror(errno) << std::endl;
+}
+
+void* map_fd(int fd, std::size_t size, const std::string& name)
+{
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == base)
+    {
+        report("mmap", name);
+        return nullptr;
+    }
+    return base;
+}
+
+} // namespace
+
+shm_region::shm_region(const std::string& name, void* base, std::size_t length):
+    name(name),base(base),length(length)
+{
+}
+
+shm_region::~shm_region()
+{
+    munmap(base, length);
+}
+
+std::unique_ptr<shm_region> shm_region::create(const std::string& name, std::size_t size)
+{
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        report("shm_open", name);
+        return nullptr;
+    }
+    void* base = nullptr;
+    if (0 != ftruncate(fd, size))
+    {
+        report("ftruncate", name);
+    }
+    else
+    {
+        base = map_fd(fd, size, name);
+    }
+    close(fd);
+    if (nullptr == base)
+    {
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+    return std::unique_ptr<shm_region>(new shm_region(name, base, size));
+}
+
+std::unique_ptr<shm_region> shm_region::open(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        report("shm_open", name);
+        return nullptr;
+    }
+    struct stat st;
+    void* base = nullptr;
+    if (0 != fstat(fd, &st))
+    {
+        report("fstat", name);
+    }
+    else
+    {
+        base = map_fd(fd, st.st_size, name);
+    }
+    close(fd);
+    if (nullptr == base)
+    {
+        return nullptr;
+    }
+    return std::unique_ptr<shm_region>(new shm_region(name, base, st.st_size));
+}
+
+bool shm_region::unlink(const std::string& name)
+{
+    return 0 == shm_unlink(name.c_str());
+}
+
+    } //namespace concurrent
+} //namespace benedias
@@ -0,0 +1,75 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SHM_REGION_HPP
+#define BENEDIAS_SHM_REGION_HPP
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace benedias {
+    namespace concurrent {
+
+    /// A named POSIX shared memory object (shm_open), mapped read write
+    /// into the address space of the process.
+    /// The mapping address differs between processes, so data structures
+    /// in the region must link with offsets, not pointers.
+    class shm_region
+    {
+        std::string     name;
+        void*           base = nullptr;
+        std::size_t     length = 0;
+
+        shm_region(const std::string& name, void* base, std::size_t length);
+
+        public:
+        // Non copyable
+        shm_region& operator=(const shm_region&) = delete;
+        shm_region(shm_region const&) = delete;
+
+        ~shm_region();
+
+        /// Create a new zero filled region, fails if the name exists.
+        /// \@return nullptr on failure, errors are reported on stderr.
+        static std::unique_ptr<shm_region> create(const std::string& name, std::size_t size);
+        /// Map an existing region, the size is that of the shared memory object.
+        /// \@return nullptr on failure, errors are reported on stderr.
+        static std::unique_ptr<shm_region> open(const std::string& name);
+        /// Remove the name, existing mappings remain valid.
+        static bool unlink(const std::string& name);
+
+        inline void* address() const
+        {
+            return base;
+        }
+
+        inline std::size_t size() const
+        {
+            return length;
+        }
+
+        template <typename U> inline U* at(std::size_t offset) const
+        {
+            return reinterpret_cast<U*>(static_cast<char*>(base) + offset);
+        }
+    };
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SHM_REGION_HPP
@@ -0,0 +1,320 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the shared memory solist, a table is created by the parent,
+child processes open it by name and concurrently insert, find and delete,
+on disjoint ranges of keys, the parent then checks the result.
+The table capacity is less than the total number of inserts, so the
+test also checks that deleted nodes are recycled across processes.
+Then a process dies holding a hazard pointer, its slot must be reclaimed,
+and opening a table whose creator died before initialising it must fail.
+*/
+#include "solist_shm.hpp"
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using   benedias::concurrent::solist_shm;
+using   benedias::concurrent::solist_shm_accessor;
+using   benedias::concurrent::hash_t;
+using   benedias::concurrent::sol_node_key;
+
+struct  item
+{
+    hash_t      key;
+    uint32_t    round;
+    uint64_t    check;
+};
+
+constexpr unsigned num_procs = 4;
+constexpr unsigned num_threads = 2;
+constexpr unsigned num_keys = 500;
+constexpr unsigned num_rounds = 4;
+// slack for nodes retired but not yet returned to the free list.
+constexpr unsigned capacity = num_procs * num_threads * (num_keys + 200);
+
+inline item make_item(hash_t key, uint32_t round)
+{
+    return item{key, round, uint64_t(key) * 0x9e3779b97f4a7c15ull + round};
+}
+
+inline bool check_item(const item& it, hash_t key, uint32_t round)
+{
+    return it.key == key && it.round == round && it.check == make_item(key, round).check;
+}
+
+// Returns the number of failures.
+unsigned worker(std::shared_ptr<solist_shm<item>> table, unsigned index)
+{
+    solist_shm_accessor<item> acc(table);
+    unsigned failures = 0;
+    hash_t base = index * num_keys;
+    item it;
+
+    for(hash_t k = base; k < base + num_keys; ++k)
+    {
+        if (!acc.insert_node(k, make_item(k, 0)))
+        {
+            std::cout << "Failed! insert " << k << std::endl;
+            ++failures;
+        }
+    }
+    // Churn the odd keys, every round needs recycled nodes.
+    for(uint32_t round = 1; round <= num_rounds; ++round)
+    {
+        for(hash_t k = base + 1; k < base + num_keys; k += 2)
+        {
+            if (!acc.delete_node(k))
+            {
+                std::cout << "Failed! delete " << k << " round " << round << std::endl;
+                ++failures;
+            }
+            if (acc.find_item(k, &it))
+            {
+                std::cout << "Failed! found deleted " << k << std::endl;
+                ++failures;
+            }
+        }
+        for(hash_t k = base + 1; k < base + num_keys; k += 2)
+        {
+            if (!acc.insert_node(k, make_item(k, round)))
+            {
+                std::cout << "Failed! reinsert " << k << " round " << round << std::endl;
+                ++failures;
+            }
+        }
+    }
+    for(hash_t k = base; k < base + num_keys; ++k)
+    {
+        uint32_t round = (k & 1) ? num_rounds : 0;
+        if (!acc.find_item(k, &it) || !check_item(it, k, round))
+        {
+            std::cout << "Failed! find " << k << std::endl;
+            ++failures;
+        }
+        if (acc.insert_node(k, make_item(k, 99)))
+        {
+            std::cout << "Failed! duplicate insert " << k << std::endl;
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+int child(const std::string& name, unsigned proc)
+{
+    auto table = solist_shm<item>::open(name);
+    if (!table)
+    {
+        std::cout << "Failed! open " << name << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<std::thread> threads;
+    std::vector<unsigned> failures(num_threads);
+    for(unsigned t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&, t]{ failures[t] = worker(table, proc * num_threads + t); });
+    }
+    unsigned total = 0;
+    for(unsigned t = 0; t < num_threads; ++t)
+    {
+        threads[t].join();
+        total += failures[t];
+    }
+    return 0 == total ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Number of orphaned nodes and slots in use of a table.
+void count_slots(std::shared_ptr<solist_shm<item>> table, unsigned& orphans, unsigned& in_use)
+{
+    orphans = in_use = 0;
+    auto slots = table->hazard_slots();
+    for(std::size_t i = 0; i < table->hazard_slot_count(); ++i)
+    {
+        in_use += 0 != slots[i].in_use.load();
+        for(auto& orphan : slots[i].orphans)
+        {
+            orphans += 0 != orphan.load();
+        }
+    }
+}
+
+// A process dies holding a hazard pointer to a node, the destruction of
+// the accessor which deletes the node must not wait for it, and the
+// slot of the dead process must be reclaimed, which releases the node.
+unsigned test_dead_process(const std::string& name)
+{
+    unsigned failures = 0;
+    auto table = solist_shm<item>::create(name, 16, 4);
+    {
+        solist_shm_accessor<item> acc(table);
+        acc.insert_node(1, make_item(1, 0));
+    }
+    std::cout.flush();
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+        table.reset();
+        auto t = solist_shm<item>::open(name);
+        // Never destroyed, the process dies holding the slot.
+        new solist_shm_accessor<item>(t);
+        uint32_t index = t->node(1).next.load();
+        while(0 != index && t->node(index).key != sol_node_key(1))
+        {
+            index = t->node(index).next.load();
+        }
+        auto slots = t->hazard_slots();
+        for(std::size_t i = 0; i < t->hazard_slot_count(); ++i)
+        {
+            if (slots[i].in_use.load() == uint32_t(getpid()))
+            {
+                slots[i].hp[0].store(index);
+            }
+        }
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    unsigned orphans, in_use;
+    {
+        solist_shm_accessor<item> acc(table);
+        if (!acc.delete_node(1))
+        {
+            std::cout << "Failed! dead process delete" << std::endl;
+            ++failures;
+        }
+    }
+    count_slots(table, orphans, in_use);
+    if (1 != orphans || 1 != in_use)
+    {
+        std::cout << "Failed! dead process orphans " << orphans << " in use " << in_use << std::endl;
+        ++failures;
+    }
+    {
+        solist_shm_accessor<item> acc(table);
+        if (1 != acc.reclaim_dead_slots())
+        {
+            std::cout << "Failed! dead process slot not reclaimed" << std::endl;
+            ++failures;
+        }
+    }
+    count_slots(table, orphans, in_use);
+    if (0 != orphans || 0 != in_use)
+    {
+        std::cout << "Failed! dead process reclaim orphans " << orphans << " in use " << in_use << std::endl;
+        ++failures;
+    }
+    solist_shm<item>::unlink(name);
+    return failures;
+}
+
+// The creator died after creating the region, before the table was
+// initialised, open must give up.
+unsigned test_dead_creator(const std::string& name)
+{
+    unsigned failures = 0;
+    auto region = benedias::concurrent::shm_region::create(name, 4096);
+    auto start = std::chrono::steady_clock::now();
+    if (!region || nullptr != solist_shm<item>::open(name, std::chrono::milliseconds(50)))
+    {
+        std::cout << "Failed! open of an uninitialised table" << std::endl;
+        ++failures;
+    }
+    if (std::chrono::steady_clock::now() - start > std::chrono::seconds(5))
+    {
+        std::cout << "Failed! open of an uninitialised table timeout" << std::endl;
+        ++failures;
+    }
+    solist_shm<item>::unlink(name);
+    return failures;
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    std::string name = "/solist_shmtest." + std::to_string(getpid());
+    auto table = solist_shm<item>::create(name, capacity, 1024);
+    if (!table)
+    {
+        std::cout << "Failed! create " << name << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "table " << name << " capacity " << capacity << ", "
+        << num_procs * num_threads * num_keys * (num_rounds + 2) / 2 << " inserts" << std::endl;
+
+    std::vector<pid_t> pids;
+    for(unsigned p = 0; p < num_procs; ++p)
+    {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (0 == pid)
+        {
+            // the inherited mapping is not used, the child maps the table
+            // at a different address.
+            table.reset();
+            _exit(child(name, p));
+        }
+        pids.push_back(pid);
+    }
+
+    unsigned failures = 0;
+    for(auto pid : pids)
+    {
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status))
+        {
+            std::cout << "Failed! child " << pid << " status " << status << std::endl;
+            ++failures;
+        }
+    }
+
+    solist_shm_accessor<item> acc(table);
+    item it;
+    for(hash_t k = 0; k < num_procs * num_threads * num_keys; ++k)
+    {
+        uint32_t round = (k & 1) ? num_rounds : 0;
+        if (!acc.find_item(k, &it) || !check_item(it, k, round))
+        {
+            std::cout << "Failed! parent find " << k << std::endl;
+            ++failures;
+        }
+    }
+    if (table->item_count() != num_procs * num_threads * num_keys)
+    {
+        std::cout << "Failed! item count " << table->item_count() << std::endl;
+        ++failures;
+    }
+    std::cout << "items " << table->item_count() << " buckets " << table->bucket_count() << std::endl;
+    solist_shm<item>::unlink(name);
+    failures += test_dead_process(name + ".dead");
+    failures += test_dead_creator(name + ".creator");
+
+    if (0 != failures)
+    {
+        return EXIT_FAILURE;
+    }
+    std::cout << "All Done. " << std::endl;
+    return 0;
+}
@@ -16,6 +16,9 @@ along with this file.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "solist.hpp"
 #include <iostream>
+#include <random>
+#include <system_error>
+#include <thread>
 
 namespace benedias {
     namespace concurrent {
@@ -79,6 +82,194 @@ hash_t reverse_hasht_bits(hash_t hashv)
 #endif
 }
 
+uint64_t solist_new_id()
+{
+    static uint64_t next_id = 0;
+    return __atomic_add_fetch(&next_id, 1, __ATOMIC_RELAXED);
+}
+
+uint64_t solist_random_seed()
+{
+    std::random_device rd;
+    return (uint64_t(rd()) << 32) | rd();
+}
+
+// solist_directory member functions.
+solist_directory::solist_directory(uint32_t size, bool hints):stride(hints ? 2 : 1)
+{
+    while(n_slots < size)
+    {
+        segment_new(31 - __builtin_clz(n_slots));
+        n_slots <<= 1;
+    }
+}
+
+solist_directory::~solist_directory()
+{
+    if (nullptr != segments)
+    {
+        for(uint32_t k=1; k < MAX_SEGMENTS; ++k)
+        {
+            delete [] segments[k];
+        }
+        delete [] segments;
+    }
+}
+
+solist_bucket** solist_directory::slot_address(uint32_t slot) const
+{
+    if (slot < INLINE_SLOTS)
+    {
+        return const_cast<solist_bucket**>(&inline_slots[slot * stride]);
+    }
+    // segment k holds slots [2^k, 2^(k+1))
+    uint32_t k = 31 - __builtin_clz(slot);
+    solist_bucket*** segs = __atomic_load_n(&segments, __ATOMIC_ACQUIRE);
+    solist_bucket** seg = __atomic_load_n(&segs[k], __ATOMIC_ACQUIRE);
+    return &seg[(slot - (1u << k)) * stride];
+}
+
+void solist_directory::segment_new(uint32_t k)
+{
+    assert(k > 0 && k < MAX_SEGMENTS);
+    solist_bucket*** segs = __atomic_load_n(&segments, __ATOMIC_ACQUIRE);
+    if (nullptr == segs)
+    {
+        solist_bucket*** new_segs = new solist_bucket**[MAX_SEGMENTS]();
+        if (__atomic_compare_exchange_n(&segments, &segs, new_segs,
+                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            segs = new_segs;
+        }
+        else
+        {
+            delete [] new_segs;
+        }
+    }
+
+    solist_bucket** seg = __atomic_load_n(&segs[k], __ATOMIC_ACQUIRE);
+    if (nullptr == seg)
+    {
+        solist_bucket** new_seg = new solist_bucket*[(1u << k) * stride]();
+        if (!__atomic_compare_exchange_n(&segs[k], &seg, new_seg,
+                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            delete [] new_seg;
+        }
+    }
+}
+
+void solist_directory::expand(uint32_t curr_size)
+{
+    if (curr_size < size())
+    {
+        return;
+    }
+    // The segment holding the new slots is published before the size,
+    // so slots below the size are always addressable.
+    segment_new(31 - __builtin_clz(curr_size));
+    __atomic_compare_exchange_n(&n_slots, &curr_size, curr_size << 1,
+            false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+// solist_bucket_filter member functions.
+solist_bucket_filter::solist_bucket_filter(uint32_t size)
+{
+    reserve(size);
+}
+
+solist_bucket_filter::~solist_bucket_filter()
+{
+    for(uint32_t k=0; k < MAX_SEGMENTS; ++k)
+    {
+        delete [] segments[k];
+    }
+}
+
+void solist_bucket_filter::reserve(uint32_t size)
+{
+    for(uint32_t k = 0; k < MAX_SEGMENTS && (0 == k || (1u << k) < size); ++k)
+    {
+        uint64_t* seg = __atomic_load_n(&segments[k], __ATOMIC_ACQUIRE);
+        if (nullptr == seg)
+        {
+            uint64_t* new_seg = new uint64_t[0 == k ? 2 : 1u << k]();
+            if (!__atomic_compare_exchange_n(&segments[k], &seg, new_seg,
+                    false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                delete [] new_seg;
+            }
+        }
+    }
+}
+
+// solist_reaper member functions.
+solist_reaper::solist_reaper()
+{
+    try
+    {
+        std::thread(&solist_reaper::run, this).detach();
+        started = true;
+    }
+    catch(const std::system_error&)
+    {
+    }
+}
+
+solist_reaper& solist_reaper::instance()
+{
+    // Never destroyed, the thread runs until the process exits.
+    static solist_reaper* reaper = new solist_reaper();
+    return *reaper;
+}
+
+void solist_reaper::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while(true)
+    {
+        work_ready.wait(guard, [this]{ return !work.empty(); });
+        std::function<void()> fn = std::move(work.front());
+        work.pop_front();
+        ++running;
+        guard.unlock();
+        fn();
+        fn = nullptr;
+        guard.lock();
+        --running;
+        if (work.empty() && 0 == running)
+        {
+            work_done.notify_all();
+        }
+    }
+}
+
+void solist_reaper::submit(std::function<void()> fn)
+{
+    if (!started)
+    {
+        fn();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        work.push_back(std::move(fn));
+    }
+    work_ready.notify_one();
+}
+
+void solist_reaper::wait()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    work_done.wait(guard, [this]{ return work.empty() && 0 == running; });
+}
+
+std::size_t solist_reaper::pending()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return work.size() + running;
+}
+
     } //namespace concurrent
 } //namespace benedias
 
@@ -21,9 +21,20 @@ along with this file.  If not, see <http://www.gnu.org/licenses/>.
 #include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <utility>
 #include <memory>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
 #include "mark_ptr_type.hpp"
+#include "hazard_pointer.hpp"
+#include "solist_hash.hpp"
+#include "solist_cdc.hpp"
+#include "solist_backoff.hpp"
+#include "solist_combining.hpp"
+#include "solist_teardown.hpp"
 #if 1
 #include <iostream>
 #include <cstdio>
@@ -53,6 +64,37 @@ namespace benedias {
         return bucket_key;
     }
 
+    // Per thread hazard pointer context used by solist accessors,
+    // 3 hazard pointers (prev, cur and next) and a retire buffer.
+    using solist_hazptr_context = hazptr_context<3, 16>;
+
+    // Key fingerprints, the upper 16 bits of the split order key of a node
+    // are stored in the unused upper bits of the next pointers pointing to it.
+    // The fingerprint is order preserving, so traversal can stop without
+    // dereferencing the next node, when its fingerprint is greater than
+    // that of the key.
+    // This is effective while keys in a bucket differ in the upper 16 bits,
+    // i.e. for tables with fewer than 2^16 buckets.
+    // Define SOLIST_KEY_FINGERPRINT as 0 to disable.
+#ifndef SOLIST_KEY_FINGERPRINT
+#define SOLIST_KEY_FINGERPRINT  1
+#endif
+    constexpr bool sol_key_fingerprints = SOLIST_KEY_FINGERPRINT && (0 != mark_ptr_tag_bits);
+    // Fingerprint for the end of the list (nullptr), no key compares greater.
+    constexpr uintptr_t  SOL_FINGERPRINT_END = 0xffff;
+
+    inline uintptr_t sol_key_fingerprint(so_key key)
+    {
+        return key >> 16;
+    }
+
+    class solist_bucket;
+    template <> struct mark_ptr_tag<solist_bucket>
+    {
+        static constexpr bool enabled = sol_key_fingerprints;
+        static inline uintptr_t tag(const solist_bucket* p);
+    };
+
     class solist_bucket
     {
         protected:
@@ -67,18 +109,39 @@ namespace benedias {
         solist_bucket() {}
 
         public:
-        hash_t          hashv;
-        so_key          key;
+        // The header is just the link and the split order key, the hash
+        // is recomputed from the key and there is no vptr, so a node with
+        // a small payload fits in 16 bytes (on 64 bit targets the payload
+        // can occupy the tail padding after key).
+        // Nodes must be deleted through the derived type, see is_node.
         mark_ptr_type<solist_bucket>  next;
+        so_key          key;
 
-        explicit solist_bucket(hash_t hashv):hashv(hashv),key(sol_bucket_key(hashv)){}
-        inline bool is_node()
+        explicit solist_bucket(hash_t hashv):key(sol_bucket_key(hashv)){}
+        inline bool is_node() const
         {
             return DATABIT == (key & DATABIT);
         }
-        virtual ~solist_bucket() = default;
+
+        /// The hash value of a bucket node is its slot, for data nodes
+        /// the top bit of the hash value is not recoverable, it is not
+        /// significant, hash values differing only in the top bit have
+        /// the same key.
+        inline hash_t hashv() const
+        {
+            return reverse_hasht_bits(key & ~DATABIT);
+        }
+        ~solist_bucket() = default;
     };
 
+    static_assert(sizeof(solist_bucket) <= 2 * sizeof(uintptr_t),
+            "solist_bucket should be a link and a key");
+
+    inline uintptr_t mark_ptr_tag<solist_bucket>::tag(const solist_bucket* p)
+    {
+        return nullptr == p ? SOL_FINGERPRINT_END : sol_key_fingerprint(p->key);
+    }
+
     template <typename T> struct solist_node: solist_bucket
     {
         T               payload;
@@ -91,382 +154,1391 @@ namespace benedias {
         solist_node& operator=(solist_node&&) = delete;
         solist_node(solist_node&&) = delete;
 
-        explicit solist_node(T data, hash_t hashv):solist_bucket(hashv),payload(data)
+        // The top bit of hashv is not significant, see solist_bucket::hashv.
+        explicit solist_node(T data, hash_t hashv):payload(data)
         {
-            key |= DATABIT;
+            key = sol_node_key(hashv);
         }
         T*              get_item_ptr() { return &payload; }
         ~solist_node() = default;
 
-    };
+        /// Node types with a different allocation scheme specialise
+        /// solist_node, and hazptr_reclaimer for the node type.
+        static inline void destroy(solist_node* node)
+        {
+            delete node;
+        }
 
-#if 0
-    template <typename T> class solist_traverse
-    {
-        solist_bucket* hp[3];
-        public:
-        inline solist_bucket* next() { return hp[0]; }
-        inline solist_bucket* cur() { return hp[1]; }
-        inline solist_bucket* prev() { return hp[1]; }
     };
-#endif
 
-    template <typename T> struct solist
+    /// Bucket directory, a two level array of pointers to bucket nodes.
+    /// Segments of the directory are never moved or reallocated,
+    /// so lookups and expansion are thread safe.
+    /// Segment 0 holds slots [0, 2) and is inline,
+    /// segment k > 0 holds slots [2^k, 2^(k+1)) and is allocated on expansion.
+    /// An unexpanded directory costs the size, 2 slots and a pointer,
+    /// which keeps the footprint of small tables down.
+    /// Optionally each slot is followed by a hint, a tagged pointer to the
+    /// first data node of the bucket, with the key fingerprint of the
+    /// node in the tag, so a lookup can skip the bucket node, see
+    /// solist_accessor::find_node.
+    /// A hint is cleared before its node is retired, so a hint which is
+    /// unchanged after it is protected by a hazard pointer is safe to use.
+    class solist_directory
     {
-        uint32_t            n_buckets;
-        uint32_t            max_bucket_length = 4;
-        uint32_t            n_items = 0;
-        std::unique_ptr<solist_bucket*[]>     buckets = nullptr;
+        static constexpr uint32_t   INLINE_SLOTS = 2;
+        static constexpr uint32_t   MAX_SEGMENTS = 32;
+
+        uint32_t        n_slots = INLINE_SLOTS;
+        // Pointers per slot, 2 if slots are followed by hints.
+        const uint32_t  stride;
+        solist_bucket*  inline_slots[INLINE_SLOTS * 2] = {};
+        // Table of MAX_SEGMENTS segment pointers, allocated on first expansion.
+        solist_bucket*** segments = nullptr;
+
+        solist_bucket** slot_address(uint32_t slot) const;
+        inline uintptr_t* hint_address(uint32_t slot) const
+        {
+            return reinterpret_cast<uintptr_t*>(slot_address(slot) + 1);
+        }
+        // Allocate segment k if required, thread safe.
+        void segment_new(uint32_t k);
+
+        public:
+        static constexpr bool expandable = true;
 
         // Non copyable
-        solist& operator=(const solist&) = delete;
-        solist(solist const&) = delete;
+        solist_directory& operator=(const solist_directory&) = delete;
+        solist_directory(solist_directory const&) = delete;
 
         // Non movable
-        solist& operator=(solist&&) = delete;
-        solist(solist&&) = delete;
+        solist_directory& operator=(solist_directory&&) = delete;
+        solist_directory(solist_directory&&) = delete;
 
-        //FIXME: create a hazard pointer domain on instantiation.
-        //FIXME: add API for creation/acquisition and destroy/release
-        //of hazard pointer blocks.
-        explicit solist(uint32_t size):n_buckets(size),buckets(new solist_bucket*[size])
-        {
-            for(uint32_t x=0; x < n_buckets; ++x)
-            {
-                buckets[x] = nullptr;
-            }
-            buckets[0] = new solist_bucket(0);
-        }
+        /// \@param size - initial number of slots, rounded up to a power of 2.
+        /// \@param hints - follow each slot with a first data node hint.
+        explicit solist_directory(uint32_t size, bool hints=false);
+        ~solist_directory();
 
-        inline void inc_item_count()
+        inline uint32_t size() const
         {
-            __atomic_add_fetch(&n_items, 1, __ATOMIC_RELEASE); 
+            return __atomic_load_n(&n_slots, __ATOMIC_ACQUIRE);
         }
 
-        inline void dec_item_count()
+        inline bool has_hints() const
         {
-            __atomic_sub_fetch(&n_items, 1, __ATOMIC_RELEASE); 
+            return 2 == stride;
         }
 
-        explicit solist(uint32_t size, uint32_t bucket_length):n_buckets(size),max_bucket_length(bucket_length),buckets(new solist_bucket*[size])
+        /// Load the hint of a slot and its tag, has_hints() must be true.
+        inline solist_bucket* hint(uint32_t slot, uintptr_t* tag) const
         {
-            for(uint32_t x=0; x < n_buckets; ++x)
-            {
-                buckets[x] = nullptr;
-            }
-            buckets[0] = new solist_bucket(0);
+            uintptr_t v = __atomic_load_n(hint_address(slot), __ATOMIC_ACQUIRE);
+            *tag = v >> mark_ptr_tag_shift;
+            return reinterpret_cast<solist_bucket*>(v & mark_ptr_value_mask);
         }
 
-        ~solist()
+        /// Sequentially consistent load of the hint of a slot, to validate
+        /// a hazard pointer.
+        inline solist_bucket* hint_seq_cst(uint32_t slot) const
         {
-            solist_bucket* cur = buckets[0];
-            solist_bucket* next;
-
-            while(nullptr != cur)
-            {
-                next = cur->next();
-                delete cur;
-                cur = next;
-            }
+            uintptr_t v = __atomic_load_n(hint_address(slot), __ATOMIC_SEQ_CST);
+            return reinterpret_cast<solist_bucket*>(v & mark_ptr_value_mask);
         }
 
-        //FIXME: expand is not thread safe!!! see comment at the end of the function.
-        void expand(uint32_t curr_size)
+        /// Replace the hint of a slot, desired must be protected or nullptr,
+        /// the tag of desired is computed from its key.
+        inline bool hint_cas(uint32_t slot, solist_bucket* expected, solist_bucket* desired)
         {
-            if (curr_size < n_buckets)
-            {
-                return;
-            }
-            uint32_t new_size = n_buckets * 2;
-            auto new_buckets = std::make_unique<solist_bucket*[]>(new_size);
-            for (uint32_t x=0; x < n_buckets; ++x)
+            uintptr_t* address = hint_address(slot);
+            uintptr_t v = __atomic_load_n(address, __ATOMIC_RELAXED);
+            if ((v & mark_ptr_value_mask) != reinterpret_cast<uintptr_t>(expected))
             {
-                new_buckets[x] = buckets[x];
+                return false;
             }
-            for (uint32_t x=n_buckets; x < new_size; ++x)
+            uintptr_t dv = reinterpret_cast<uintptr_t>(desired);
+            if (nullptr != desired)
             {
-                new_buckets[x] = nullptr;
+                dv |= (mark_ptr_tag<solist_bucket>::tag(desired) << mark_ptr_tag_shift) & mark_ptr_tag_mask;
             }
+            return __atomic_compare_exchange_n(address, &v, dv,
+                    false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        }
 
-            //FIXME:
-            // Intuitively swapping in the new buckets and n_buckets should
-            // be atomic w.r.t. other concurrent operations, so that matching
-            // buckets and n_buckets pair values are accessed.
-            //Solution 1: 
-            // add another level of indirection, so_list will be a wrapper around another
-            // class which has the buckets and n_buckets fields, extra level
-            // of indirection has performance impact.
-            buckets.swap(new_buckets);
-            n_buckets = new_size;
+        inline solist_bucket* operator[](uint32_t slot) const
+        {
+            return __atomic_load_n(slot_address(slot), __ATOMIC_ACQUIRE);
         }
-    };
 
-#if 0
-    template <typename T> class solist_accessor;
-    template <typename T> void dump_solist_buckets(solist_accessor<T>& sol);
-    template <typename T> void dump_solist_keys(solist_accessor<T>& sol);
-    template <typename T> void dump_solist_key_order(solist_accessor<T>& sol);
-    template <typename T> void dump_solist(solist_accessor<T>& sol);
-    template <typename T> void dump_solist_items(solist_accessor<T>& sol);
-    template <typename T> void check_solist(solist_accessor<T>& sol);
-#endif
+        /// Set an uninitialised slot.
+        /// \@return false if the slot has already been set.
+        inline bool set(uint32_t slot, solist_bucket* bucket)
+        {
+            solist_bucket* expected = nullptr;
+            return __atomic_compare_exchange_n(slot_address(slot), &expected, bucket,
+                    false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        }
+
+        /// Double the number of slots, if the number of slots is curr_size.
+        /// Lock free and thread safe, only one of concurrent expansions
+        /// from the same size succeeds.
+        void expand(uint32_t curr_size);
+    };
 
-    template <typename T> class solist_accessor
+    /// Bucket directory of a fixed power of 2 number of slots N, an inline
+    /// array, so the slot of a hash value is a constant mask, see solist_fixed.
+    /// All N buckets are initialised when the solist is constructed,
+    /// the directory never expands and has no hints.
+    template <uint32_t N> class solist_fixed_directory
     {
-        std::shared_ptr<solist<T>> so_list;
+        static_assert(N >= 2 && 0 == (N & (N - 1)), "the number of slots must be a power of 2");
+        solist_bucket*  slots[N] = {};
 
-        solist_bucket *next;
-        solist_bucket *cur;
-        solist_bucket *prev;
-        unsigned    steps;
+        public:
+        static constexpr bool expandable = false;
 
-#if 0
-        friend void dump_solist_buckets(solist_accessor<T>& sol);
-        friend void dump_solist_keys(solist_accessor<T>& sol);
-        friend void dump_solist_key_order(solist_accessor<T>& sol);
-        friend void dump_solist(solist_accessor<T>& sol);
-        friend void dump_solist_items(solist_accessor<T>& sol);
-        friend void check_solist(solist_accessor<T>& sol);
-#else
-        template <typename U> friend void dump_solist_buckets(solist_accessor<U>& sol);
-        template <typename U> friend void dump_solist_keys(solist_accessor<U>& sol);
-        template <typename U> friend void dump_solist_key_order(solist_accessor<U>& sol);
-        template <typename U> friend void dump_solist(solist_accessor<U>& sol);
-        template <typename U> friend void dump_solist_items(solist_accessor<U>& sol);
-        template <typename U> friend void check_solist(solist_accessor<U>& sol);
-#endif       
+        // Non copyable
+        solist_fixed_directory& operator=(const solist_fixed_directory&) = delete;
+        solist_fixed_directory(solist_fixed_directory const&) = delete;
 
-        inline bool advance()
+        // Non movable
+        solist_fixed_directory& operator=(solist_fixed_directory&&) = delete;
+        solist_fixed_directory(solist_fixed_directory&&) = delete;
+
+        /// The size and hints arguments of solist constructors are ignored.
+        explicit solist_fixed_directory(uint32_t size, bool hints=false)
         {
-            // TODO:  setup hazard pointers here in the required order
-            // and delete nodes traversed which marked for delete,
-            prev = cur;
-            cur = next;
-            if (nullptr != cur)
-                next = cur->next();
-            return true;
         }
 
-        inline void zap()
+        static constexpr uint32_t size()
         {
-            //TODO: clear the hazard pointers.
-            prev = cur = next = nullptr;
+            return N;
         }
 
-        void hazp_acquire()
+        static constexpr bool has_hints()
         {
-            // TODO: Acquire a block of 3 hazard pointers from
-            // the solist instance.
-            // The hazard pointers *must* be in the "domain"
-            // associated with the solist instance.
-            zap();
+            return false;
         }
 
-        void hazp_release()
+        inline solist_bucket* hint(uint32_t slot, uintptr_t* tag) const
         {
-            // TODO: Release the block of 3 hazard pointers back 
-            // to the solist, instance.
-            // The hazard pointers *must* be in the "domain"
-            // associated with the solist instance.
+            return nullptr;
         }
 
-        public:
-        solist_accessor& operator=(const solist_accessor& other)
+        inline solist_bucket* hint_seq_cst(uint32_t slot) const
         {
-            hazp_release();
-            so_list = other.so_list;
-            hazp_acquire();
+            return nullptr;
         }
 
-        solist_accessor(solist_accessor const& other)
+        inline bool hint_cas(uint32_t slot, solist_bucket* expected, solist_bucket* desired)
         {
-            so_list = other.so_list;
-            hazp_acquire();
+            return false;
         }
 
-        solist_accessor(std::shared_ptr<solist<T>> sl):so_list(sl)
+        inline solist_bucket* operator[](uint32_t slot) const
         {
-            hazp_acquire();
+            return __atomic_load_n(&slots[slot], __ATOMIC_ACQUIRE);
         }
 
-        explicit solist_accessor(uint32_t size)
+        inline bool set(uint32_t slot, solist_bucket* bucket)
         {
-            so_list = std::make_shared<solist<T>>(size);
-            hazp_acquire();
+            solist_bucket* expected = nullptr;
+            return __atomic_compare_exchange_n(&slots[slot], &expected, bucket,
+                    false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
         }
 
-        explicit solist_accessor(uint32_t size, uint32_t bucket_length)
+        inline void expand(uint32_t curr_size)
         {
-            so_list = std::make_shared<solist<T>>(size, bucket_length);
-            hazp_acquire();
         }
+    };
 
+    /// Per bucket Bloom filters, a 64 bit word per directory slot, 2 bits
+    /// per key, so lookups of most absent keys do not touch the chain.
+    /// Bits are never cleared, deletes leave stale bits.
+    /// The word of a newly initialised bucket is built from the nodes in
+    /// its chain, before the bucket is published in the directory.
+    /// Inserts set bits in the word of the slot at the size they read
+    /// before linking the node, and if the size has changed once the
+    /// node is linked, in the words of the slot at each larger size.
+    /// Sequentially consistent fences order the link and the size load of
+    /// an insert, and the expansion and the chain scan of a bucket, so
+    /// either the insert reads the larger size, or the scan finds the node.
+    /// Segmented in the same way as solist_directory.
+    class solist_bucket_filter
+    {
+        static constexpr uint32_t   MAX_SEGMENTS = 32;
+        // segment 0 holds slots [0, 2), segment k > 0 holds [2^k, 2^(k+1)).
+        uint64_t*   segments[MAX_SEGMENTS] = {};
 
-        ~solist_accessor()=default;
+        uint64_t* word_address(uint32_t slot) const
+        {
+            uint32_t k = slot < 2 ? 0 : 31 - __builtin_clz(slot);
+            uint64_t* seg = __atomic_load_n(&segments[k], __ATOMIC_ACQUIRE);
+            return &seg[slot - (0 == k ? 0 : 1u << k)];
+        }
 
-        private:
-        void get_parent(uint32_t slot, so_key key)
+        public:
+        // Non copyable
+        solist_bucket_filter& operator=(const solist_bucket_filter&) = delete;
+        solist_bucket_filter(solist_bucket_filter const&) = delete;
+
+        explicit solist_bucket_filter(uint32_t size);
+        ~solist_bucket_filter();
+
+        /// Allocate the words for slots below size, thread safe.
+        void reserve(uint32_t size);
+
+        /// The top bit of the hash value is not significant, it is not
+        /// recoverable from the key of a node.
+        static inline uint64_t bits(hash_t hashv)
         {
-get_parent_try_again:
-            //find the initialised bucket with highest key value
-            //that is lower than key.
-            so_key key_step = sol_bucket_key(so_list->n_buckets/2);
-            so_key pb_key = key;
-            uint32_t pb_slot;
-            do
-            {
-                pb_key -= key_step;
-                pb_slot = reverse_hasht_bits(pb_key);
-                if (so_list->buckets[pb_slot])
-                {
-                    break;
-                }
-            }while(0 != pb_key);
+            uint32_t m = (hashv & 0x7fffffff) * 0x9e3779b9u;
+            return (uint64_t(1) << (m >> 26)) | (uint64_t(1) << ((m >> 20) & 63));
+        }
 
-            // and then advance to the last data node in that bucket,
-            // there may be none.
-            prev = cur = so_list->buckets[pb_slot];
-            next = cur->next();
-    
-            while(nullptr != next && next->key < key)
+        /// Set the bits of hashv in the word of its bucket, before the
+        /// node is linked.
+        /// \@return the size read, for confirm.
+        template <typename D> uint32_t add(const D& buckets, hash_t hashv)
+        {
+            uint32_t n = buckets.size();
+            __atomic_fetch_or(word_address(hashv % n), bits(hashv), __ATOMIC_RELAXED);
+            return n;
+        }
+
+        /// After the node is linked, set the bits of hashv in the words
+        /// of the buckets split off since add read size n.
+        template <typename D> void confirm(const D& buckets, hash_t hashv, uint32_t n)
+        {
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            for(uint32_t n2 = buckets.size(); n2 != n; n2 = buckets.size())
             {
-                if (!advance())
+                for(uint32_t s = n << 1; s <= n2; s <<= 1)
                 {
-                    goto get_parent_try_again;
+                    __atomic_fetch_or(word_address(hashv % s), bits(hashv), __ATOMIC_RELAXED);
                 }
+                n = n2;
             }
         }
 
-        public:
-        void initialise_bucket(hash_t slot)
+        /// Set the bits of the chain scanned by the initialisation of a
+        /// bucket, published by the release store of the bucket.
+        inline void merge(uint32_t slot, uint64_t w)
         {
-            assert(slot < so_list->n_buckets);
+            __atomic_fetch_or(word_address(slot), w, __ATOMIC_RELAXED);
+        }
 
-            if (so_list->buckets[slot] != nullptr)
-            {
-                return;
-            }
+        inline bool maybe_contains(uint32_t slot, hash_t hashv) const
+        {
+            uint64_t b = bits(hashv);
+            return b == (__atomic_load_n(word_address(slot), __ATOMIC_ACQUIRE) & b);
+        }
+    };
 
-            auto node = new solist_bucket(slot);
-            so_key key = node->key;
-            do
-            {
-                get_parent(slot, key);
-                // cur is the node after which to insert dummy node.
-                node->next = next;
-            }while (
-                    // a.n.other thread successfully has initialised
-                    // the bucket.
-                    nullptr == so_list->buckets[slot]
-                    // a.n.other thread successfully inserted its instance of
-                    // the dummy node.
-                    && (nullptr == next || next->key != key)
-                    // this will fail if the relevant elements of the list
-                    // changed after calling get_parent
-                    && (!cur->next.CAS(next, node)));
+    /// Unique table identity, never reused, so hot cache entries of a
+    /// destroyed table cannot match a table allocated at the same address.
+    uint64_t solist_new_id();
 
-            if (so_list->buckets[slot] == nullptr)
-            {
-                if(cur->next() == node)
-                {
-                    // success!
-                    so_list->buckets[slot] = node;
-                    next = node;
-                }
-                else
-                {
-                    // a.n.other thread inserted its instance of the bucket node.
-                    // Setup the slot correctly to point to that instance,
-                    // so the bucket is guaranteed 
-                    // to be initialised on return.
-                    so_list->buckets[slot] = next;
-                    assert(so_list->buckets[slot]->key == key);
-                    delete node;
-                }
-            }
-            else
-            {
-                // a.n.other thread has already initialised the bucket.
-                delete node;
-            }
+    // Number of entries in the per thread hot key cache, a power of 2.
+#ifndef SOLIST_HOT_CACHE_SIZE
+#define SOLIST_HOT_CACHE_SIZE  1024
+#endif
 
-            assert(nullptr != so_list->buckets[slot]);
-            assert(so_list->buckets[slot]->key == key);
+    struct solist_hot_entry
+    {
+        uint64_t        table_id;
+        // Retire epoch of the table read before the node was found.
+        uint64_t        epoch;
+        solist_bucket*  node;
+        hash_t          hashv;
+    };
+
+    /// Per thread direct mapped cache of hash values to data nodes,
+    /// shared by all tables, see solist_accessor::enable_hot_cache.
+    /// Entries are valid while no node of the table has been retired
+    /// since the entry was filled.
+    struct solist_hot_cache
+    {
+        static constexpr std::size_t SIZE = SOLIST_HOT_CACHE_SIZE;
+        static_assert(0 == (SIZE & (SIZE - 1)), "SOLIST_HOT_CACHE_SIZE must be a power of 2");
+        solist_hot_entry    entries[SIZE] = {};
+
+        inline solist_hot_entry& entry(uint64_t table_id, hash_t hashv)
+        {
+            return entries[(hashv ^ (table_id * 0x9e3779b9u)) & (SIZE - 1)];
         }
 
-        private:
-        bool find_node(hash_t hashv)
+        /// Allocated on first use, threads not using the cache pay nothing.
+        static solist_hot_cache& local()
         {
-            uint32_t slot = hashv % so_list->n_buckets;
-            so_key key = sol_node_key(hashv);
+            thread_local std::unique_ptr<solist_hot_cache> cache(new solist_hot_cache());
+            return *cache;
+        }
+    };
 
-            if(so_list->buckets[slot] == nullptr)
-            {
-                // lazy initialisation of a bucket
-                initialise_bucket(slot);
-            }
-            
-find_node_try_again:
-            prev = cur = so_list->buckets[slot];
-            next = cur->next();
+#if 0
+    template <typename T> class solist_traverse
+    {
+        solist_bucket* hp[3];
+        public:
+        inline solist_bucket* next() { return hp[0]; }
+        inline solist_bucket* cur() { return hp[1]; }
+        inline solist_bucket* prev() { return hp[1]; }
+    };
+#endif
 
-            steps = 0;
-            while((nullptr != next) && (next->key <= key))
+    /// Options of a solist, see the solist constructor.
+    enum solist_option : unsigned
+    {
+        /// Per bucket Bloom filters, see solist_bucket_filter.
+        solist_bucket_filters = 1,
+        /// First data node hints in the directory, see solist_directory.
+        solist_bucket_hints = 2,
+        /// A random seed for the key hash, see solist_key_hash.
+        solist_seeded_hash = 4,
+        /// A change data capture feed, see solist_cdc.
+        solist_cdc_feed = 8,
+        /// Flat combining of operations on hot buckets, see solist_combiner.
+        solist_flat_combining = 16,
+    };
+
+    /// The solist_option flags a payload type does not support, for
+    /// example node types which bypass the single item lookup paths.
+    template <typename T> struct solist_unsupported_options
+    {
+        static constexpr unsigned value = 0;
+    };
+
+    /// Optional features of a solist, allocated on first use, so a table
+    /// which uses none of them costs a pointer for all of them.
+    template <typename T> struct solist_extension
+    {
+        // Background teardown of the list, destroyed after the other
+        // members of the solist, see solist_extension_ptr.
+        solist_deferred_teardown    deferred_teardown;
+        // Hash of keys for the key aware accessor interface, seeded by
+        // the solist_seeded_hash option.
+        solist_key_hash     key_hash;
+        // Optional bucket filters, set at construction.
+        std::unique_ptr<solist_bucket_filter>   filters;
+        // Optional change data capture feed, set at construction, the
+        // inserts, updates and deletes of solist_accessor are recorded.
+        // Shared, so consumers can outlive the table, and so that the
+        // payload type need not be complete for tables without a feed.
+        std::shared_ptr<solist_cdc<T>>  cdc;
+        // Optional flat combining of hot buckets, set at construction.
+        std::unique_ptr<solist_combiner>    combiner;
+        // Backoff of the retry loops of accessors after a failed CAS.
+        std::atomic<solist_backoff_policy>  backoff_policy{solist_backoff_policy::adaptive};
+        // Freeing of the nodes on destruction, see solist::set_teardown.
+        solist_teardown_policy  teardown_policy = solist_teardown_policy::serial;
+        unsigned                teardown_threads = 0;
+    };
+
+    /// Owner of the extension of a solist, the first member of the solist,
+    /// so the extension is destroyed after the other members.
+    template <typename E> class solist_extension_ptr
+    {
+        E*  ptr = nullptr;
+
+        public:
+        solist_extension_ptr() = default;
+        // Non copyable
+        solist_extension_ptr& operator=(const solist_extension_ptr&) = delete;
+        solist_extension_ptr(solist_extension_ptr const&) = delete;
+
+        ~solist_extension_ptr()
+        {
+            delete ptr;
+        }
+
+        /// \@return the extension, or nullptr if it has not been created.
+        inline E* get() const
+        {
+            return __atomic_load_n(&ptr, __ATOMIC_SEQ_CST);
+        }
+
+        /// \@return the extension, created if required, thread safe.
+        E& create()
+        {
+            E* e = get();
+            if (nullptr == e)
             {
-                if (!advance())
+                E* expected = nullptr;
+                e = new E();
+                if (!__atomic_compare_exchange_n(&ptr, &expected, e, false,
+                            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
                 {
-                    goto find_node_try_again;
+                    delete e;
+                    e = expected;
                 }
-                ++steps;
-            }
-
-            if((nullptr == cur) || (cur->key != key))
-            {
-                return false;
             }
-            assert(cur->key == key);
-            return true;
+            return *e;
         }
+    };
 
-        public:
-        // insert is the most expensive operation because
+    /// \@param D - the bucket directory, solist_directory, or for a fixed
+    ///     number of buckets solist_fixed_directory, see solist_fixed.
+    template <typename T, typename D=solist_directory> struct solist
+    {
+        // Optional features, see solist_extension.
+        solist_extension_ptr<solist_extension<T>>   ext;
+        uint32_t            max_bucket_length = 4;
+        uint32_t            n_items = 0;
+        const uint64_t      id = solist_new_id();
+        // Incremented on every retire of a node, validates hot cache
+        // entries.
+        uint64_t            retire_epoch = 0;
+        D                   buckets;
+        // Hazard pointer domain for safe reclamation of deleted nodes,
+        // shared with other containers, by default the process wide domain.
+        std::shared_ptr<hazptr_domain>  hp_domain;
+
+        // Non copyable
+        solist& operator=(const solist&) = delete;
+        solist(solist const&) = delete;
+
+        // Non movable
+        solist& operator=(solist&&) = delete;
+        solist(solist&&) = delete;
+
+        explicit solist(uint32_t size, std::shared_ptr<hazptr_domain> dom=hazptr_global_domain()):
+            buckets(size),hp_domain(dom)
+        {
+            init_buckets();
+        }
+
+        // Buckets are initialised lazily, except in a directory which
+        // never expands, where all of them are linked up front, in key order.
+        void init_buckets()
+        {
+            if (D::expandable)
+            {
+                buckets.set(0, new solist_bucket(0));
+                return;
+            }
+            solist_bucket* last = nullptr;
+            uint32_t shift = __builtin_clz(buckets.size()) + 1;
+            for(uint32_t i = 0; i < buckets.size(); ++i)
+            {
+                uint32_t slot = reverse_hasht_bits(i) >> shift;
+                auto bucket = new solist_bucket(slot);
+                if (nullptr != last)
+                {
+                    last->next.store(bucket, std::memory_order_relaxed);
+                }
+                buckets.set(slot, bucket);
+                last = bucket;
+            }
+        }
+
+        inline void inc_item_count()
+        {
+            __atomic_add_fetch(&n_items, 1, __ATOMIC_RELEASE); 
+        }
+
+        inline void dec_item_count()
+        {
+            __atomic_sub_fetch(&n_items, 1, __ATOMIC_RELEASE); 
+        }
+
+        inline uint32_t item_count() const
+        {
+            return __atomic_load_n(&n_items, __ATOMIC_ACQUIRE);
+        }
+
+        /// Set the backoff after a failed CAS, by default adaptive,
+        /// takes effect for operations started after the call.
+        inline void set_backoff_policy(solist_backoff_policy policy)
+        {
+            ext.create().backoff_policy.store(policy, std::memory_order_relaxed);
+        }
+
+        /// Set how the nodes are freed when the table is destroyed, by
+        /// default serially by the destroying thread.
+        /// \@param threads - the number of threads freeing partitions of
+        ///     the list, 0 for the number of hardware threads, the
+        ///     background policy frees on the reaper thread and as many
+        ///     more.
+        ///     Small tables are freed by a single thread.
+        inline void set_teardown(solist_teardown_policy policy, unsigned threads=0)
+        {
+            solist_extension<T>& e = ext.create();
+            e.teardown_policy = policy;
+            e.teardown_threads = threads;
+        }
+
+        explicit solist(uint32_t size, uint32_t bucket_length,
+                std::shared_ptr<hazptr_domain> dom=hazptr_global_domain()):
+            max_bucket_length(bucket_length),buckets(size),hp_domain(dom)
+        {
+            init_buckets();
+        }
+
+        // Options not supported by T are rejected, and ignored in release
+        // builds.
+        static inline unsigned supported(unsigned options)
+        {
+            assert(0 == (options & solist_unsupported_options<T>::value));
+            return options & ~solist_unsupported_options<T>::value;
+        }
+
+        /// \@param options - solist_option flags,
+        ///     solist_bucket_filters for workloads where most lookups miss,
+        ///     solist_bucket_hints to save a cache miss per lookup,
+        ///     solist_seeded_hash for keys chosen by untrusted parties,
+        ///     solist_cdc_feed to record mutations for replication,
+        ///     solist_flat_combining for many threads updating few keys.
+        explicit solist(uint32_t size, uint32_t bucket_length, unsigned options,
+                std::shared_ptr<hazptr_domain> dom=hazptr_global_domain()):
+            max_bucket_length(bucket_length),
+            buckets(size, 0 != (supported(options) & solist_bucket_hints)),hp_domain(dom)
+        {
+            options = supported(options);
+            if (0 != (options & solist_seeded_hash))
+            {
+                ext.create().key_hash = solist_key_hash(solist_random_seed());
+            }
+            if (0 != (options & solist_bucket_filters))
+            {
+                ext.create().filters.reset(new solist_bucket_filter(buckets.size()));
+            }
+            if (0 != (options & solist_cdc_feed))
+            {
+                ext.create().cdc.reset(new solist_cdc<T>());
+            }
+            if (0 != (options & solist_flat_combining))
+            {
+                ext.create().combiner.reset(new solist_combiner());
+            }
+            init_buckets();
+        }
+
+        /// The optional features, nullptr if not in use.
+        inline solist_bucket_filter* filters() const
+        {
+            solist_extension<T>* e = ext.get();
+            return nullptr == e ? nullptr : e->filters.get();
+        }
+
+        /// The change data capture feed, nullptr if not enabled, see
+        /// solist_cdc_feed.
+        inline solist_cdc<T>* change_feed() const
+        {
+            solist_extension<T>* e = ext.get();
+            return nullptr == e ? nullptr : e->cdc.get();
+        }
+
+        /// Replace the change feed, for example by one with a different
+        /// ring capacity, before the table is shared.
+        inline void set_change_feed(std::shared_ptr<solist_cdc<T>> feed)
+        {
+            ext.create().cdc = feed;
+        }
+
+        /// The flat combiner of hot buckets, nullptr if not enabled, see
+        /// solist_flat_combining.
+        inline solist_combiner* flat_combiner() const
+        {
+            solist_extension<T>* e = ext.get();
+            return nullptr == e ? nullptr : e->combiner.get();
+        }
+
+        /// Replace the flat combiner, for example by one with different
+        /// thresholds, before the table is shared, takes ownership of fc.
+        inline void set_flat_combiner(solist_combiner* fc)
+        {
+            ext.create().combiner.reset(fc);
+        }
+
+        /// Key hash of the table, for the key aware accessor interface.
+        inline hash_t key_hash(uint32_t key) const
+        {
+            solist_extension<T>* e = ext.get();
+            return nullptr == e ? unseeded_hash()(key) : e->key_hash(key);
+        }
+
+        inline hash_t key_hash(const void* key, std::size_t len) const
+        {
+            solist_extension<T>* e = ext.get();
+            return nullptr == e ? unseeded_hash()(key, len) : e->key_hash(key, len);
+        }
+
+        static const solist_key_hash& unseeded_hash()
+        {
+            static const solist_key_hash hash;
+            return hash;
+        }
+
+        /// Invalidate the hot cache entries of the table, by an accessor
+        /// retiring a node, see solist_accessor::enable_hot_cache.
+        inline void bump_retire_epoch()
+        {
+            __atomic_add_fetch(&retire_epoch, 1, __ATOMIC_SEQ_CST);
+        }
+
+        inline solist_backoff_policy backoff_policy() const
+        {
+            solist_extension<T>* e = ext.get();
+            return nullptr == e ? solist_backoff_policy::adaptive
+                : e->backoff_policy.load(std::memory_order_relaxed);
+        }
+
+        ~solist()
+        {
+            solist_extension<T>* e = ext.get();
+            if (nullptr == e || solist_teardown_policy::serial == e->teardown_policy)
+            {
+                destroy_range(buckets[0], nullptr);
+                return;
+            }
+            std::vector<solist_bucket*> splits = partition(e->teardown_threads);
+            if (solist_teardown_policy::background == e->teardown_policy)
+            {
+                e->deferred_teardown.defer([splits]{ destroy_ranges(splits); });
+                return;
+            }
+            destroy_ranges(splits);
+        }
+
+        // Free the nodes from first up to, but excluding, end.
+        static void destroy_range(solist_bucket* first, solist_bucket* end)
+        {
+            solist_bucket* cur = first;
+            solist_bucket* next;
+
+            while(end != cur)
+            {
+                next = cur->next.load(std::memory_order_relaxed);
+                if (cur->is_node())
+                {
+                    solist_node<T>::destroy(static_cast<solist_node<T>*>(cur));
+                }
+                else
+                {
+                    delete cur;
+                }
+                cur = next;
+            }
+        }
+
+        // Bucket nodes which split the list into teardown ranges of about
+        // the same number of buckets, in list order, the first is
+        // buckets[0], the last range ends at the end of the list.
+        // The bucket node at list position p is that of slot
+        // reverse(p), uninitialised slots merge adjacent ranges.
+        std::vector<solist_bucket*> partition(unsigned threads) const
+        {
+            // Ranges of fewer items are not worth a thread.
+            constexpr uint32_t MIN_RANGE_ITEMS = 1 << 16;
+            uint32_t n = threads;
+            if (0 == n)
+            {
+                n = std::max(1u, std::thread::hardware_concurrency());
+            }
+            n = std::min(n, 1 + n_items / MIN_RANGE_ITEMS);
+            uint32_t size = buckets.size();
+            n = std::min(n, size);
+            uint32_t shift = __builtin_clz(size) + 1;
+            std::vector<solist_bucket*> splits{buckets[0]};
+            for(uint32_t i = 1; i < n; ++i)
+            {
+                solist_bucket* bucket = buckets[reverse_hasht_bits(i * (size / n)) >> shift];
+                if (nullptr != bucket)
+                {
+                    splits.push_back(bucket);
+                }
+            }
+            return splits;
+        }
+
+        // Free the ranges of splits, the first on the calling thread.
+        static void destroy_ranges(const std::vector<solist_bucket*>& splits)
+        {
+            std::vector<std::thread> threads;
+            for(std::size_t i = 1; i < splits.size(); ++i)
+            {
+                solist_bucket* end = i + 1 < splits.size() ? splits[i + 1] : nullptr;
+                try
+                {
+                    threads.emplace_back(destroy_range, splits[i], end);
+                }
+                catch(const std::system_error&)
+                {
+                    destroy_range(splits[i], end);
+                }
+            }
+            destroy_range(splits[0], splits.size() > 1 ? splits[1] : nullptr);
+            for(auto& t : threads)
+            {
+                t.join();
+            }
+        }
+
+        void expand(uint32_t curr_size)
+        {
+            if (filters())
+            {
+                // The filter words exist before the slots.
+                filters()->reserve(curr_size << 1);
+            }
+            buckets.expand(curr_size);
+        }
+    };
+
+    // A small table stays within a cache line and a half, the optional
+    // features live in the extension, see solist_extension.
+    static_assert(sizeof(void*) != 8 || sizeof(solist<uint64_t>) <= 96,
+            "solist<T> grew, move the new member to solist_extension");
+
+#if 0
+    template <typename T, typename D> class solist_accessor;
+    template <typename T> void dump_solist_buckets(solist_accessor<T>& sol);
+    template <typename T> void dump_solist_keys(solist_accessor<T>& sol);
+    template <typename T> void dump_solist_key_order(solist_accessor<T>& sol);
+    template <typename T> void dump_solist(solist_accessor<T>& sol);
+    template <typename T> void dump_solist_items(solist_accessor<T>& sol);
+    template <typename T> void check_solist(solist_accessor<T>& sol);
+#endif
+
+    template <typename T, typename D=solist_directory> class solist_accessor
+    {
+        protected:
+        std::shared_ptr<solist<T, D>> so_list;
+
+        // Hazard pointer context of the calling thread for the domain
+        // associated with so_list.
+        solist_hazptr_context* hpc = nullptr;
+        // Hazard pointer slots for next, cur and prev.
+        static constexpr std::size_t HP_NEXT = 0;
+        static constexpr std::size_t HP_CUR = 1;
+        static constexpr std::size_t HP_PREV = 2;
+
+        solist_bucket *next;
+        solist_bucket *cur;
+        solist_bucket *prev;
+        // Fingerprint of the key of next.
+        uintptr_t   next_tag;
+        unsigned    steps;
+        // Status of unreclaimed memory after the last mutation.
+        hazptr_status   last_status = hazptr_status::ok;
+        bool            hot_cache = false;
+
+#if 0
+        friend void dump_solist_buckets(solist_accessor<T>& sol);
+        friend void dump_solist_keys(solist_accessor<T>& sol);
+        friend void dump_solist_key_order(solist_accessor<T>& sol);
+        friend void dump_solist(solist_accessor<T>& sol);
+        friend void dump_solist_items(solist_accessor<T>& sol);
+        friend void check_solist(solist_accessor<T>& sol);
+#else
+        template <typename U> friend void dump_solist_buckets(solist_accessor<U>& sol);
+        template <typename U> friend void dump_solist_keys(solist_accessor<U>& sol);
+        template <typename U> friend void dump_solist_key_order(solist_accessor<U>& sol);
+        template <typename U> friend void dump_solist(solist_accessor<U>& sol);
+        template <typename U> friend void dump_solist_items(solist_accessor<U>& sol);
+        template <typename U> friend void check_solist(solist_accessor<U>& sol);
+#endif       
+
+        // Load the successor of cur into next, protected by a hazard pointer.
+        // The hazard pointer is valid if cur->next is unchanged after
+        // the hazard pointer has been set.
+        // \@return false if cur has been marked for deletion.
+        inline bool load_next()
+        {
+            bool marked;
+            bool vmarked;
+            solist_bucket* n;
+            do
+            {
+                // acquire, the contents of the node are published by
+                // release CAS operations.
+                n = cur->next.load(&marked, &next_tag, std::memory_order_acquire);
+                hpc->store(HP_NEXT, n);
+                // The hazard pointer store is sequentially consistent,
+                // so the validating load must be too, to be ordered after it.
+            }while(n != cur->next.load(&vmarked, std::memory_order_seq_cst) || marked != vmarked);
+            next = n;
+            return !marked;
+        }
+
+        // Compare the key of next with key, the fingerprint of the key
+        // of next is checked first to avoid dereferencing next.
+        // \@return true if next->key <= key
+        inline bool next_key_le(so_key key)
+        {
+            if (sol_key_fingerprints && next_tag > sol_key_fingerprint(key))
+            {
+                return false;
+            }
+            return next->key <= key;
+        }
+
+        // \@return true if next->key < key
+        inline bool next_key_lt(so_key key)
+        {
+            if (sol_key_fingerprints && next_tag > sol_key_fingerprint(key))
+            {
+                return false;
+            }
+            return next->key < key;
+        }
+
+        inline void retire(solist_bucket* node)
+        {
+            // Only data nodes are ever deleted.
+            assert(node->is_node());
+            // Invalidates hot cache entries, before any scan of hazard
+            // pointers that could reclaim node.
+            so_list->bump_retire_epoch();
+            if (so_list->buckets.has_hints())
+            {
+                clear_hints(node);
+            }
+            last_status = hpc->retire(static_cast<solist_node<T>*>(node));
+        }
+
+        // Retire unlinked data nodes, queued directly on the domain rather
+        // than through the retire buffer of the thread.
+        void retire_batch(generic_hazptr_t* nodes, std::size_t count)
+        {
+            if (0 == count)
+            {
+                return;
+            }
+            so_list->bump_retire_epoch();
+            if (so_list->buckets.has_hints())
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                {
+                    clear_hints(reinterpret_cast<solist_bucket*>(nodes[i]));
+                }
+            }
+            so_list->hp_domain->enqueue_for_delete(nodes, hazptr_reclaimer<solist_node<T>>::instance(), count);
+            last_status = so_list->hp_domain->throttle();
+        }
+
+        // Clear any directory hints to node, before it is retired.
+        // node may be the hint of the slot of its hash value at any size
+        // since it was linked.
+        // The fence orders the loads of the hints after the mark of node,
+        // see refresh_hint.
+        void clear_hints(solist_bucket* node)
+        {
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            hash_t hashv = node->hashv();
+            for(uint32_t n = so_list->buckets.size(); 0 != n; n >>= 1)
+            {
+                so_list->buckets.hint_cas(hashv % n, node, nullptr);
+            }
+        }
+
+        // Set the hint of a bucket to its first data node, cur is the
+        // bucket node, next is protected.
+        void refresh_hint(uint32_t slot)
+        {
+            solist_bucket* first = (nullptr != next && next->is_node()) ? next : nullptr;
+            uintptr_t tag;
+            solist_bucket* h = so_list->buckets.hint(slot, &tag);
+            if (h != first && so_list->buckets.hint_cas(slot, h, first) && nullptr != first)
+            {
+                // If first has been marked, its retire may have cleared
+                // the hints before the CAS, sequentially consistent, so
+                // either the mark is seen here, or clear_hints sees the hint.
+                bool marked;
+                first->next.load(&marked, std::memory_order_seq_cst);
+                if (marked)
+                {
+                    so_list->buckets.hint_cas(slot, first, nullptr);
+                }
+            }
+        }
+
+        // Position cur on the first data node of a bucket, from the
+        // directory hint, skipping the load of the bucket node.
+        // prev is the bucket node, if the hint is stale it is not the
+        // predecessor of cur, so an unlink of cur fails, harmlessly.
+        // \@return false if the hint is not usable for key.
+        bool start_at_hint(uint32_t slot, so_key key)
+        {
+            uintptr_t tag;
+            solist_bucket* h = so_list->buckets.hint(slot, &tag);
+            if (nullptr == h || (sol_key_fingerprints && tag > sol_key_fingerprint(key)))
+            {
+                return false;
+            }
+            hpc->store(HP_CUR, h);
+            if (h != so_list->buckets.hint_seq_cst(slot) || h->key > key)
+            {
+                return false;
+            }
+            prev = so_list->buckets[slot];
+            hpc->store(HP_PREV, prev);
+            cur = h;
+            return load_next();
+        }
+
+        // Step forward one node, nodes marked for deletion are unlinked.
+        // \@return false if the traversal must be restarted.
+        inline bool advance()
+        {
+            prev = cur;
+            hpc->store(HP_PREV, prev);
+            cur = next;
+            hpc->store(HP_CUR, cur);
+            if (nullptr != cur && !load_next())
+            {
+                // cur has been marked for deletion, help unlink it,
+                // the thread which unlinks the node retires it.
+                // If cur has already been unlinked, next may have been
+                // reclaimed, so it is not dereferenced for its tag.
+                if (prev->next.CAS_tagged(cur, next, next_tag, std::memory_order_release))
+                {
+                    retire(cur);
+                }
+                return false;
+            }
+            return true;
+        }
+
+        inline void zap()
+        {
+            prev = cur = next = nullptr;
+            if (nullptr != hpc)
+            {
+                hpc->clear();
+            }
+        }
+
+        inline solist_backoff backoff() const
+        {
+            return solist_backoff(so_list->backoff_policy());
+        }
+
+        void hazp_acquire()
+        {
+            // The block of 3 hazard pointers is reserved by the context
+            // of the calling thread, in the "domain" associated with
+            // the solist instance.
+            // Contexts are per thread, so the context is looked up on
+            // every operation, which allows accessors to be passed between
+            // threads.
+            hpc = &solist_hazptr_context::local(so_list->hp_domain);
+        }
+
+        void hazp_release()
+        {
+            // The hazard pointers are owned by the thread context
+            // and are released on thread exit.
+            zap();
+        }
+
+        public:
+        solist_accessor& operator=(const solist_accessor& other)
+        {
+            hazp_release();
+            so_list = other.so_list;
+            hazp_acquire();
+            return *this;
+        }
+
+        solist_accessor(solist_accessor const& other)
+        {
+            so_list = other.so_list;
+            hazp_acquire();
+        }
+
+        solist_accessor(std::shared_ptr<solist<T, D>> sl):so_list(sl)
+        {
+            hazp_acquire();
+        }
+
+        explicit solist_accessor(uint32_t size)
+        {
+            so_list = std::make_shared<solist<T, D>>(size);
+            hazp_acquire();
+        }
+
+        explicit solist_accessor(uint32_t size, uint32_t bucket_length)
+        {
+            so_list = std::make_shared<solist<T, D>>(size, bucket_length);
+            hazp_acquire();
+        }
+
+        explicit solist_accessor(uint32_t size, std::shared_ptr<hazptr_domain> dom)
+        {
+            so_list = std::make_shared<solist<T, D>>(size, dom);
+            hazp_acquire();
+        }
+
+        ~solist_accessor()=default;
+
+        /// Status of unreclaimed memory on the hazard pointer domain,
+        /// after the last mutation.
+        /// Mutations are refused if the domain is over its limit
+        /// and the backpressure policy is hazptr_backpressure::fail.
+        inline hazptr_status status() const
+        {
+            return last_status;
+        }
+
+        /// Look up find_item_node hash values in the per thread hot cache
+        /// first, for skewed read workloads.
+        /// A hit costs a cache entry, a hazard pointer store and two loads
+        /// of the table retire epoch, every delete on the table invalidates
+        /// all entries of the table, so it is of no use with frequent deletes.
+        inline void enable_hot_cache(bool enable=true)
+        {
+            hot_cache = enable;
+        }
+
+        protected:
+        void get_parent(uint32_t slot, so_key key)
+        {
+get_parent_try_again:
+            //find the initialised bucket with highest key value
+            //that is lower than key.
+            so_key key_step = sol_bucket_key(so_list->buckets.size()/2);
+            so_key pb_key = key;
+            uint32_t pb_slot;
+            do
+            {
+                pb_key -= key_step;
+                pb_slot = reverse_hasht_bits(pb_key);
+                if (so_list->buckets[pb_slot])
+                {
+                    break;
+                }
+            }while(0 != pb_key);
+
+            // and then advance to the last data node in that bucket,
+            // there may be none.
+            // Bucket nodes are never deleted, so cannot be marked.
+            prev = cur = so_list->buckets[pb_slot];
+            hpc->store(HP_PREV, prev);
+            hpc->store(HP_CUR, cur);
+            load_next();
+    
+            while(nullptr != next && next_key_lt(key))
+            {
+                if (!advance())
+                {
+                    goto get_parent_try_again;
+                }
+            }
+        }
+
+        public:
+        void initialise_bucket(hash_t slot)
+        {
+            assert(slot < so_list->buckets.size());
+
+            if (so_list->buckets[slot] != nullptr)
+            {
+                return;
+            }
+
+            hazp_acquire();
+            auto node = new solist_bucket(slot);
+            so_key key = node->key;
+            solist_bucket* bucket = nullptr;
+            solist_backoff contention = backoff();
+            while(nullptr == so_list->buckets[slot])
+            {
+                get_parent(slot, key);
+                if (nullptr != next && next->key == key)
+                {
+                    // a.n.other thread successfully inserted its instance of
+                    // the dummy node.
+                    bucket = next;
+                    break;
+                }
+                // cur is the node after which to insert dummy node.
+                // node is not yet visible to other threads, the CAS
+                // publishes it.
+                node->next.store(next, std::memory_order_relaxed);
+                // this will fail if the relevant elements of the list
+                // changed after calling get_parent
+                if (cur->next.CAS(next, node, std::memory_order_release))
+                {
+                    // success!
+                    bucket = node;
+                    node = nullptr;
+                    break;
+                }
+                contention.pause();
+            }
+
+            if (nullptr != bucket && so_list->filters())
+            {
+                scan_bucket(slot, bucket);
+            }
+
+            if (nullptr != bucket)
+            {
+                // Setup the slot correctly to point to the bucket node
+                // in the list, so the bucket is guaranteed 
+                // to be initialised on return.
+                so_list->buckets.set(slot, bucket);
+            }
+
+            if (nullptr != node)
+            {
+                // a.n.other thread has already initialised the bucket.
+                delete node;
+            }
+
+            assert(nullptr != so_list->buckets[slot]);
+            assert(so_list->buckets[slot]->key == key);
+        }
+
+        protected:
+        // Build the filter word of a bucket, from the data nodes up to
+        // the next initialised bucket, see solist_bucket_filter.
+        void scan_bucket(uint32_t slot, solist_bucket* bucket)
+        {
+            uint64_t w = 0;
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+scan_bucket_try_again:
+            prev = cur = bucket;
+            hpc->store(HP_PREV, prev);
+            hpc->store(HP_CUR, cur);
+            load_next();
+            while(nullptr != next && next->is_node())
+            {
+                if (!advance())
+                {
+                    goto scan_bucket_try_again;
+                }
+                w |= solist_bucket_filter::bits(cur->hashv());
+            }
+            so_list->filters()->merge(slot, w);
+        }
+
+        // \@return false if the bucket filter shows hashv is absent.
+        inline bool maybe_present(hash_t hashv)
+        {
+            if (!so_list->filters())
+            {
+                return true;
+            }
+            uint32_t slot = hashv % so_list->buckets.size();
+            if (D::expandable && nullptr == so_list->buckets[slot])
+            {
+                initialise_bucket(slot);
+            }
+            return so_list->filters()->maybe_contains(slot, hashv);
+        }
+
+        bool find_node(hash_t hashv)
+        {
+            uint32_t slot = hashv % so_list->buckets.size();
+            so_key key = sol_node_key(hashv);
+
+            if(D::expandable && so_list->buckets[slot] == nullptr)
+            {
+                // lazy initialisation of a bucket
+                initialise_bucket(slot);
+            }
+
+            if (so_list->buckets.has_hints() && start_at_hint(slot, key))
+            {
+                steps = 1;
+                goto find_node_traverse;
+            }
+            
+find_node_try_again:
+            prev = cur = so_list->buckets[slot];
+            hpc->store(HP_PREV, prev);
+            hpc->store(HP_CUR, cur);
+            load_next();
+            if (so_list->buckets.has_hints())
+            {
+                refresh_hint(slot);
+            }
+
+            steps = 0;
+find_node_traverse:
+            while((nullptr != next) && next_key_le(key))
+            {
+                if (!advance())
+                {
+                    goto find_node_try_again;
+                }
+                ++steps;
+            }
+
+            if((nullptr == cur) || (cur->key != key))
+            {
+                return false;
+            }
+            assert(cur->key == key);
+            return true;
+        }
+
+        // As find_node, for tables where nodes of equal hash values
+        // coexist, such as solist_blob tables, they are adjacent in the list.
+        // \@return true if cur is a node of hashv for which
+        //  match(solist_node<T>*) is true, else cur is the last node
+        //  with a key not above the key of hashv, after which a node of
+        //  hashv is linked.
+        template <typename M> bool find_node_if(hash_t hashv, M match)
+        {
+            uint32_t slot = hashv % so_list->buckets.size();
+            so_key key = sol_node_key(hashv);
+
+            if(D::expandable && so_list->buckets[slot] == nullptr)
+            {
+                initialise_bucket(slot);
+            }
+
+            if (so_list->buckets.has_hints() && start_at_hint(slot, key))
+            {
+                steps = 1;
+                goto find_node_if_traverse;
+            }
+
+find_node_if_try_again:
+            prev = cur = so_list->buckets[slot];
+            hpc->store(HP_PREV, prev);
+            hpc->store(HP_CUR, cur);
+            load_next();
+            if (so_list->buckets.has_hints())
+            {
+                refresh_hint(slot);
+            }
+
+            steps = 0;
+find_node_if_traverse:
+            while((nullptr != next) && next_key_lt(key))
+            {
+                if (!advance())
+                {
+                    goto find_node_if_try_again;
+                }
+                ++steps;
+            }
+            // A hint may be the first node of hashv.
+            if (cur->key == key && match(static_cast<solist_node<T>*>(cur)))
+            {
+                return true;
+            }
+            while((nullptr != next) && next_key_le(key))
+            {
+                if (!advance())
+                {
+                    goto find_node_if_try_again;
+                }
+                ++steps;
+                if (match(static_cast<solist_node<T>*>(cur)))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // insert is the most expensive operation because
         // it is the best location to amortise some of the 
         // cost of automatic expanding the number of buckets.
         // FIXME: explore using bucket item counters.
         // complexity getting the counts correct on bucket split.
-        bool insert_node(hash_t hashv, T payload)
+        // Takes ownership of dnode, which is destroyed if it is not linked.
+        bool link_node(hash_t hashv, solist_node<T>* dnode)
         {
-            bool result = false;
-            uint32_t    nbuckets = so_list->n_buckets;
-            auto dnode = new solist_node<T>(payload, hashv);
+            bool made = false;
+            bool result = link_node(hashv,
+                    [&]{ made = true; return dnode; },
+                    [](solist_node<T>*){});
+            if (!made)
+            {
+                solist_node<T>::destroy(dnode);
+            }
+            return result;
+        }
+
+        // Link the node returned by make() for hashv, or if hashv is present
+        // call present(node) instead, in a single traversal, node is
+        // protected for the duration of the call.
+        // make() is only called if hashv is absent, it may return nullptr
+        // not to link a node, a node made but not linked is destroyed.
+        // \@return true if a node was linked.
+        template <typename M, typename P> bool link_node(hash_t hashv, M make, P present)
+        {
+            return link_node(hashv, make, present, [this](hash_t h){ return find_node(h); });
+        }
 
+        // As link_node, find(hashv) positions cur, see find_node_if.
+        template <typename M, typename P, typename F> bool link_node(hash_t hashv, M make, P present, F find)
+        {
+            bool result = false;
+            hazp_acquire();
+            uint32_t    nbuckets = so_list->buckets.size();
+            uint32_t    fsize = 0;
+            solist_node<T>* dnode = nullptr;
+            solist_backoff contention = backoff();
             while(true)
             {
-                if(find_node(hashv))
+                if(find(hashv))
                 {
+                    present(static_cast<solist_node<T>*>(cur));
                     break;
                 }
-                
-                dnode->next = next;
-                if(cur->next.CAS(next, dnode))
+
+                if (nullptr == dnode)
+                {
+                    // Admission and the filter bits only matter to inserts,
+                    // so operations on present items do not write them.
+                    if (hazptr_status::over_limit == (last_status = hpc->admit()))
+                    {
+                        break;
+                    }
+                    if (so_list->filters())
+                    {
+                        fsize = so_list->filters()->add(so_list->buckets, hashv);
+                    }
+                    if (nullptr == (dnode = make()))
+                    {
+                        break;
+                    }
+                }
+                dnode->next.store(next, std::memory_order_relaxed);
+                if(cur->next.CAS(next, dnode, std::memory_order_release))
                 {
                     so_list->inc_item_count();
                     result = true;
                     break;
                 }
+                contention.pause();
             }
 
-            if (!result)
+            if (0 != contention.count() && so_list->flat_combiner())
             {
-                delete dnode;
+                so_list->flat_combiner()->contended(hashv % nbuckets, contention.count());
             }
-            else
+
+            if (result && so_list->filters())
             {
-                // !!!WARNING!!!  if we need to initialise a hazard pointer to the
-                // newly added node then we should set that before proceeding with
-                // the expansion check.
+                so_list->filters()->confirm(so_list->buckets, hashv, fsize);
+            }
 
-                next = cur->next();
+            if (!result)
+            {
+                if (nullptr != dnode)
+                {
+                    solist_node<T>::destroy(dnode);
+                }
+            }
+            else if (D::expandable)
+            {
+                // The newly added node is protected by the hazard pointer
+                // for next before proceeding with the expansion check.
+                if (!load_next())
+                {
+                    // FIXME: for now chicken out and just return
+                    zap();
+                    return result;
+                }
 
                 // added a node, so do expansion check.
                 while(nullptr != next && next->is_node())
@@ -483,16 +1555,21 @@ find_node_try_again:
                 if(steps > so_list->max_bucket_length)
                 {
                     // Record the bucket number before expansion.
-                    uint32_t slot = hashv % so_list->n_buckets;
+                    uint32_t slot = hashv % nbuckets;
                     // expand if
                     // 1) the bucket is overflows by a factor of 2 FIXME (make the factor configurable) 
                     //      this can happen for pathological insert sequences where
                     //      inserts are to the same bucket repeatedly.
                     // 2) all the buckets are full
+                    // The chain from a sentinel runs to the next initialised
+                    // sentinel, in a sparsely initialised table that can be
+                    // long whatever the size, so 1) requires an average
+                    // bucket length of at least 1, else expansion runs away.
                     if (
-                            (steps >= ((so_list->max_bucket_length * 2)))
+                            ((steps >= ((so_list->max_bucket_length * 2)))
+                             && (so_list->item_count() >= nbuckets))
                             ||
-                            (so_list->n_items >= (so_list->max_bucket_length * so_list->n_buckets))
+                            (so_list->item_count() >= (so_list->max_bucket_length * so_list->buckets.size()))
                        )
                     {
                         so_list->expand(nbuckets);
@@ -507,7 +1584,7 @@ find_node_try_again:
                         // Check that the bucket exists before attempting to 
                         // initialise it.
                         // This is a result of delaying expensive expansion.
-                        if (ib_slot < so_list->n_buckets)
+                        if (ib_slot < so_list->buckets.size())
                         {
                             initialise_bucket(ib_slot);
                         }
@@ -518,53 +1595,572 @@ find_node_try_again:
             return result;
         }
 
+        bool insert_direct(hash_t hashv, const T& payload)
+        {
+            if (!link_node(hashv, new solist_node<T>(payload, hashv)))
+            {
+                return false;
+            }
+            if (so_list->change_feed())
+            {
+                so_list->change_feed()->append_insert(hashv, payload);
+            }
+            return true;
+        }
+
+        // Apply a posted operation, in the combining thread.
+        inline void apply(solist_fc_record* rec)
+        {
+            // The operation updates the status of the poster's accessor,
+            // not the status of the combiner's.
+            hazptr_status own_status = last_status;
+            last_status = rec->status;
+            switch(rec->op)
+            {
+                case solist_fc_delete:
+                    rec->result = delete_direct(rec->hashv);
+                    break;
+                default:
+                    // Tables whose nodes are not built from a payload,
+                    // such as solist_blob, never post these.
+                    if constexpr (std::is_constructible<solist_node<T>, const T&, hash_t>::value)
+                    {
+                        const T& payload = *static_cast<const T*>(rec->payload);
+                        switch(rec->op)
+                        {
+                            case solist_fc_insert:
+                                rec->result = insert_direct(rec->hashv, payload);
+                                break;
+                            case solist_fc_replace:
+                                rec->result = replace_direct(rec->hashv, payload);
+                                break;
+                            case solist_fc_insert_or_assign:
+                                rec->result = insert_or_assign_direct(rec->hashv, payload);
+                                break;
+                            default:
+                                break;
+                        }
+                    }
+                    break;
+            }
+            rec->status = last_status;
+            last_status = own_status;
+        }
+
+        // Post an operation on a combined bucket and wait for it, the
+        // thread holding the channel lock applies all posted operations.
+        bool combine(uint32_t slot, solist_fc_op op, hash_t hashv, const void* payload)
+        {
+            solist_combiner& fc = *so_list->flat_combiner();
+            solist_fc_record rec(op, hashv, payload, last_status);
+            fc.post(slot, &rec);
+            solist_backoff wait = backoff();
+            while(!rec.done.load(std::memory_order_acquire))
+            {
+                if (!fc.try_lock(slot))
+                {
+                    wait.wait();
+                    continue;
+                }
+                uint32_t count = 0;
+                solist_fc_record* r = fc.take(slot);
+                while(nullptr != r)
+                {
+                    // The poster returns once done is set, so r is not
+                    // accessed after that.
+                    solist_fc_record* next_rec = r->next;
+                    apply(r);
+                    r->done.store(true, std::memory_order_release);
+                    r = next_rec;
+                    ++count;
+                }
+                fc.batch(slot, count);
+                fc.unlock(slot);
+            }
+            last_status = rec.status;
+            return rec.result;
+        }
+
+        // Record the insert or the update of an item by an atomic
+        // operation in the change feed.
+        inline void record_change(hash_t hashv, bool inserted, bool updated, const T& value)
+        {
+            if (so_list->change_feed())
+            {
+                if (inserted)
+                {
+                    so_list->change_feed()->append_insert(hashv, value);
+                }
+                else if (updated)
+                {
+                    so_list->change_feed()->append_update(hashv, value);
+                }
+            }
+        }
+
+        // \@return the slot of hashv if its operations are combined,
+        // else solist_combiner::NONE.
+        inline uint32_t combined_slot(hash_t hashv) const
+        {
+            if (so_list->flat_combiner())
+            {
+                uint32_t slot = hashv % so_list->buckets.size();
+                if (so_list->flat_combiner()->active(slot))
+                {
+                    return slot;
+                }
+            }
+            return solist_combiner::NONE;
+        }
+
+        public:
+        bool insert_node(hash_t hashv, T payload)
+        {
+            uint32_t slot = combined_slot(hashv);
+            if (solist_combiner::NONE != slot)
+            {
+                return combine(slot, solist_fc_insert, hashv, &payload);
+            }
+            return insert_direct(hashv, payload);
+        }
+
         bool delete_node(hash_t hashv)
+        {
+            uint32_t slot = combined_slot(hashv);
+            if (solist_combiner::NONE != slot)
+            {
+                return combine(slot, solist_fc_delete, hashv, nullptr);
+            }
+            return delete_direct(hashv);
+        }
+
+        protected:
+        bool delete_direct(hash_t hashv)
+        {
+            return delete_direct(hashv, [this](hash_t h){ return find_node(h); });
+        }
+
+        // As delete_direct, find(hashv) positions cur, see find_node_if.
+        template <typename F> bool delete_direct(hash_t hashv, F find)
         {
             bool result = false;
+            hazp_acquire();
+            if (hazptr_status::over_limit == (last_status = hpc->admit()))
+            {
+                return false;
+            }
 
-            while(true)
+            solist_backoff contention = backoff();
+            while(maybe_present(hashv) && find(hashv))
             {
-                if(!find_node(hashv))
+                // Mark, this logically deletes the node.
+                if(!cur->next.CAS(next, next, true, std::memory_order_release))
                 {
-                    break;
+                    contention.pause();
+                    continue;
+                }
+                so_list->dec_item_count();
+                result = true;
+                if (so_list->change_feed())
+                {
+                    so_list->change_feed()->append_delete(hashv);
+                }
+
+                // remove, release so that the contents of next are visible
+                // to threads reading the new value of prev->next.
+                if(prev->next.CAS(cur, next, std::memory_order_release))
+                {
+                    retire(cur);
+                }
+                else
+                {
+                    // The list changed, traversing unlinks marked nodes.
+                    find(hashv);
+                }
+                break;
+            }
+
+            if (0 != contention.count() && so_list->flat_combiner())
+            {
+                so_list->flat_combiner()->contended(hashv % so_list->buckets.size(), contention.count());
+            }
+            zap();
+            return result;
+        }
+
+        bool replace_direct(hash_t hashv, const T& payload)
+        {
+            bool result = false;
+            hazp_acquire();
+            if (hazptr_status::over_limit == (last_status = hpc->admit()))
+            {
+                return false;
+            }
+
+            solist_node<T>* dnode = nullptr;
+            solist_backoff contention = backoff();
+            while(maybe_present(hashv) && find_node(hashv))
+            {
+                if (nullptr == dnode)
+                {
+                    dnode = new solist_node<T>(payload, hashv);
                 }
-                
-                // Mark
-                if(!cur->next.CAS(next, next, true))
+                // Once published dnode may be replaced and reclaimed by
+                // other threads, so its tag is computed beforehand.
+                uintptr_t dnode_tag = mark_ptr_tag<solist_bucket>::tag(dnode);
+                dnode->next.store(next, std::memory_order_relaxed);
+                // Mark cur with dnode as its successor, this logically
+                // replaces cur, unlinking cur, by any thread, links dnode.
+                if(!cur->next.CAS(next, dnode, true, std::memory_order_release))
                 {
+                    contention.pause();
                     continue;
                 }
+                result = true;
+                if (so_list->change_feed())
+                {
+                    so_list->change_feed()->append_update(hashv, payload);
+                }
 
-                // remove
-                if(prev->next.CAS(cur, next))
+                if(prev->next.CAS_tagged(cur, dnode, dnode_tag, std::memory_order_release))
                 {
-                   so_list->dec_item_count();
-                   delete cur; 
-                   result = true;
-                   break;
+                    retire(cur);
                 }
+                else
+                {
+                    // The list changed, traversing unlinks marked nodes.
+                    find_node(hashv);
+                }
+                break;
             }
 
+            if (!result && nullptr != dnode)
+            {
+                solist_node<T>::destroy(dnode);
+            }
+            if (0 != contention.count() && so_list->flat_combiner())
+            {
+                so_list->flat_combiner()->contended(hashv % so_list->buckets.size(), contention.count());
+            }
             zap();
             return result;
         }
 
+        bool insert_or_assign_direct(hash_t hashv, const T& payload)
+        {
+            while(!replace_direct(hashv, payload))
+            {
+                if (hazptr_status::over_limit == last_status)
+                {
+                    return false;
+                }
+                if (insert_direct(hashv, payload))
+                {
+                    return true;
+                }
+                if (hazptr_status::over_limit == last_status)
+                {
+                    return false;
+                }
+                // Inserted by a.n.other thread in the meantime.
+            }
+            return false;
+        }
+
+        public:
+        /// Replace the item of hashv, a node with payload is linked in
+        /// place of the node of hashv, which is retired, in a single
+        /// traversal.
+        /// Readers see either the old or the new item, hashv is never
+        /// absent during the replacement.
+        /// \@return false if hashv is absent.
+        bool replace(hash_t hashv, T payload)
+        {
+            uint32_t slot = combined_slot(hashv);
+            if (solist_combiner::NONE != slot)
+            {
+                return combine(slot, solist_fc_replace, hashv, &payload);
+            }
+            return replace_direct(hashv, payload);
+        }
+
+        /// Insert payload for hashv, or if hashv is present replace its
+        /// item, see replace.
+        /// \@return true if inserted, false if replaced, or if refused,
+        /// see status.
+        bool insert_or_assign(hash_t hashv, T payload)
+        {
+            uint32_t slot = combined_slot(hashv);
+            if (solist_combiner::NONE != slot)
+            {
+                return combine(slot, solist_fc_insert_or_assign, hashv, &payload);
+            }
+            return insert_or_assign_direct(hashv, payload);
+        }
+
+        /// Atomic operations on items in place, for payloads the __atomic
+        /// builtins handle lock free, such as integers and pointers.
+        /// An absent hash value is inserted with initial as the previous
+        /// value, the item is found or inserted in a single traversal.
+        /// If the insert is refused, see status, the result is as if
+        /// the operation had failed on initial.
+
+        /// Add delta to the item of hashv.
+        /// \@return the previous value.
+        T fetch_add(hash_t hashv, T delta, T initial=T())
+        {
+            static_assert(std::is_integral<T>::value, "fetch_add requires an integral payload");
+            T previous = initial;
+            bool found = false;
+            bool inserted = link_node(hashv,
+                    [&]{ return new solist_node<T>(initial + delta, hashv); },
+                    [&](solist_node<T>* node){
+                        previous = __atomic_fetch_add(node->get_item_ptr(), delta, __ATOMIC_ACQ_REL);
+                        found = true;
+                    });
+            record_change(hashv, inserted, found, previous + delta);
+            return previous;
+        }
+
+        /// Set the item of hashv to desired if it equals expected, else
+        /// load it into expected.
+        /// \@return true if the item was set.
+        bool compare_exchange(hash_t hashv, T& expected, T desired, T initial=T())
+        {
+            static_assert(__atomic_always_lock_free(sizeof(T), 0), "compare_exchange requires a lock free payload");
+            bool exchanged = false;
+            bool inserted = link_node(hashv,
+                    [&]() -> solist_node<T>* {
+                        if (0 != std::memcmp(&expected, &initial, sizeof(T)))
+                        {
+                            expected = initial;
+                            return nullptr;
+                        }
+                        return new solist_node<T>(desired, hashv);
+                    },
+                    [&](solist_node<T>* node){
+                        exchanged = __atomic_compare_exchange(node->get_item_ptr(), &expected, &desired,
+                                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+                    });
+            record_change(hashv, inserted, exchanged, desired);
+            return inserted || exchanged;
+        }
+
+        /// Set the item of hashv to fn(value), fn may be called more than
+        /// once, if the item is changed concurrently.
+        /// \@return the new value.
+        template <typename F> T update(hash_t hashv, F fn, T initial=T())
+        {
+            static_assert(__atomic_always_lock_free(sizeof(T), 0), "update requires a lock free payload");
+            T value = initial;
+            bool found = false;
+            bool inserted = link_node(hashv,
+                    [&]{ return new solist_node<T>(value = fn(initial), hashv); },
+                    [&](solist_node<T>* node){
+                        T* item = node->get_item_ptr();
+                        T expected;
+                        __atomic_load(item, &expected, __ATOMIC_ACQUIRE);
+                        value = fn(expected);
+                        solist_backoff contention = backoff();
+                        while(!__atomic_compare_exchange(item, &expected, &value,
+                                    false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                        {
+                            contention.pause();
+                            value = fn(expected);
+                        }
+                        found = true;
+                    });
+            record_change(hashv, inserted, found, value);
+            return value;
+        }
+
+        /// Remove all items, in a single traversal of the list, the bucket
+        /// directory and the bucket nodes are kept.
+        /// Each data node is marked and unlinked, as by delete_node, so
+        /// readers traversing the list are safe, the unlinked nodes are
+        /// queued on the hazard pointer domain in batches, and are freed by
+        /// its collect cycles.
+        /// Items inserted concurrently may or may not be removed.
+        /// \@return the number of items removed.
+        std::size_t clear()
+        {
+            constexpr std::size_t BATCH = 256;
+            generic_hazptr_t batch[BATCH];
+            std::size_t n_batch = 0;
+            std::size_t count = 0;
+            hazp_acquire();
+            // Bucket nodes are never deleted, so the sweep can restart
+            // from the last one passed.
+            solist_bucket* restart = so_list->buckets[0];
+clear_try_again:
+            prev = cur = restart;
+            hpc->store(HP_PREV, prev);
+            hpc->store(HP_CUR, cur);
+            load_next();
+            while(nullptr != next)
+            {
+                if (!advance())
+                {
+                    goto clear_try_again;
+                }
+                if (!cur->is_node())
+                {
+                    restart = cur;
+                    continue;
+                }
+                // Mark, this logically deletes the node.
+                if (!cur->next.CAS(next, next, true, std::memory_order_release))
+                {
+                    goto clear_try_again;
+                }
+                hash_t hashv = cur->hashv();
+                so_list->dec_item_count();
+                ++count;
+                if (so_list->change_feed())
+                {
+                    so_list->change_feed()->append_delete(hashv);
+                }
+                if (!prev->next.CAS(cur, next, std::memory_order_release))
+                {
+                    // Unlinked and retired by a traversal.
+                    goto clear_try_again;
+                }
+                batch[n_batch++] = reinterpret_cast<generic_hazptr_t>(cur);
+                if (BATCH == n_batch)
+                {
+                    retire_batch(batch, n_batch);
+                    n_batch = 0;
+                }
+                // Continue from prev, next is its successor now.
+                cur = prev;
+            }
+            retire_batch(batch, n_batch);
+            zap();
+            return count;
+        }
+
         // FIXME: for proper operation we should return type hazard_pointer<T>
         // TBD.
+        // The item returned is protected by a hazard pointer until the
+        // next operation by the calling thread on any table sharing the
+        // hazard pointer domain, by default every table, through any
+        // accessor, the thread has a single context per domain.
         T* find_item_node(hash_t hashv)
         {
-            if (find_node(hashv))
+            hazp_acquire();
+            solist_hot_entry* entry = nullptr;
+            uint64_t epoch = 0;
+            if (hot_cache)
+            {
+                entry = &solist_hot_cache::local().entry(so_list->id, hashv);
+                epoch = __atomic_load_n(&so_list->retire_epoch, __ATOMIC_SEQ_CST);
+                if (entry->table_id == so_list->id && entry->hashv == hashv && entry->epoch == epoch)
+                {
+                    // The node was not retired before the hazard pointer was
+                    // set if the epoch is unchanged, a marked node is deleted.
+                    cur = entry->node;
+                    hpc->store(HP_CUR, cur);
+                    bool marked;
+                    if (epoch == __atomic_load_n(&so_list->retire_epoch, __ATOMIC_SEQ_CST))
+                    {
+                        cur->next.load(&marked, std::memory_order_acquire);
+                        if (!marked)
+                        {
+                            return static_cast<solist_node<T>*>(cur)->get_item_ptr();
+                        }
+                    }
+                }
+            }
+            if (maybe_present(hashv) && find_node(hashv))
             {
-                // can make cheaper using reinterpret_cast for now this is safer,
-                // but more expensive.
-                solist_node<T>* node = dynamic_cast<solist_node<T>*>(cur);
+                // the key of cur matched a data node key.
+                solist_node<T>* node = static_cast<solist_node<T>*>(cur);
+                if (nullptr != entry)
+                {
+                    *entry = solist_hot_entry{so_list->id, epoch, cur, hashv};
+                }
                 return node->get_item_ptr();
             }
 
+            zap();
             return nullptr;
         }
+
+        /// Bulk lookup, calls visit(i, item) for each hash value in order,
+        /// item is nullptr if hashes[i] is not found.
+        /// The item is protected by a hazard pointer only for the
+        /// duration of the call to visit, so it should be copied out.
+        /// The hazard pointer context is looked up once for the batch.
+        /// \@return the number of items found.
+        template <typename F> std::size_t find_items(const hash_t* hashes, std::size_t n, F visit)
+        {
+            std::size_t found = 0;
+            hazp_acquire();
+            for(std::size_t i = 0; i < n; ++i)
+            {
+                T* item = nullptr;
+                if (maybe_present(hashes[i]) && find_node(hashes[i]))
+                {
+                    // the key of cur matched a data node key.
+                    item = static_cast<solist_node<T>*>(cur)->get_item_ptr();
+                    ++found;
+                }
+                visit(i, item);
+            }
+            zap();
+            return found;
+        }
+
+        /// Key aware interface, keys are hashed by the key hash of the
+        /// table, so weak or adversarial keys are spread over the buckets.
+        /// Keys are 31 bit, a bijection maps them to hash values, so
+        /// key_hash(key) identifies the item for the hash value interface.
+        /// Keys above solist_key_hash::MAX_KEY are rejected, operations
+        /// on them fail and they are never found.
+        inline hash_t key_hash(uint32_t key) const
+        {
+            return so_list->key_hash(key);
+        }
+
+        inline hash_t key_hash(const void* key, std::size_t len) const
+        {
+            return so_list->key_hash(key, len);
+        }
+
+        bool insert_key(uint32_t key, T payload)
+        {
+            return key <= solist_key_hash::MAX_KEY && insert_node(key_hash(key), payload);
+        }
+
+        bool delete_key(uint32_t key)
+        {
+            return key <= solist_key_hash::MAX_KEY && delete_node(key_hash(key));
+        }
+
+        /// See insert_or_assign.
+        bool insert_or_assign_key(uint32_t key, T payload)
+        {
+            return key <= solist_key_hash::MAX_KEY && insert_or_assign(key_hash(key), payload);
+        }
+
+        /// The item returned is protected by a hazard pointer until the
+        /// next operation by the calling thread on any table sharing the
+        /// hazard pointer domain, by default every table, through any
+        /// accessor, the thread has a single context per domain.
+        T* find_key(uint32_t key)
+        {
+            return key <= solist_key_hash::MAX_KEY ? find_item_node(key_hash(key)) : nullptr;
+        }
     };
 
+    /// solist with a compile time number of buckets, a power of 2, for
+    /// tables of known capacity, the directory is inline, the slot of a
+    /// hash value is a mask and there is no expansion.
+    /// Bucket lengths grow with the number of items, Buckets should be
+    /// about the capacity divided by the desired bucket length.
+    template <typename T, uint32_t Buckets> using solist_fixed = solist<T, solist_fixed_directory<Buckets>>;
+    template <typename T, uint32_t Buckets> using solist_fixed_accessor = solist_accessor<T, solist_fixed_directory<Buckets>>;
+
     } //namespace concurrent
 } //namespace benedias
 #endif // #define BENEDIAS_SOLIST_HPP
@@ -0,0 +1,155 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_BACKOFF_HPP
+#define BENEDIAS_SOLIST_BACKOFF_HPP
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace benedias {
+    namespace concurrent {
+
+    /// Backoff of the retry loops of a solist after a failed CAS.
+    enum class solist_backoff_policy : uint8_t
+    {
+        /// Retry immediately.
+        none,
+        /// Spin a fixed short time before every retry.
+        spin,
+        /// Spin a random time, the bound doubles on every retry, past
+        /// the limit the thread yields.
+        exponential,
+        /// Retry immediately once, then as exponential, the limit is
+        /// scaled by the number of hardware threads, with a single
+        /// hardware thread the thread holding the contended line can
+        /// only make progress if the waiter yields, so it yields at once.
+        adaptive,
+    };
+
+    /// Processor hint for spin wait loops.
+    inline void solist_cpu_relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    /// Backoff state of one operation, constructed at the start of the
+    /// operation, pause() is called before each retry.
+    class solist_backoff
+    {
+        static constexpr unsigned   SPIN = 16;
+        static constexpr unsigned   LIMIT = 1024;
+        const solist_backoff_policy policy;
+        unsigned    bound = SPIN;
+        unsigned    retries = 0;
+
+        // Per thread xorshift, the jitter keeps threads which failed
+        // together from retrying together.
+        static inline uint32_t jitter()
+        {
+            thread_local uint32_t x = 0x9e3779b9u ^
+                static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            return x;
+        }
+
+        static inline unsigned adaptive_limit()
+        {
+            static const unsigned limit = std::thread::hardware_concurrency() > 1 ?
+                std::min(LIMIT, 32 * std::thread::hardware_concurrency()) : 0;
+            return limit;
+        }
+
+        static inline void spin(unsigned n)
+        {
+            for(unsigned i = 0; i < n; ++i)
+            {
+                solist_cpu_relax();
+            }
+        }
+
+        inline void exponential(unsigned limit)
+        {
+            if (bound > limit)
+            {
+                std::this_thread::yield();
+                return;
+            }
+            spin(jitter() & (bound - 1));
+            bound <<= 1;
+        }
+
+        public:
+        explicit solist_backoff(solist_backoff_policy p):policy(p)
+        {
+        }
+
+        inline void pause()
+        {
+            ++retries;
+            switch(policy)
+            {
+                case solist_backoff_policy::none:
+                    break;
+                case solist_backoff_policy::spin:
+                    spin(SPIN);
+                    break;
+                case solist_backoff_policy::exponential:
+                    exponential(LIMIT);
+                    break;
+                case solist_backoff_policy::adaptive:
+                    if (retries > 1)
+                    {
+                        exponential(adaptive_limit());
+                    }
+                    break;
+            }
+        }
+
+        /// Pause before checking again for work done by another thread,
+        /// such as a combined operation. Unlike after a failed CAS, the
+        /// waiter cannot progress by retrying, so under the none policy
+        /// it waits as under adaptive.
+        inline void wait()
+        {
+            if (solist_backoff_policy::none == policy)
+            {
+                ++retries;
+                exponential(adaptive_limit());
+                return;
+            }
+            pause();
+        }
+
+        /// Number of retries so far.
+        inline unsigned count() const
+        {
+            return retries;
+        }
+    };
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_BACKOFF_HPP
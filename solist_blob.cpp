@@ -0,0 +1,248 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "solist_blob.hpp"
+#include <mutex>
+#include <vector>
+
+namespace benedias {
+    namespace concurrent {
+
+namespace {
+
+constexpr std::size_t size_classes[] = {
+    32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+constexpr unsigned N_CLASSES = sizeof(size_classes)/sizeof(size_classes[0]);
+static_assert(solist_slab::MAX_BLOCK == size_classes[N_CLASSES - 1],
+        "MAX_BLOCK must be the largest size class");
+
+constexpr std::size_t SLAB_SIZE = 64 * 1024;
+constexpr std::size_t SLAB_ALIGN = 64;
+// Thread cache limits, per size class.
+constexpr uint32_t CACHE_MAX = 128;
+constexpr uint32_t CACHE_REFILL = 32;
+
+struct free_block
+{
+    free_block* next;
+};
+
+inline unsigned class_of(std::size_t size)
+{
+    unsigned c = 0;
+    while(size_classes[c] < size)
+    {
+        ++c;
+    }
+    return c;
+}
+
+// Blocks returned by threads, shared by all threads.
+// Never destroyed, nodes may be reclaimed after static destructors have run.
+struct central_lists
+{
+    std::mutex  lock;
+    free_block* free[N_CLASSES] = {};
+    std::vector<void*> slabs;
+
+    void push(unsigned c, free_block* head, free_block* tail)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tail->next = free[c];
+        free[c] = head;
+    }
+
+    // \@return a chain of at most n blocks, the count is returned in n.
+    free_block* pop(unsigned c, uint32_t& n)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        free_block* head = free[c];
+        free_block* tail = head;
+        uint32_t count = 0;
+        if (nullptr != head)
+        {
+            for(count = 1; count < n && nullptr != tail->next; ++count)
+            {
+                tail = tail->next;
+            }
+            free[c] = tail->next;
+            tail->next = nullptr;
+        }
+        n = count;
+        return head;
+    }
+
+    char* new_slab()
+    {
+        char* slab = static_cast<char*>(::operator new(SLAB_SIZE, std::align_val_t(SLAB_ALIGN)));
+        std::lock_guard<std::mutex> guard(lock);
+        slabs.push_back(slab);
+        return slab;
+    }
+};
+
+central_lists& central()
+{
+    static central_lists* lists = new central_lists();
+    return *lists;
+}
+
+// Trivially destructible, so usable by reclamation running in the
+// destructors of other thread local objects, after thread_cache_flush
+// has run.
+struct thread_cache
+{
+    free_block* free[N_CLASSES];
+    uint32_t    count[N_CLASSES];
+    // Unused part of the current slab of each size class.
+    char*       bump[N_CLASSES];
+    char*       bump_end[N_CLASSES];
+    bool        exited;
+};
+
+thread_local thread_cache tcache;
+
+// Return the blocks cached by a thread on thread exit.
+struct thread_cache_flush
+{
+    ~thread_cache_flush()
+    {
+        for(unsigned c = 0; c < N_CLASSES; ++c)
+        {
+            while(tcache.bump[c] + size_classes[c] <= tcache.bump_end[c])
+            {
+                free_block* b = reinterpret_cast<free_block*>(tcache.bump[c]);
+                b->next = tcache.free[c];
+                tcache.free[c] = b;
+                tcache.bump[c] += size_classes[c];
+            }
+            free_block* head = tcache.free[c];
+            if (nullptr != head)
+            {
+                free_block* tail = head;
+                while(nullptr != tail->next)
+                {
+                    tail = tail->next;
+                }
+                central().push(c, head, tail);
+            }
+            tcache.free[c] = nullptr;
+            tcache.count[c] = 0;
+        }
+        tcache.exited = true;
+    }
+};
+
+thread_local thread_cache_flush tflush;
+
+void* alloc_block(unsigned c)
+{
+    // odr-use registers the flush on thread exit.
+    (void)&tflush;
+    if (nullptr == tcache.free[c] && !tcache.exited)
+    {
+        uint32_t n = CACHE_REFILL;
+        tcache.free[c] = central().pop(c, n);
+        tcache.count[c] = n;
+    }
+    free_block* b = tcache.free[c];
+    if (nullptr != b)
+    {
+        tcache.free[c] = b->next;
+        --tcache.count[c];
+        return b;
+    }
+    if (tcache.exited)
+    {
+        uint32_t n = 1;
+        b = central().pop(c, n);
+        if (nullptr != b)
+        {
+            return b;
+        }
+        // Carve a single block, the rest of the slab is not cached.
+        return central().new_slab();
+    }
+    if (tcache.bump[c] + size_classes[c] > tcache.bump_end[c])
+    {
+        tcache.bump[c] = central().new_slab();
+        tcache.bump_end[c] = tcache.bump[c] + SLAB_SIZE;
+    }
+    void* block = tcache.bump[c];
+    tcache.bump[c] += size_classes[c];
+    return block;
+}
+
+void free_block_to(unsigned c, void* block)
+{
+    free_block* b = static_cast<free_block*>(block);
+    if (tcache.exited)
+    {
+        central().push(c, b, b);
+        return;
+    }
+    b->next = tcache.free[c];
+    tcache.free[c] = b;
+    if (++tcache.count[c] > CACHE_MAX)
+    {
+        // Return the older half of the cache to the shared list.
+        free_block* tail = b;
+        for(uint32_t i = 1; i < CACHE_MAX/2; ++i)
+        {
+            tail = tail->next;
+        }
+        free_block* head = tail->next;
+        tail->next = nullptr;
+        tail = head;
+        while(nullptr != tail->next)
+        {
+            tail = tail->next;
+        }
+        central().push(c, head, tail);
+        tcache.count[c] = CACHE_MAX/2;
+    }
+}
+
+} // namespace
+
+std::size_t solist_slab::block_size(std::size_t size)
+{
+    return size > MAX_BLOCK ? size : size_classes[class_of(size)];
+}
+
+void* solist_slab::alloc(std::size_t size)
+{
+    if (size > MAX_BLOCK)
+    {
+        return ::operator new(size);
+    }
+    return alloc_block(class_of(size));
+}
+
+void solist_slab::free(void* block, std::size_t size)
+{
+    if (size > MAX_BLOCK)
+    {
+        ::operator delete(block);
+        return;
+    }
+    free_block_to(class_of(size), block);
+}
+
+    } //namespace concurrent
+} //namespace benedias
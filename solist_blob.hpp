@@ -0,0 +1,234 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_BLOB_HPP
+#define BENEDIAS_SOLIST_BLOB_HPP
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include "solist.hpp"
+
+namespace benedias {
+    namespace concurrent {
+
+    /// Size classed slab allocator for variable length nodes.
+    /// Blocks of each size class are carved from 64 byte aligned slabs,
+    /// freed blocks are cached per thread, and returned to a shared
+    /// list per size class when the cache overflows or the thread exits.
+    /// Slabs are never released.
+    /// Blocks larger than the largest size class are allocated with new.
+    class solist_slab
+    {
+        public:
+        static constexpr std::size_t MAX_BLOCK = 4096;
+
+        /// \@return the size of the block allocated for size bytes.
+        static std::size_t block_size(std::size_t size);
+        static void* alloc(std::size_t size);
+        /// \@param size - the size passed to alloc.
+        static void free(void* block, std::size_t size);
+    };
+
+    /// Payload of variable length nodes, the key and value bytes follow
+    /// the lengths inline, so a lookup of a short key touches the node only.
+    /// Instances exist only inside solist_node<solist_blob>.
+    struct solist_blob
+    {
+        uint32_t    key_len;
+        uint32_t    value_len;
+
+        // Not copyable, the bytes are not part of the object.
+        solist_blob& operator=(const solist_blob&) = delete;
+        solist_blob(solist_blob const&) = delete;
+        solist_blob() = default;
+
+        inline const char* key() const
+        {
+            return reinterpret_cast<const char*>(this + 1);
+        }
+
+        inline const char* value() const
+        {
+            return key() + key_len;
+        }
+
+        inline char* value()
+        {
+            return reinterpret_cast<char*>(this + 1) + key_len;
+        }
+
+        inline bool key_equals(const void* k, uint32_t len) const
+        {
+            return len == key_len && 0 == memcmp(key(), k, len);
+        }
+    };
+
+    template <> struct solist_node<solist_blob>: solist_bucket
+    {
+        solist_blob     payload;
+
+        // Non copyable
+        solist_node& operator=(const solist_node&) = delete;
+        solist_node(solist_node const&) = delete;
+
+        // Non movable
+        solist_node& operator=(solist_node&&) = delete;
+        solist_node(solist_node&&) = delete;
+
+        solist_blob*    get_item_ptr() { return &payload; }
+
+        // The bytes start after payload, which is in the tail padding of
+        // solist_bucket, so this overestimates by the node alignment padding.
+        static inline std::size_t alloc_size(uint32_t key_len, uint32_t value_len)
+        {
+            return sizeof(solist_node) + key_len + value_len;
+        }
+
+        inline std::size_t alloc_size() const
+        {
+            return alloc_size(payload.key_len, payload.value_len);
+        }
+
+        /// Allocate a node from the slabs and copy the key and value in.
+        static solist_node* create(hash_t hashv, const void* key, uint32_t key_len,
+                const void* value, uint32_t value_len)
+        {
+            void* block = solist_slab::alloc(alloc_size(key_len, value_len));
+            solist_node* node = new (block) solist_node(hashv);
+            node->payload.key_len = key_len;
+            node->payload.value_len = value_len;
+            char* bytes = reinterpret_cast<char*>(&node->payload + 1);
+            memcpy(bytes, key, key_len);
+            memcpy(bytes + key_len, value, value_len);
+            return node;
+        }
+
+        static inline void destroy(solist_node* node)
+        {
+            std::size_t size = node->alloc_size();
+            node->~solist_node();
+            solist_slab::free(node, size);
+        }
+
+        private:
+        explicit solist_node(hash_t hashv)
+        {
+            key = sol_node_key(hashv);
+        }
+        ~solist_node() = default;
+    };
+
+    /// Retired blob nodes are returned to the slabs.
+    template <> struct hazptr_reclaimer<solist_node<solist_blob>>: public domain_reclaimer
+    {
+        void reclaim_object(generic_hazptr_t item_ptr)
+        {
+            solist_node<solist_blob>::destroy(reinterpret_cast<solist_node<solist_blob>*>(item_ptr));
+        }
+
+        std::size_t object_size(generic_hazptr_t item_ptr)
+        {
+            return solist_slab::block_size(
+                    reinterpret_cast<solist_node<solist_blob>*>(item_ptr)->alloc_size());
+        }
+
+        static hazptr_reclaimer& instance()
+        {
+            static hazptr_reclaimer* reclaimer = new hazptr_reclaimer();
+            return *reclaimer;
+        }
+    };
+
+    /// Accessor for tables of variable length keys and values.
+    /// Items are identified by their key bytes, items of different keys
+    /// with the same hash value coexist, adjacent in the list, and are
+    /// told apart by comparing the keys.
+    /// Use erase to delete, delete_node(hashv) deletes any one of the
+    /// items with the hash value.
+    class solist_blob_accessor: public solist_accessor<solist_blob>
+    {
+        using node_type = solist_node<solist_blob>;
+
+        // find_node_if for the key bytes.
+        inline bool find_key_node(hash_t hashv, const void* key, uint32_t key_len)
+        {
+            return find_node_if(hashv,
+                    [=](node_type* node){ return node->payload.key_equals(key, key_len); });
+        }
+
+        public:
+        using solist_accessor<solist_blob>::solist_accessor;
+
+        /// \@return false if an item with the key is present.
+        bool insert(hash_t hashv, const void* key, uint32_t key_len,
+                const void* value, uint32_t value_len)
+        {
+            return link_node(hashv,
+                    [&]{ return node_type::create(hashv, key, key_len, value, value_len); },
+                    [](node_type*){},
+                    [&](hash_t h){ return find_key_node(h, key, key_len); });
+        }
+
+        /// Calls visit(const solist_blob&) if an item with the hash
+        /// value and key is present.
+        /// The item is protected by a hazard pointer only for the
+        /// duration of the call to visit, so the value should be copied out.
+        /// \@return true if the item was found.
+        template <typename F> bool find(hash_t hashv, const void* key, uint32_t key_len, F visit)
+        {
+            bool found = false;
+            hazp_acquire();
+            if (maybe_present(hashv) && find_key_node(hashv, key, key_len))
+            {
+                visit(static_cast<const solist_blob&>(static_cast<node_type*>(cur)->payload));
+                found = true;
+            }
+            zap();
+            return found;
+        }
+
+        /// Delete the item with the hash value and key.
+        /// \@return true if the item was found and deleted.
+        bool erase(hash_t hashv, const void* key, uint32_t key_len)
+        {
+            return delete_direct(hashv,
+                    [&](hash_t h){ return find_key_node(h, key, key_len); });
+        }
+
+        /// Key aware insert, find and erase, the key bytes are hashed by
+        /// the key hash of the table.
+        bool insert(const void* key, uint32_t key_len, const void* value, uint32_t value_len)
+        {
+            return insert(key_hash(key, key_len), key, key_len, value, value_len);
+        }
+
+        template <typename F> bool find(const void* key, uint32_t key_len, F visit)
+        {
+            return find(key_hash(key, key_len), key, key_len, visit);
+        }
+
+        bool erase(const void* key, uint32_t key_len)
+        {
+            return erase(key_hash(key, key_len), key, key_len);
+        }
+    };
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_BLOB_HPP
@@ -0,0 +1,273 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_CDC_HPP
+#define BENEDIAS_SOLIST_CDC_HPP
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace benedias {
+    namespace concurrent {
+
+    enum solist_cdc_op : uint8_t
+    {
+        solist_cdc_insert = 1,
+        solist_cdc_delete = 2,
+        solist_cdc_update = 3,
+    };
+
+    /// Change record, the payload is the inserted or updated payload,
+    /// it is not set for deletes.
+    template <typename T> struct solist_cdc_record
+    {
+        // Table wide sequence number, the order of the records.
+        uint64_t        seq;
+        uint32_t        hashv;
+        solist_cdc_op   op;
+        T               payload;
+    };
+
+    /// Change data capture feed of a table, mutations append records to
+    /// per thread single producer single consumer rings, so the write
+    /// path costs a sequence number and a record copy.
+    /// The ring of a thread is dropped once the thread has exited and the
+    /// ring is drained.
+    /// Records are sequenced after the mutation has taken effect, so the
+    /// order is approximately the commit order, concurrent mutations may be
+    /// sequenced in either order, including mutations of the same key by
+    /// different threads, e.g. a delete may get a lower sequence number than
+    /// the insert it removed. Only the records of a key from one thread are
+    /// in commit order, consumers needing the exact order of a key mutated
+    /// by several threads should resynchronise that key from the table.
+    /// A mutation never waits for the consumer, if the ring of the thread
+    /// is full the record is dropped and counted, consumers should then
+    /// resynchronise from the table.
+    /// Records are copied, payloads should be small and copyable.
+    template <typename T> class solist_cdc
+    {
+        struct ring
+        {
+            const uint32_t      mask;
+            // Set when the producer thread has exited, the ring is
+            // dropped by the consumer once drained.
+            std::atomic<bool>   orphaned{false};
+            alignas(64) std::atomic<uint64_t>   head{0};
+            alignas(64) std::atomic<uint64_t>   tail{0};
+            std::unique_ptr<solist_cdc_record<T>[]> records;
+
+            explicit ring(uint32_t capacity):mask(capacity - 1),
+                records(new solist_cdc_record<T>[capacity])
+            {
+            }
+
+            // \@return the record for head, or nullptr if the ring is full.
+            inline solist_cdc_record<T>* reserve(uint64_t& h)
+            {
+                h = head.load(std::memory_order_relaxed);
+                if (h - tail.load(std::memory_order_acquire) > mask)
+                {
+                    return nullptr;
+                }
+                return &records[h & mask];
+            }
+        };
+
+        struct local_ring
+        {
+            uint64_t                feed_id;
+            std::shared_ptr<ring>   r;
+        };
+
+        // Rings of a producer thread, indexed by feed identity, which is
+        // never reused, so entries of destroyed feeds never match.
+        // On thread exit the rings are handed over to their feeds.
+        struct local_ring_list
+        {
+            std::vector<local_ring> rings;
+
+            ~local_ring_list()
+            {
+                for(auto& l : rings)
+                {
+                    l.r->orphaned.store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        static std::vector<local_ring>& local_rings()
+        {
+            thread_local local_ring_list locals;
+            return locals.rings;
+        }
+
+        static uint64_t new_id()
+        {
+            static std::atomic<uint64_t> next_id{0};
+            return ++next_id;
+        }
+
+        const uint64_t          id = new_id();
+        const uint32_t          capacity;
+        alignas(64) std::atomic<uint64_t>   next_seq{0};
+        std::atomic<uint64_t>   n_lost{0};
+        // Registration of rings and draining are serialised.
+        std::mutex              lock;
+        std::vector<std::shared_ptr<ring>>  rings;
+
+        ring* local()
+        {
+            std::vector<local_ring>& locals = local_rings();
+            for(auto& l : locals)
+            {
+                if (l.feed_id == id)
+                {
+                    return l.r.get();
+                }
+            }
+            // Entries the thread is the last owner of belong to destroyed
+            // feeds, drop them before registering a new ring.
+            for(auto it = locals.begin(); it != locals.end();)
+            {
+                it = 1 == it->r.use_count() ? locals.erase(it) : it + 1;
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            rings.emplace_back(std::make_shared<ring>(capacity));
+            locals.push_back({id, rings.back()});
+            return rings.back().get();
+        }
+
+        template <typename F> inline void append(uint32_t hashv, solist_cdc_op op, F set_payload)
+        {
+            ring* r = local();
+            uint64_t h;
+            solist_cdc_record<T>* rec = r->reserve(h);
+            if (nullptr == rec)
+            {
+                n_lost.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            rec->seq = next_seq.fetch_add(1, std::memory_order_relaxed);
+            rec->hashv = hashv;
+            rec->op = op;
+            set_payload(rec->payload);
+            r->head.store(h + 1, std::memory_order_release);
+        }
+
+        public:
+        // Non copyable
+        solist_cdc& operator=(const solist_cdc&) = delete;
+        solist_cdc(solist_cdc const&) = delete;
+
+        /// \@param ring_capacity - records per producer thread, a power of 2.
+        explicit solist_cdc(uint32_t ring_capacity=4096):
+            capacity(ring_capacity < 2 ? 2 : 1u << (32 - __builtin_clz(ring_capacity - 1)))
+        {
+        }
+
+        inline void append_insert(uint32_t hashv, const T& payload)
+        {
+            append(hashv, solist_cdc_insert, [&](T& p){ p = payload; });
+        }
+
+        inline void append_update(uint32_t hashv, const T& payload)
+        {
+            append(hashv, solist_cdc_update, [&](T& p){ p = payload; });
+        }
+
+        inline void append_delete(uint32_t hashv)
+        {
+            append(hashv, solist_cdc_delete, [](T&){});
+        }
+
+        /// Number of records dropped because a ring was full.
+        inline uint64_t lost() const
+        {
+            return n_lost.load(std::memory_order_relaxed);
+        }
+
+        /// Calls visit(const solist_cdc_record<T>&) for the records
+        /// published so far, in sequence order.
+        /// Records being appended during the drain are returned by the
+        /// next drain, and may have lower sequence numbers than records
+        /// already returned.
+        /// \@return the number of records visited.
+        template <typename F> std::size_t drain(F visit)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            std::vector<uint64_t> pos;
+            std::vector<uint64_t> end;
+            for(auto& r : rings)
+            {
+                pos.push_back(r->tail.load(std::memory_order_relaxed));
+                end.push_back(r->head.load(std::memory_order_acquire));
+            }
+            std::size_t count = 0;
+            while(true)
+            {
+                // Merge the rings, there are few, one per producer thread.
+                std::size_t next = rings.size();
+                uint64_t seq = 0;
+                for(std::size_t i = 0; i < rings.size(); ++i)
+                {
+                    if (pos[i] != end[i])
+                    {
+                        const solist_cdc_record<T>& rec = rings[i]->records[pos[i] & rings[i]->mask];
+                        if (next == rings.size() || rec.seq < seq)
+                        {
+                            next = i;
+                            seq = rec.seq;
+                        }
+                    }
+                }
+                if (next == rings.size())
+                {
+                    break;
+                }
+                ring* r = rings[next].get();
+                visit(static_cast<const solist_cdc_record<T>&>(r->records[pos[next] & r->mask]));
+                r->tail.store(++pos[next], std::memory_order_release);
+                ++count;
+            }
+            // Rings of exited threads are complete, drop those drained.
+            for(std::size_t i = rings.size(); i-- > 0;)
+            {
+                if (rings[i]->orphaned.load(std::memory_order_acquire)
+                        && rings[i]->tail.load(std::memory_order_relaxed)
+                        == rings[i]->head.load(std::memory_order_acquire))
+                {
+                    rings.erase(rings.begin() + i);
+                }
+            }
+            return count;
+        }
+
+        /// Number of producer rings, one per thread which has appended
+        /// records and has not exited, or whose records are not drained.
+        std::size_t producers()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return rings.size();
+        }
+    };
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_CDC_HPP
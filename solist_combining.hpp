@@ -0,0 +1,207 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_COMBINING_HPP
+#define BENEDIAS_SOLIST_COMBINING_HPP
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "hazard_pointer.hpp"
+
+namespace benedias {
+    namespace concurrent {
+
+    enum solist_fc_op : uint8_t
+    {
+        solist_fc_insert = 1,
+        solist_fc_delete = 2,
+        solist_fc_replace = 3,
+        solist_fc_insert_or_assign = 4,
+    };
+
+    /// Operation posted to a combining channel, lives on the stack of the
+    /// posting thread, which waits until done is set.
+    struct solist_fc_record
+    {
+        solist_fc_record*   next = nullptr;
+        // Payload of the operation, of the item type of the table.
+        const void*         payload = nullptr;
+        uint32_t            hashv;
+        solist_fc_op        op;
+        bool                result = false;
+        // Status of the poster's accessor, set by the combiner as the
+        // operation would have on the poster's accessor.
+        hazptr_status       status;
+        std::atomic<bool>   done{false};
+
+        solist_fc_record(solist_fc_op o, uint32_t h, const void* p, hazptr_status s):
+            payload(p), hashv(h), op(o), status(s)
+        {
+        }
+    };
+
+    /// Flat combining of the operations on persistently contended buckets.
+    /// CAS failures on a bucket are counted, when a bucket fails often
+    /// enough within a time window it is switched to combining, threads
+    /// post their operations to a publication list and whichever thread
+    /// holds the combiner lock applies the batch to the chain, so the
+    /// operations on the bucket no longer contend with each other.
+    /// The combiner still uses the lock free operations, traversals and
+    /// operations on other buckets proceed as before.
+    /// A bucket switches back when batches stay at a single operation.
+    /// Buckets map to a few channels, a channel combines one bucket at a
+    /// time.
+    class solist_combiner
+    {
+        public:
+        static constexpr uint32_t   CHANNELS = 8;
+        static constexpr uint32_t   NONE = 0xffffffff;
+
+        private:
+        struct alignas(64) channel
+        {
+            // Slot being combined, or NONE.
+            std::atomic<uint32_t>           hot_slot{NONE};
+            std::atomic<solist_fc_record*>  posted{nullptr};
+            std::atomic<bool>               locked{false};
+            // CAS failures in the current window, and its start.
+            std::atomic<uint32_t>           failures{0};
+            std::atomic<int64_t>            window_start{0};
+            // Consecutive batches of a single operation, combiner only,
+            // reset when the slot switches back.
+            uint32_t                        idle = 0;
+        };
+
+        const uint32_t      threshold;
+        const std::chrono::nanoseconds  window;
+        const uint32_t      idle_limit;
+        channel             channels[CHANNELS];
+        std::atomic<uint64_t>   n_combined{0};
+        std::atomic<uint64_t>   n_switches{0};
+
+        static inline int64_t now()
+        {
+            return std::chrono::steady_clock::now().time_since_epoch().count();
+        }
+
+        public:
+        // Non copyable
+        solist_combiner& operator=(const solist_combiner&) = delete;
+        solist_combiner(solist_combiner const&) = delete;
+
+        /// \@param failures - CAS failures on a bucket, within
+        ///     \@param window, which switch it to combining.
+        /// \@param idle - consecutive single operation batches which
+        ///     switch it back.
+        explicit solist_combiner(uint32_t failures=64,
+                std::chrono::nanoseconds window=std::chrono::milliseconds(1), uint32_t idle=256):
+            threshold(failures), window(window), idle_limit(idle)
+        {
+        }
+
+        /// \@return true if operations on slot are combined.
+        inline bool active(uint32_t slot) const
+        {
+            return channels[slot % CHANNELS].hot_slot.load(std::memory_order_relaxed) == slot;
+        }
+
+        /// Record failed CAS operations of an operation on slot, only
+        /// called on contention, so uncontended operations cost nothing.
+        void contended(uint32_t slot, uint32_t count)
+        {
+            channel& ch = channels[slot % CHANNELS];
+            if (ch.hot_slot.load(std::memory_order_relaxed) == slot)
+            {
+                return;
+            }
+            uint32_t n = ch.failures.fetch_add(count, std::memory_order_relaxed);
+            if (0 == n)
+            {
+                ch.window_start.store(now(), std::memory_order_relaxed);
+            }
+            else if (n + count >= threshold)
+            {
+                ch.failures.store(0, std::memory_order_relaxed);
+                if (now() - ch.window_start.load(std::memory_order_relaxed) <= window.count())
+                {
+                    ch.hot_slot.store(slot, std::memory_order_relaxed);
+                    n_switches.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /// Post an operation, the caller then waits for it to be done,
+        /// combining when it holds the lock.
+        inline void post(uint32_t slot, solist_fc_record* rec)
+        {
+            channel& ch = channels[slot % CHANNELS];
+            solist_fc_record* head = ch.posted.load(std::memory_order_relaxed);
+            do
+            {
+                rec->next = head;
+            }while(!ch.posted.compare_exchange_weak(head, rec,
+                        std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        inline bool try_lock(uint32_t slot)
+        {
+            channel& ch = channels[slot % CHANNELS];
+            return !ch.locked.load(std::memory_order_relaxed) &&
+                !ch.locked.exchange(true, std::memory_order_acquire);
+        }
+
+        inline void unlock(uint32_t slot)
+        {
+            channels[slot % CHANNELS].locked.store(false, std::memory_order_release);
+        }
+
+        /// Take the posted operations, lock holder only.
+        inline solist_fc_record* take(uint32_t slot)
+        {
+            return channels[slot % CHANNELS].posted.exchange(nullptr, std::memory_order_acquire);
+        }
+
+        /// Account for a batch of count operations, lock holder only.
+        void batch(uint32_t slot, uint32_t count)
+        {
+            channel& ch = channels[slot % CHANNELS];
+            n_combined.fetch_add(count, std::memory_order_relaxed);
+            ch.idle = count > 1 ? 0 : ch.idle + 1;
+            if (ch.idle >= idle_limit)
+            {
+                ch.idle = 0;
+                ch.hot_slot.store(NONE, std::memory_order_relaxed);
+            }
+        }
+
+        /// Number of operations applied by combiners.
+        inline uint64_t combined() const
+        {
+            return n_combined.load(std::memory_order_relaxed);
+        }
+
+        /// Number of switches of buckets to combining.
+        inline uint64_t switches() const
+        {
+            return n_switches.load(std::memory_order_relaxed);
+        }
+    };
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_COMBINING_HPP
@@ -0,0 +1,237 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_COMPACT_HPP
+#define BENEDIAS_SOLIST_COMPACT_HPP
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include "solist_index.hpp"
+
+namespace benedias {
+    namespace concurrent {
+
+    /// Split ordered list with 32 bit index links, for tables of fewer
+    /// than 2^31 nodes, in process memory.
+    /// Links are half the size of mark_ptr_type links, and the bucket
+    /// directory holds 32 bit indices, so twice as many entries fit in
+    /// a cache line.
+    /// Nodes are allocated from a chunked arena, chunk k holds nodes
+    /// [2^k, 2^(k+1)) (chunk 0 holds [0, 2)), chunks are allocated on
+    /// demand and never moved, so the arena grows lock free.
+    /// The directory is chunked in the same way as solist_directory.
+    /// Deleted nodes are recycled through a free list, the arena does
+    /// not shrink.
+    template <typename T> class solist_compact
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                "solist_compact payloads must be trivially copyable");
+
+        static constexpr uint32_t   MAX_CHUNKS = 32;
+
+        std::atomic<solist_index_node<T>*>  node_chunks[MAX_CHUNKS] = {};
+        std::atomic<std::atomic<uint32_t>*> directory_chunks[MAX_CHUNKS] = {};
+        // Node 1 is the sentinel of bucket 0, the head of the list.
+        std::atomic<uint32_t>   arena_next{2};
+        std::atomic<uint64_t>   free_head{0};
+        std::atomic<uint32_t>   n_buckets{2};
+        std::atomic<uint32_t>   n_items{0};
+        uint32_t                bucket_length;
+        std::unique_ptr<solist_index_hazard_slot[]> slots;
+        std::size_t             n_slots;
+
+        static inline uint32_t chunk_of(uint32_t index)
+        {
+            return index < 2 ? 0 : 31 - __builtin_clz(index);
+        }
+
+        static inline uint32_t chunk_base(uint32_t k)
+        {
+            return 0 == k ? 0 : 1u << k;
+        }
+
+        static inline uint32_t chunk_size(uint32_t k)
+        {
+            return 0 == k ? 2 : 1u << k;
+        }
+
+        // Allocate chunk k of an arena if required, thread safe.
+        template <typename U> static U* chunk_new(std::atomic<U*>* chunks, uint32_t k)
+        {
+            U* chunk = chunks[k].load(std::memory_order_acquire);
+            if (nullptr == chunk)
+            {
+                U* new_chunk = new U[chunk_size(k)]();
+                if (chunks[k].compare_exchange_strong(chunk, new_chunk,
+                            std::memory_order_acq_rel, std::memory_order_acquire))
+                {
+                    chunk = new_chunk;
+                }
+                else
+                {
+                    delete [] new_chunk;
+                }
+            }
+            return chunk;
+        }
+
+        public:
+        // Non copyable
+        solist_compact& operator=(const solist_compact&) = delete;
+        solist_compact(solist_compact const&) = delete;
+
+        /// \@param size - initial number of buckets, rounded up to a power of 2.
+        /// \@param max_accessors - the number of hazard pointer slots,
+        ///         which bounds the number of concurrent accessors.
+        explicit solist_compact(uint32_t size, uint32_t bucket_length=4, std::size_t max_accessors=128):
+            bucket_length(bucket_length),
+            slots(new solist_index_hazard_slot[max_accessors]()),n_slots(max_accessors)
+        {
+            chunk_new(node_chunks, 0);
+            chunk_new(directory_chunks, 0);
+            node(1).key = sol_bucket_key(0);
+            bucket(0).store(1, std::memory_order_relaxed);
+            uint32_t nb = 2;
+            while(nb < size)
+            {
+                chunk_new(directory_chunks, chunk_of(nb));
+                nb <<= 1;
+            }
+            n_buckets.store(nb, std::memory_order_release);
+        }
+
+        ~solist_compact()
+        {
+            for(uint32_t k = 0; k < MAX_CHUNKS; ++k)
+            {
+                delete [] node_chunks[k].load(std::memory_order_relaxed);
+                delete [] directory_chunks[k].load(std::memory_order_relaxed);
+            }
+        }
+
+        inline solist_index_node<T>& node(uint32_t index)
+        {
+            assert(0 != index);
+            uint32_t k = chunk_of(index);
+            return node_chunks[k].load(std::memory_order_acquire)[index - chunk_base(k)];
+        }
+
+        inline std::atomic<uint32_t>& bucket(uint32_t slot)
+        {
+            uint32_t k = chunk_of(slot);
+            return directory_chunks[k].load(std::memory_order_acquire)[slot - chunk_base(k)];
+        }
+
+        inline uint32_t bucket_count() const
+        {
+            return n_buckets.load(std::memory_order_acquire);
+        }
+
+        inline uint32_t item_count() const
+        {
+            return n_items.load(std::memory_order_acquire);
+        }
+
+        inline void inc_item_count()
+        {
+            n_items.fetch_add(1, std::memory_order_release);
+        }
+
+        inline void dec_item_count()
+        {
+            n_items.fetch_sub(1, std::memory_order_release);
+        }
+
+        inline uint32_t max_bucket_length() const
+        {
+            return bucket_length;
+        }
+
+        /// Double the number of buckets, if the number of buckets is curr_size.
+        /// The directory chunk holding the new slots is published before
+        /// the size, so slots below the size are always addressable.
+        void expand(uint32_t curr_size)
+        {
+            if (curr_size < bucket_count() || curr_size > SOL_MAX_INDEX)
+            {
+                return;
+            }
+            chunk_new(directory_chunks, chunk_of(curr_size));
+            n_buckets.compare_exchange_strong(curr_size, curr_size << 1,
+                    std::memory_order_acq_rel, std::memory_order_relaxed);
+        }
+
+        inline solist_index_hazard_slot* hazard_slots()
+        {
+            return slots.get();
+        }
+
+        inline std::size_t hazard_slot_count() const
+        {
+            return n_slots;
+        }
+
+        /// Take a node off the free list, or from the end of the arena.
+        /// \@return 0 if the table is full.
+        uint32_t alloc()
+        {
+            uint32_t index = solist_index_free_list<solist_compact>::pop(*this, free_head);
+            if (0 == index)
+            {
+                index = arena_next.fetch_add(1, std::memory_order_relaxed);
+                if (index > SOL_MAX_INDEX)
+                {
+                    arena_next.store(SOL_MAX_INDEX + 1, std::memory_order_relaxed);
+                    return 0;
+                }
+                // The chunk is published before the index is linked.
+                chunk_new(node_chunks, chunk_of(index));
+            }
+            return index;
+        }
+
+        inline void free(uint32_t index)
+        {
+            solist_index_free_list<solist_compact>::push(*this, free_head, index);
+        }
+
+        // Sentinels are allocated from the arena like data nodes.
+        inline uint32_t alloc_sentinel()
+        {
+            return alloc();
+        }
+
+        inline void free_sentinel(uint32_t index)
+        {
+            free(index);
+        }
+
+        /// Number of nodes allocated from the arena, live, free or retired.
+        inline uint32_t arena_size() const
+        {
+            return arena_next.load(std::memory_order_relaxed) - 1;
+        }
+    };
+
+    template <typename T> using solist_compact_accessor = solist_index_accessor<T, solist_compact<T>>;
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_COMPACT_HPP
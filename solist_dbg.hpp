@@ -31,14 +31,14 @@ namespace benedias {
 
         fprintf(stderr,
                 "(=== dump_solist_buckets %p\n", &sol);
-        for(uint32_t x=0; x < sol->n_buckets; ++x)
+        for(uint32_t x=0; x < sol->buckets.size(); ++x)
         {
             if (nullptr != sol->buckets[x])
             {
                 fprintf(stderr,"%d) %p 0x%08x 0x%08x %d\n", x, sol->buckets[x],
                         sol->buckets[x]->key,
-                        sol->buckets[x]->hashv,
-                        sol->buckets[x]->hashv % sol->n_buckets
+                        sol->buckets[x]->hashv(),
+                        sol->buckets[x]->hashv() % sol->buckets.size()
                         );
             }
             else
@@ -67,7 +67,7 @@ namespace benedias {
         cur = sol->buckets[0];
         while(cur)
         {
-            fprintf(stderr, "0x%08x, ", cur->hashv);
+            fprintf(stderr, "0x%08x, ", cur->hashv());
             cur = cur->next();
         }
         std::cerr << std::endl << "===)" << std::endl;
@@ -95,12 +95,12 @@ namespace benedias {
 
         solist_bucket *cur = sol->buckets[0];
         fprintf(stderr,
-                "(=== dump_solist %p n_buckets=%d", &sol, sol->n_buckets);
+                "(=== dump_solist %p n_buckets=%d", &sol, sol->buckets.size());
         while(cur)
         {
             if (cur->key & DATABIT)
             {
-                auto curnode = reinterpret_cast<solist_node<T>*>(cur);
+                auto curnode = static_cast<solist_node<T>*>(cur);
                 fprintf(stderr, "0x%08x|", cur->key);
                 std::cerr << curnode->payload << ", ";
             }
@@ -113,14 +113,14 @@ namespace benedias {
         std::cerr << std::endl;
 #if 0
         std::cerr << "buckets" << std::endl;
-        for(uint32_t x=0; x < sol->n_buckets; ++x)
+        for(uint32_t x=0; x < sol->buckets.size(); ++x)
         {
             fprintf(stderr,"%d) ", x);
             if (nullptr != sol->buckets[x])
             {
                 fprintf(stderr,"0x%08x 0x%08x\n",
                         sol->buckets[x]->key,
-                        sol->buckets[x]->hashv
+                        sol->buckets[x]->hashv()
                        );
             }
             else
@@ -138,12 +138,12 @@ namespace benedias {
 
         solist_bucket *cur = sol->buckets[0];
         fprintf(stderr,
-                "(=== dump_solist_items %p n_buckets=%d\n", &sol, sol->n_buckets);
+                "(=== dump_solist_items %p n_buckets=%d\n", &sol, sol->buckets.size());
         while(cur)
         {
             if (cur->key & DATABIT)
             {
-                auto curnode = reinterpret_cast<solist_node<T>*>(cur);
+                auto curnode = static_cast<solist_node<T>*>(cur);
                 std::cerr << curnode->payload << ", ";
             }
             cur = cur->next();
@@ -162,15 +162,21 @@ namespace benedias {
                 "checking for monotonically increasing keys ");
         solist_bucket *cur = sol->buckets[0];
         hash_t  key = cur->key;
-        cur = cur->next();
+        bool    mark;
+        uintptr_t   tag;
+        cur = cur->next(&mark, &tag);
         while(cur)
         {
             if (!(cur->key > key))
             {
                 fprintf(stderr, "\nFail:: %p 0x%08x %p; prev=0x%08x", cur, cur->key, cur->next(), key);
             }
+            if (sol_key_fingerprints && tag != sol_key_fingerprint(cur->key))
+            {
+                fprintf(stderr, "\nFail:: %p 0x%08x fingerprint=0x%04lx", cur, cur->key, tag);
+            }
             key = cur->key;
-            cur = cur->next();
+            cur = cur->next(&mark, &tag);
         }
         std::cerr << "===)" << std::endl;
     }
@@ -0,0 +1,125 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_HASH_HPP
+#define BENEDIAS_SOLIST_HASH_HPP
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace benedias {
+    namespace concurrent {
+
+    /// MurmurHash3 32 bit finaliser, a bijection.
+    inline uint32_t fmix32(uint32_t h)
+    {
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    /// MurmurHash3 64 bit finaliser, a bijection.
+    inline uint64_t fmix64(uint64_t k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ull;
+        k ^= k >> 33;
+        return k;
+    }
+
+    /// wyhash mix, the 128 bit product of a and b folded to 64 bits.
+    inline uint64_t wymix(uint64_t a, uint64_t b)
+    {
+        __uint128_t r = static_cast<__uint128_t>(a) * b;
+        return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+    }
+
+    /// Random seed for solist_key_hash, from std::random_device.
+    uint64_t solist_random_seed();
+
+    /// Seeded hash of solist keys.
+    /// The top bit of a hash value is not significant to a solist, so
+    /// 31 bit integer keys are mapped by a seeded bijection of 31 bit
+    /// values, distinct keys never have the same hash value.
+    /// Byte string keys are hashed with a wyhash style function, keys
+    /// with the same hash value cannot coexist in a table, the seed makes
+    /// such collisions unpredictable.
+    /// With a secret random seed an adversary cannot choose keys which
+    /// fill a few buckets, the mixers are fast, not cryptographic.
+    class solist_key_hash
+    {
+        static constexpr uint32_t   MASK31 = 0x7fffffff;
+        uint64_t    seed;
+        uint32_t    seed_lo;
+        uint32_t    seed_hi;
+
+        public:
+        /// Largest integer key, keys are 31 bit.
+        static constexpr uint32_t   MAX_KEY = MASK31;
+
+        explicit solist_key_hash(uint64_t s=0):
+            seed(fmix64(s ^ 0x9e3779b97f4a7c15ull)),
+            seed_lo(static_cast<uint32_t>(seed) & MASK31),
+            seed_hi(static_cast<uint32_t>(seed >> 32) & MASK31)
+        {
+        }
+
+        /// \@param key - 31 bit key, at most MAX_KEY, larger keys would
+        ///     alias the key without the top bit.
+        inline uint32_t operator()(uint32_t key) const
+        {
+            assert(key <= MAX_KEY);
+            // Each step is a bijection modulo 2^31.
+            uint32_t x = (key ^ seed_lo) & MASK31;
+            x = (x * 0x2c1b3c6du) & MASK31;
+            x ^= x >> 12;
+            x = (x * 0x297a2d39u + seed_hi) & MASK31;
+            x ^= x >> 15;
+            x = (x * 0x5bd1e995u) & MASK31;
+            x ^= x >> 13;
+            return x;
+        }
+
+        inline uint32_t operator()(const void* bytes, std::size_t len) const
+        {
+            const unsigned char* p = static_cast<const unsigned char*>(bytes);
+            uint64_t h = seed ^ len;
+            uint64_t w;
+            while(len >= 8)
+            {
+                std::memcpy(&w, p, 8);
+                h = wymix(w ^ 0xa0761d6478bd642full, h ^ 0xe7037ed1a0b428dbull);
+                p += 8;
+                len -= 8;
+            }
+            w = 0;
+            std::memcpy(&w, p, len);
+            h = wymix(w ^ 0x8ebc6af09c88c6e3ull, h ^ 0x589965cc75374cc3ull);
+            return static_cast<uint32_t>(h ^ (h >> 32));
+        }
+    };
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_HASH_HPP
@@ -0,0 +1,547 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_INDEX_HPP
+#define BENEDIAS_SOLIST_INDEX_HPP
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <signal.h>
+#include <unistd.h>
+#include "solist.hpp"
+
+/// Split ordered lists with 32 bit node index links, instead of pointers.
+/// Nodes live in arenas of the table, addressed by index,
+/// the bucket directory holds indices, and deleted nodes are
+/// recycled through free lists after a hazard pointer scan.
+/// Payloads are trivially copyable and copied in and out.
+
+namespace benedias {
+    namespace concurrent {
+
+    /// Link to a node with a mark bit, the link is a 31 bit node index,
+    /// half the size of a mark_ptr_type on 64 bit targets.
+    /// Index links are valid in every process mapping a shared memory
+    /// region, unlike pointers. Index 0 is the null link.
+    class mark_index_type
+    {
+        std::atomic<uint32_t>   v{0};
+
+        public:
+        inline uint32_t load(std::memory_order order=std::memory_order_acquire) const
+        {
+            return v.load(order) >> 1;
+        }
+
+        inline uint32_t load(bool *mark, std::memory_order order=std::memory_order_acquire) const
+        {
+            uint32_t lv = v.load(order);
+            *mark = 0 != (lv & 1);
+            return lv >> 1;
+        }
+
+        /// Store a link, clearing the mark, for nodes not yet published.
+        inline void store(uint32_t index, std::memory_order order=std::memory_order_release)
+        {
+            v.store(index << 1, order);
+        }
+
+        inline bool CAS(uint32_t expected, uint32_t desired, std::memory_order order=std::memory_order_acq_rel)
+        {
+            uint32_t ev = expected << 1;
+            return v.compare_exchange_strong(ev, desired << 1, order, std::memory_order_relaxed);
+        }
+
+        inline bool CAS(uint32_t expected, bool marked, uint32_t desired, bool mark,
+                std::memory_order order=std::memory_order_acq_rel)
+        {
+            uint32_t ev = (expected << 1) | (marked ? 1 : 0);
+            return v.compare_exchange_strong(ev, (desired << 1) | (mark ? 1 : 0),
+                    order, std::memory_order_relaxed);
+        }
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+            "index linked atomics must be lock free, to be address free.");
+
+    // Indices are 31 bit, the lsb of a link is the mark.
+    constexpr uint32_t  SOL_MAX_INDEX = 0x7fffffff;
+
+    template <typename T> struct solist_index_node
+    {
+        so_key              key;
+        hash_t              hashv;
+        mark_index_type     next;
+        T                   payload;
+    };
+
+    /// Hazard pointers of an accessor, the slots of a table are scanned
+    /// by all accessors, in all processes for shared memory tables.
+    /// The orphans of all slots hold retired nodes left by destroyed
+    /// accessors because they were still hazardous, any scan frees them,
+    /// they fit in the padding of the slot.
+    struct alignas(64) solist_index_hazard_slot
+    {
+        static constexpr std::size_t HP_COUNT = 3;
+        static constexpr std::size_t ORPHANS = 8;
+        // While reclaiming the slot of a dead process.
+        static constexpr uint32_t   RECLAIMING = 0xffffffff;
+        // 0 if free, else the owning process id, or RECLAIMING.
+        std::atomic<uint32_t>   in_use;
+        // owning process, for diagnostics.
+        std::atomic<uint32_t>   pid;
+        std::atomic<uint32_t>   hp[HP_COUNT];
+        std::atomic<uint32_t>   orphans[ORPHANS];
+    };
+
+    static_assert(sizeof(solist_index_hazard_slot) == 64, "hazard slots are a cache line");
+
+    /// Free list of nodes, linked through the next links of the nodes,
+    /// the head holds a generation in the upper 32 bits and an index in
+    /// the lower 32 bits, the generation makes pops ABA safe.
+    template <typename Table> struct solist_index_free_list
+    {
+        static uint32_t pop(Table& table, std::atomic<uint64_t>& list)
+        {
+            uint64_t head = list.load(std::memory_order_acquire);
+            uint64_t next_head;
+            do
+            {
+                uint32_t index = static_cast<uint32_t>(head);
+                if (0 == index)
+                {
+                    return 0;
+                }
+                // The node may be popped and relinked concurrently,
+                // the generation check fails the CAS in that case.
+                next_head = ((head >> 32) + 1) << 32 | table.node(index).next.load(std::memory_order_relaxed);
+            }while(!list.compare_exchange_weak(head, next_head,
+                        std::memory_order_acq_rel, std::memory_order_acquire));
+            return static_cast<uint32_t>(head);
+        }
+
+        /// Push a node, which must not be hazardous.
+        static void push(Table& table, std::atomic<uint64_t>& list, uint32_t index)
+        {
+            uint64_t head = list.load(std::memory_order_relaxed);
+            uint64_t next_head;
+            do
+            {
+                table.node(index).next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+                next_head = ((head >> 32) + 1) << 32 | index;
+            }while(!list.compare_exchange_weak(head, next_head,
+                        std::memory_order_release, std::memory_order_relaxed));
+        }
+    };
+
+    /// Accessor of an index linked solist, for use by a single thread
+    /// at a time, like solist_accessor.
+    /// Claims a hazard pointer slot of the table for its lifetime.
+    /// Table provides the node storage, the bucket directory,
+    /// the hazard pointer slots and the free lists,
+    /// see solist_shm and solist_compact.
+    template <typename T, typename Table> class solist_index_accessor
+    {
+        std::shared_ptr<Table>  table;
+        solist_index_hazard_slot*   slot = nullptr;
+        // Nodes unlinked by this accessor, not yet returned to the free list.
+        std::vector<uint32_t>   retired;
+        std::vector<uint32_t>   hazards;
+
+        static constexpr std::size_t HP_NEXT = 0;
+        static constexpr std::size_t HP_CUR = 1;
+        static constexpr std::size_t HP_PREV = 2;
+        static constexpr std::size_t RETIRE_THRESHOLD = 2 * solist_index_hazard_slot::HP_COUNT * 16;
+
+        uint32_t    next = 0;
+        uint32_t    cur = 0;
+        uint32_t    prev = 0;
+
+        inline solist_index_node<T>& node(uint32_t index)
+        {
+            return table->node(index);
+        }
+
+        inline void hp_store(std::size_t i, uint32_t index)
+        {
+            slot->hp[i].store(index, std::memory_order_seq_cst);
+        }
+
+        // See solist_accessor::load_next
+        inline bool load_next()
+        {
+            bool marked;
+            bool vmarked;
+            uint32_t n;
+            do
+            {
+                n = node(cur).next.load(&marked, std::memory_order_acquire);
+                hp_store(HP_NEXT, n);
+            }while(n != node(cur).next.load(&vmarked, std::memory_order_seq_cst) || marked != vmarked);
+            next = n;
+            return !marked;
+        }
+
+        // See solist_accessor::advance
+        inline bool advance()
+        {
+            prev = cur;
+            hp_store(HP_PREV, prev);
+            cur = next;
+            hp_store(HP_CUR, cur);
+            if (0 != cur && !load_next())
+            {
+                if (node(prev).next.CAS(cur, next, std::memory_order_release))
+                {
+                    retire(cur);
+                }
+                return false;
+            }
+            return true;
+        }
+
+        inline void zap()
+        {
+            prev = cur = next = 0;
+            for(auto& hp : slot->hp)
+            {
+                hp.store(0, std::memory_order_release);
+            }
+        }
+
+        // Return retired nodes which are not hazardous to the free list,
+        // the orphans of the table are taken over first, so they are
+        // retired before the hazard pointers are read.
+        void scan()
+        {
+            hazards.clear();
+            solist_index_hazard_slot* slots = table->hazard_slots();
+            for(std::size_t i = 0; i < table->hazard_slot_count(); ++i)
+            {
+                for(auto& orphan : slots[i].orphans)
+                {
+                    if (0 != orphan.load(std::memory_order_relaxed))
+                    {
+                        uint32_t index = orphan.exchange(0, std::memory_order_acquire);
+                        if (0 != index)
+                        {
+                            retired.push_back(index);
+                        }
+                    }
+                }
+            }
+            for(std::size_t i = 0; i < table->hazard_slot_count(); ++i)
+            {
+                if (0 != slots[i].in_use.load(std::memory_order_acquire))
+                {
+                    for(auto& hp : slots[i].hp)
+                    {
+                        uint32_t v = hp.load(std::memory_order_seq_cst);
+                        if (0 != v)
+                        {
+                            hazards.push_back(v);
+                        }
+                    }
+                }
+            }
+            std::sort(hazards.begin(), hazards.end());
+            auto keep = std::partition(retired.begin(), retired.end(), [this](uint32_t index){
+                    return std::binary_search(hazards.begin(), hazards.end(), index);
+                });
+            for(auto it = keep; it != retired.end(); ++it)
+            {
+                table->free(*it);
+            }
+            retired.erase(keep, retired.end());
+        }
+
+        inline void retire(uint32_t index)
+        {
+            retired.push_back(index);
+            if (retired.size() >= RETIRE_THRESHOLD)
+            {
+                scan();
+            }
+        }
+
+        // Lazily insert the sentinel for slot, after initialising
+        // the parent bucket (slot with the top bit cleared).
+        void initialise_bucket(uint32_t slot)
+        {
+            if (0 != table->bucket(slot).load(std::memory_order_acquire))
+            {
+                return;
+            }
+            uint32_t parent = slot & ~(1u << (31 - __builtin_clz(slot)));
+            initialise_bucket(parent);
+
+            so_key key = sol_bucket_key(slot);
+            uint32_t index = 0;
+            uint32_t bucket = 0;
+            while(0 == table->bucket(slot).load(std::memory_order_acquire))
+            {
+initialise_bucket_try_again:
+                prev = cur = table->bucket(parent).load(std::memory_order_acquire);
+                hp_store(HP_PREV, prev);
+                hp_store(HP_CUR, cur);
+                load_next();
+                while(0 != next && node(next).key < key)
+                {
+                    if (!advance())
+                    {
+                        goto initialise_bucket_try_again;
+                    }
+                }
+                if (0 != next && node(next).key == key)
+                {
+                    bucket = next;
+                    break;
+                }
+                if (0 == index)
+                {
+                    // Sentinels are never deleted.
+                    index = table->alloc_sentinel();
+                    assert(0 != index);
+                    node(index).key = key;
+                    node(index).hashv = slot;
+                }
+                node(index).next.store(next, std::memory_order_relaxed);
+                if (node(cur).next.CAS(next, index, std::memory_order_release))
+                {
+                    bucket = index;
+                    index = 0;
+                    break;
+                }
+            }
+            if (0 != bucket)
+            {
+                uint32_t expected = 0;
+                table->bucket(slot).compare_exchange_strong(expected, bucket,
+                        std::memory_order_acq_rel, std::memory_order_acquire);
+            }
+            if (0 != index)
+            {
+                // never published.
+                table->free_sentinel(index);
+            }
+        }
+
+        bool find_node(hash_t hashv)
+        {
+            uint32_t slot = hashv % table->bucket_count();
+            so_key key = sol_node_key(hashv);
+            initialise_bucket(slot);
+
+find_node_try_again:
+            prev = cur = table->bucket(slot).load(std::memory_order_acquire);
+            hp_store(HP_PREV, prev);
+            hp_store(HP_CUR, cur);
+            load_next();
+            while(0 != next && node(next).key <= key)
+            {
+                if (!advance())
+                {
+                    goto find_node_try_again;
+                }
+            }
+            return node(cur).key == key;
+        }
+
+        public:
+        // Non copyable
+        solist_index_accessor& operator=(const solist_index_accessor&) = delete;
+        solist_index_accessor(solist_index_accessor const&) = delete;
+
+        explicit solist_index_accessor(std::shared_ptr<Table> sl):table(sl)
+        {
+            // Wait for a free slot, the number of concurrent accessors
+            // is bounded by the number of slots of the table.
+            solist_index_hazard_slot* slots = table->hazard_slots();
+            uint32_t pid = getpid();
+            while(nullptr == slot)
+            {
+                for(std::size_t i = 0; i < table->hazard_slot_count(); ++i)
+                {
+                    uint32_t expected = 0;
+                    if (slots[i].in_use.compare_exchange_strong(expected, pid, std::memory_order_acq_rel))
+                    {
+                        slots[i].pid.store(pid, std::memory_order_relaxed);
+                        slot = &slots[i];
+                        break;
+                    }
+                }
+                if (nullptr == slot && 0 == reclaim_dead_slots())
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        /// Retired nodes which are still hazardous are left as orphans of
+        /// the table, for the next scan of any accessor, so destruction
+        /// does not wait for other accessors, or processes.
+        ~solist_index_accessor()
+        {
+            zap();
+            scan();
+            solist_index_hazard_slot* slots = table->hazard_slots();
+            std::size_t n = table->hazard_slot_count();
+            std::size_t i = slot - slots;
+            for(uint32_t index : retired)
+            {
+                // There are twice as many orphans as hazard pointers, and
+                // the scan has taken over the orphans no longer
+                // hazardous, so one is free unless the table has more
+                // accessors than slots, then the node is leaked.
+                for(std::size_t k = 0; k < n * solist_index_hazard_slot::ORPHANS; ++k)
+                {
+                    std::atomic<uint32_t>& orphan = slots[(i + k / solist_index_hazard_slot::ORPHANS) % n]
+                        .orphans[k % solist_index_hazard_slot::ORPHANS];
+                    uint32_t expected = 0;
+                    if (orphan.compare_exchange_strong(expected, index, std::memory_order_release))
+                    {
+                        i = (i + k / solist_index_hazard_slot::ORPHANS) % n;
+                        break;
+                    }
+                }
+            }
+            retired.clear();
+            slot->in_use.store(0, std::memory_order_release);
+        }
+
+        /// Release the slots of processes which died while holding them,
+        /// the hazard pointers of such a slot would pin their nodes for
+        /// ever, retired nodes held by the dead accessor are lost.
+        /// Slots of this process are never released.
+        /// Called when no slot is free, by the constructor.
+        /// \@return the number of slots released.
+        std::size_t reclaim_dead_slots()
+        {
+            solist_index_hazard_slot* slots = table->hazard_slots();
+            uint32_t self = getpid();
+            std::size_t count = 0;
+            for(std::size_t i = 0; i < table->hazard_slot_count(); ++i)
+            {
+                uint32_t owner = slots[i].in_use.load(std::memory_order_acquire);
+                if (0 == owner || self == owner || solist_index_hazard_slot::RECLAIMING == owner
+                        || 0 == kill(pid_t(owner), 0) || ESRCH != errno)
+                {
+                    continue;
+                }
+                // Only one reclaimer wins, and only while the dead owner
+                // still holds the slot.
+                if (slots[i].in_use.compare_exchange_strong(owner, solist_index_hazard_slot::RECLAIMING,
+                            std::memory_order_acq_rel))
+                {
+                    for(auto& hp : slots[i].hp)
+                    {
+                        hp.store(0, std::memory_order_release);
+                    }
+                    slots[i].in_use.store(0, std::memory_order_release);
+                    ++count;
+                }
+            }
+            return count;
+        }
+
+        /// \@return false if the hash exists or the table is full.
+        bool insert_node(hash_t hashv, const T& payload)
+        {
+            bool result = false;
+            uint32_t nbuckets = table->bucket_count();
+            uint32_t index = table->alloc();
+            if (0 == index)
+            {
+                return false;
+            }
+            node(index).key = sol_node_key(hashv);
+            node(index).hashv = hashv;
+            node(index).payload = payload;
+
+            while(!find_node(hashv))
+            {
+                node(index).next.store(next, std::memory_order_relaxed);
+                if (node(cur).next.CAS(next, index, std::memory_order_release))
+                {
+                    table->inc_item_count();
+                    result = true;
+                    break;
+                }
+            }
+            zap();
+
+            if (!result)
+            {
+                // never published.
+                table->free(index);
+            }
+            else if (table->item_count() > nbuckets * table->max_bucket_length())
+            {
+                table->expand(nbuckets);
+            }
+            return result;
+        }
+
+        bool delete_node(hash_t hashv)
+        {
+            bool result = false;
+            while(find_node(hashv))
+            {
+                // Mark, this logically deletes the node.
+                if (!node(cur).next.CAS(next, false, next, true, std::memory_order_release))
+                {
+                    continue;
+                }
+                table->dec_item_count();
+                result = true;
+                if (node(prev).next.CAS(cur, next, std::memory_order_release))
+                {
+                    retire(cur);
+                }
+                else
+                {
+                    find_node(hashv);
+                }
+                break;
+            }
+            zap();
+            return result;
+        }
+
+        /// Copy the payload of hashv to *payload.
+        /// \@return false if not found.
+        bool find_item(hash_t hashv, T* payload)
+        {
+            bool result = find_node(hashv);
+            if (result)
+            {
+                *payload = node(cur).payload;
+            }
+            zap();
+            return result;
+        }
+    };
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_INDEX_HPP
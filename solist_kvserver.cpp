@@ -0,0 +1,595 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "solist_kvserver.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace benedias {
+    namespace concurrent {
+
+namespace {
+
+// Maximum number of bytes read from a connection per event,
+// so that a client pipelining heavily cannot starve the others.
+constexpr std::size_t   read_chunk = 64 * 1024;
+constexpr std::size_t   read_limit = 4 * read_chunk;
+
+struct connection
+{
+    int     fd;
+    std::vector<char>   rbuf;
+    std::size_t         rlen = 0;
+    std::vector<char>   wbuf;
+    std::size_t         wpos = 0;
+    bool    closing = false;
+
+    explicit connection(int fd):fd(fd)
+    {
+    }
+};
+
+// A pipelined get or mget request, covering count keys of a batch.
+struct batch_entry
+{
+    uint8_t     op;
+    std::size_t first;
+    std::size_t count;
+};
+
+inline void append(std::vector<char>& out, const void* p, std::size_t n)
+{
+    const char* cp = static_cast<const char*>(p);
+    out.insert(out.end(), cp, cp + n);
+}
+
+inline void put_header(std::vector<char>& out, uint8_t op, uint8_t status, uint16_t count, uint32_t length)
+{
+    kv::header h{op, status, count, length};
+    append(out, &h, sizeof(h));
+}
+
+// Patch a header already in the buffer, headers are not aligned.
+inline void set_status(std::vector<char>& out, std::size_t pos, uint8_t status)
+{
+    memcpy(&out[pos + offsetof(kv::header, status)], &status, sizeof(status));
+}
+
+inline void set_length(std::vector<char>& out, std::size_t pos, uint32_t length)
+{
+    memcpy(&out[pos + offsetof(kv::header, length)], &length, sizeof(length));
+}
+
+// Processes the complete requests buffered on a connection,
+// appending the responses to the write buffer.
+class request_processor
+{
+    solist_accessor<std::string>    acc;
+    // Hash values of the keys of the batched get and mget requests.
+    std::vector<hash_t>     keys;
+    std::vector<batch_entry>    batch;
+
+    // Respond to the batched get and mget requests with a single
+    // bulk lookup.
+    void flush(std::vector<char>& out)
+    {
+        if (keys.empty())
+        {
+            return;
+        }
+        std::size_t ix = 0;
+        std::size_t hpos = 0;
+        acc.find_items(keys.data(), keys.size(), [&](std::size_t i, std::string* v){
+            const batch_entry& e = batch[ix];
+            if (i == e.first)
+            {
+                hpos = out.size();
+                put_header(out, e.op, kv::st_ok, e.count, 0);
+            }
+            if (kv::op_get == e.op)
+            {
+                if (nullptr == v)
+                {
+                    set_status(out, hpos, kv::st_not_found);
+                }
+                else
+                {
+                    append(out, v->data(), v->size());
+                }
+            }
+            else
+            {
+                uint32_t len = nullptr == v ? kv::absent : v->size();
+                append(out, &len, sizeof(len));
+                if (nullptr != v)
+                {
+                    append(out, v->data(), v->size());
+                }
+            }
+            if (i == e.first + e.count - 1)
+            {
+                set_length(out, hpos, out.size() - hpos - sizeof(kv::header));
+                ++ix;
+            }
+        });
+        keys.clear();
+        batch.clear();
+    }
+
+    uint8_t set(kv::key k, const char* value, std::size_t length)
+    {
+        // An existing key is replaced in place, readers never see it
+        // absent, false is returned for a replacement as for a refusal,
+        // so the status tells them apart, busy after a replacement only
+        // asks the client to back off, a repeated set is harmless.
+        if (!acc.insert_or_assign_key(k, std::string(value, length))
+                && hazptr_status::over_limit == acc.status())
+        {
+            return kv::st_busy;
+        }
+        return kv::st_ok;
+    }
+
+    uint8_t del(kv::key k)
+    {
+        if (acc.delete_key(k))
+        {
+            return kv::st_ok;
+        }
+        return hazptr_status::over_limit == acc.status() ? kv::st_busy : kv::st_not_found;
+    }
+
+    public:
+    explicit request_processor(std::shared_ptr<solist<std::string>> table):acc(table)
+    {
+    }
+
+    // \@return false on a protocol error, the connection should be closed.
+    bool process(connection& c)
+    {
+        std::size_t pos = 0;
+        bool ok = true;
+        while(c.rlen - pos >= sizeof(kv::header))
+        {
+            kv::header h;
+            memcpy(&h, &c.rbuf[pos], sizeof(h));
+            if (h.length > kv::max_body)
+            {
+                ok = false;
+                break;
+            }
+            if (c.rlen - pos - sizeof(h) < h.length)
+            {
+                break;
+            }
+            const char* body = &c.rbuf[pos + sizeof(h)];
+            pos += sizeof(h) + h.length;
+
+            kv::key k = 0;
+            if (h.length >= sizeof(k))
+            {
+                memcpy(&k, body, sizeof(k));
+            }
+
+            switch(h.op)
+            {
+                case kv::op_get:
+                case kv::op_mget:
+                {
+                    std::size_t count = kv::op_get == h.op ? 1 : h.count;
+                    bool valid = h.length == count * sizeof(kv::key);
+                    for(std::size_t i = 0; valid && i < count; ++i)
+                    {
+                        memcpy(&k, body + i * sizeof(k), sizeof(k));
+                        valid = k <= kv::max_key;
+                    }
+                    if (!valid || 0 == count)
+                    {
+                        flush(c.wbuf);
+                        put_header(c.wbuf, h.op, valid ? kv::st_ok : kv::st_error, 0, 0);
+                        break;
+                    }
+                    batch.push_back({h.op, keys.size(), count});
+                    for(std::size_t i = 0; i < count; ++i)
+                    {
+                        memcpy(&k, body + i * sizeof(k), sizeof(k));
+                        keys.push_back(acc.key_hash(k));
+                    }
+                }
+                break;
+                case kv::op_set:
+                    flush(c.wbuf);
+                    if (h.length < sizeof(k) || k > kv::max_key)
+                    {
+                        put_header(c.wbuf, h.op, kv::st_error, 0, 0);
+                    }
+                    else
+                    {
+                        put_header(c.wbuf, h.op, set(k, body + sizeof(k), h.length - sizeof(k)), 0, 0);
+                    }
+                break;
+                case kv::op_del:
+                    flush(c.wbuf);
+                    if (h.length != sizeof(k) || k > kv::max_key)
+                    {
+                        put_header(c.wbuf, h.op, kv::st_error, 0, 0);
+                    }
+                    else
+                    {
+                        put_header(c.wbuf, h.op, del(k), 0, 0);
+                    }
+                break;
+                default:
+                    flush(c.wbuf);
+                    put_header(c.wbuf, h.op, kv::st_error, 0, 0);
+                break;
+            }
+        }
+        flush(c.wbuf);
+
+        // Keep the incomplete request, if any.
+        memmove(c.rbuf.data(), c.rbuf.data() + pos, c.rlen - pos);
+        c.rlen -= pos;
+        return ok;
+    }
+};
+
+// Write as much of the write buffer as the socket accepts.
+// \@return false on error.
+bool write_pending(connection& c)
+{
+    while(c.wpos < c.wbuf.size())
+    {
+        ssize_t n = send(c.fd, c.wbuf.data() + c.wpos, c.wbuf.size() - c.wpos, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return EAGAIN == errno || EWOULDBLOCK == errno;
+        }
+        c.wpos += n;
+    }
+    c.wbuf.clear();
+    c.wpos = 0;
+    return true;
+}
+
+// Read available input, at most read_limit bytes.
+// \@return false if the peer closed the connection or on error.
+bool read_available(connection& c)
+{
+    std::size_t total = 0;
+    while(total < read_limit)
+    {
+        if (c.rbuf.size() - c.rlen < read_chunk)
+        {
+            c.rbuf.resize(c.rlen + read_chunk);
+        }
+        ssize_t n = recv(c.fd, c.rbuf.data() + c.rlen, c.rbuf.size() - c.rlen, 0);
+        if (n < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return EAGAIN == errno || EWOULDBLOCK == errno;
+        }
+        if (0 == n)
+        {
+            return false;
+        }
+        c.rlen += n;
+        total += n;
+    }
+    return true;
+}
+
+void report(const char* what)
+{
+    std::cerr << "solist_kvserver: " << what << ": " << strerror(errno) << std::endl;
+}
+
+} // namespace
+
+solist_kvserver::solist_kvserver(const config& config):cfg(config)
+{
+    // Keys are chosen by clients, a seeded key hash stops them from
+    // filling a few buckets.
+    table = std::make_shared<solist<std::string>>(cfg.buckets, 4, solist_seeded_hash);
+}
+
+solist_kvserver::~solist_kvserver()
+{
+    stop();
+}
+
+bool solist_kvserver::start()
+{
+    if (running.load())
+    {
+        return true;
+    }
+
+    if (!cfg.unix_path.empty())
+    {
+        sockaddr_un addr = {};
+        if (cfg.unix_path.size() >= sizeof(addr.sun_path))
+        {
+            std::cerr << "solist_kvserver: socket path too long" << std::endl;
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, cfg.unix_path.c_str());
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0)
+        {
+            report("socket");
+            return false;
+        }
+        unlink(cfg.unix_path.c_str());
+        if (0 != bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)))
+        {
+            report("bind");
+            close(listen_fd);
+            listen_fd = -1;
+            return false;
+        }
+    }
+    else
+    {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(cfg.tcp_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0)
+        {
+            report("socket");
+            return false;
+        }
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        socklen_t len = sizeof(addr);
+        if (0 != bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))
+                || 0 != getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len))
+        {
+            report("bind");
+            close(listen_fd);
+            listen_fd = -1;
+            return false;
+        }
+        cfg.tcp_port = ntohs(addr.sin_port);
+    }
+
+    if (0 != listen(listen_fd, SOMAXCONN))
+    {
+        report("listen");
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    unsigned n_workers = cfg.threads;
+    if (0 == n_workers)
+    {
+        n_workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    running.store(true);
+    for(unsigned i = 0; i < n_workers; ++i)
+    {
+        int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (efd < 0)
+        {
+            report("eventfd");
+            stop();
+            return false;
+        }
+        stop_fds.push_back(efd);
+        workers.emplace_back(&solist_kvserver::worker, this, i);
+    }
+    return true;
+}
+
+void solist_kvserver::stop()
+{
+    if (!running.exchange(false))
+    {
+        return;
+    }
+    for(auto efd : stop_fds)
+    {
+        uint64_t one = 1;
+        ssize_t n = write(efd, &one, sizeof(one));
+        (void)n;
+    }
+    for(auto& th : workers)
+    {
+        th.join();
+    }
+    workers.clear();
+    for(auto efd : stop_fds)
+    {
+        close(efd);
+    }
+    stop_fds.clear();
+    close(listen_fd);
+    listen_fd = -1;
+    if (!cfg.unix_path.empty())
+    {
+        unlink(cfg.unix_path.c_str());
+    }
+}
+
+void solist_kvserver::worker(unsigned index)
+{
+    // One event loop per core, best effort.
+    unsigned n_cpus = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index % n_cpus, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0)
+    {
+        report("epoll_create1");
+        return;
+    }
+
+    // Tags for the listening socket and the stop eventfd,
+    // other events carry a connection pointer.
+    static char listen_tag;
+    static char stop_tag;
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = &listen_tag;
+    epoll_ctl(ep, EPOLL_CTL_ADD, listen_fd, &ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &stop_tag;
+    epoll_ctl(ep, EPOLL_CTL_ADD, stop_fds[index], &ev);
+
+    request_processor processor(table);
+    std::unordered_map<connection*, std::unique_ptr<connection>>    connections;
+    auto close_connection = [&](connection* c){
+        epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, nullptr);
+        close(c->fd);
+        connections.erase(c);
+    };
+    auto set_events = [&](connection* c, uint32_t events){
+        epoll_event cev = {};
+        cev.events = events;
+        cev.data.ptr = c;
+        epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &cev);
+    };
+
+    constexpr int max_events = 64;
+    epoll_event events[max_events];
+    bool done = false;
+    while(!done)
+    {
+        int n = epoll_wait(ep, events, max_events, -1);
+        if (n < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            report("epoll_wait");
+            break;
+        }
+        for(int i = 0; i < n; ++i)
+        {
+            if (&stop_tag == events[i].data.ptr)
+            {
+                done = true;
+                continue;
+            }
+            if (&listen_tag == events[i].data.ptr)
+            {
+                int fd;
+                while((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    if (cfg.unix_path.empty())
+                    {
+                        int one = 1;
+                        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    }
+                    auto c = new connection(fd);
+                    connections.emplace(c, std::unique_ptr<connection>(c));
+                    epoll_event cev = {};
+                    cev.events = EPOLLIN | EPOLLRDHUP;
+                    cev.data.ptr = c;
+                    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &cev);
+                }
+                continue;
+            }
+
+            connection* c = static_cast<connection*>(events[i].data.ptr);
+            if (0 != (events[i].events & EPOLLERR))
+            {
+                close_connection(c);
+                continue;
+            }
+            if (0 != (events[i].events & EPOLLOUT))
+            {
+                if (!write_pending(*c))
+                {
+                    close_connection(c);
+                    continue;
+                }
+                if (c->wbuf.empty())
+                {
+                    if (c->closing)
+                    {
+                        close_connection(c);
+                        continue;
+                    }
+                    // Flushed, resume reading, there may be complete
+                    // requests buffered.
+                    set_events(c, EPOLLIN | EPOLLRDHUP);
+                    c->closing = !processor.process(*c);
+                }
+            }
+            if (0 != (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && c->wbuf.empty())
+            {
+                c->closing = !read_available(*c);
+                if (!processor.process(*c))
+                {
+                    c->closing = true;
+                }
+            }
+            if (!write_pending(*c) || (c->closing && c->wbuf.empty()))
+            {
+                close_connection(c);
+                continue;
+            }
+            if (!c->wbuf.empty())
+            {
+                // Stop reading until the responses have been sent.
+                set_events(c, EPOLLOUT);
+            }
+        }
+    }
+
+    for(auto& c : connections)
+    {
+        close(c.first->fd);
+    }
+    connections.clear();
+    close(ep);
+}
+
+    } //namespace concurrent
+} //namespace benedias
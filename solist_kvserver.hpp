@@ -0,0 +1,143 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_KVSERVER_HPP
+#define BENEDIAS_SOLIST_KVSERVER_HPP
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "solist.hpp"
+
+namespace benedias {
+    namespace concurrent {
+
+    /// Binary protocol of the solist key value server.
+    /// Every message, request or response, is a header followed by
+    /// length bytes of body, integers are in host byte order,
+    /// the server is intended for local (Unix socket or loopback) use.
+    ///
+    /// request  get   body: key
+    ///          set   body: key, value bytes
+    ///          del   body: key
+    ///          mget  body: count keys
+    /// response get   status ok body: value bytes, or status not_found
+    ///          set   status ok, or busy if the table refused the write, or
+    ///                is over its memory limit, set again later
+    ///          del   status ok or not_found
+    ///          mget  status ok body: count entries of
+    ///                  value length (kv::absent if not found), value bytes
+    ///
+    /// Requests may be pipelined, responses are sent in request order.
+    /// Keys are 31 bit, the table maps them to hash values with a seeded
+    /// bijection, see solist_key_hash.
+    namespace kv {
+        enum op : uint8_t
+        {
+            op_get = 1,
+            op_set = 2,
+            op_del = 3,
+            op_mget = 4,
+        };
+
+        enum status : uint8_t
+        {
+            st_ok = 0,
+            st_not_found = 1,
+            st_busy = 2,
+            st_error = 3,
+        };
+
+        struct header
+        {
+            uint8_t     op;
+            uint8_t     status;
+            uint16_t    count;
+            uint32_t    length;
+        };
+        static_assert(sizeof(header) == 8, "kv::header must be packed");
+
+        using key = hash_t;
+        constexpr key       max_key = solist_key_hash::MAX_KEY;
+        constexpr uint32_t  max_body = 1u << 20;
+        constexpr uint32_t  absent = 0xffffffff;
+    } // namespace kv
+
+    /// Key value store backed by a solist<std::string>, served over a Unix
+    /// domain socket or loopback TCP.
+    /// Each worker thread runs an epoll event loop, bound to a core,
+    /// connections are owned by the worker which accepted them.
+    /// Runs of pipelined get and mget requests read from a connection
+    /// are batched into a single bulk lookup.
+    class solist_kvserver
+    {
+        public:
+        struct config
+        {
+            // Unix socket path, used if not empty.
+            std::string unix_path;
+            // Loopback TCP port, used if unix_path is empty.
+            uint16_t    tcp_port = 0;
+            // Number of worker threads, 0 for one per core.
+            unsigned    threads = 0;
+            uint32_t    buckets = 1024;
+        };
+
+        private:
+        config      cfg;
+        int         listen_fd = -1;
+        std::shared_ptr<solist<std::string>>    table;
+        std::vector<std::thread>    workers;
+        // eventfd per worker, written to stop the worker.
+        std::vector<int>    stop_fds;
+        std::atomic<bool>   running{false};
+
+        void worker(unsigned index);
+
+        public:
+        // Non copyable
+        solist_kvserver& operator=(const solist_kvserver&) = delete;
+        solist_kvserver(solist_kvserver const&) = delete;
+
+        explicit solist_kvserver(const config& config);
+        ~solist_kvserver();
+
+        /// Bind, listen and start the workers.
+        /// \@return false on failure, errors are reported on stderr.
+        bool start();
+        /// Stop the workers and close all connections.
+        void stop();
+
+        inline std::shared_ptr<solist<std::string>> store()
+        {
+            return table;
+        }
+
+        /// The TCP port listened on, valid after start,
+        /// if the configured port was 0 this is the ephemeral port.
+        inline uint16_t port() const
+        {
+            return cfg.tcp_port;
+        }
+    };
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_KVSERVER_HPP
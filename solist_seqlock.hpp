@@ -0,0 +1,239 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_SEQLOCK_HPP
+#define BENEDIAS_SOLIST_SEQLOCK_HPP
+#include "solist.hpp"
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+namespace benedias {
+    namespace concurrent {
+
+    /// Payload updated in place under a sequence lock, for small plain
+    /// values which change often, such as statistics or positions.
+    /// Writers are serialised by the sequence, odd while a write is in
+    /// progress, readers copy the value and retry if the sequence changed,
+    /// so reads do not write shared memory and updates do not allocate.
+    /// The value is held in relaxed atomic words, so racing copies are
+    /// well defined, torn copies are discarded by the sequence check.
+    template <typename V> class solist_seqlock
+    {
+        static_assert(std::is_trivially_copyable<V>::value, "solist_seqlock values must be trivially copyable");
+        static constexpr std::size_t WORDS = (sizeof(V) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        std::atomic<uint32_t>   seq{0};
+        std::atomic<uint64_t>   words[WORDS];
+
+        inline void store_words(const uint64_t* w)
+        {
+            for(std::size_t i = 0; i < WORDS; ++i)
+            {
+                words[i].store(w[i], std::memory_order_relaxed);
+            }
+        }
+
+        inline void load_words(uint64_t* w) const
+        {
+            for(std::size_t i = 0; i < WORDS; ++i)
+            {
+                w[i] = words[i].load(std::memory_order_relaxed);
+            }
+        }
+
+        // A consistent copy of the words.
+        // \@return the number of retries.
+        unsigned snapshot(uint64_t* w) const
+        {
+            unsigned retries = 0;
+            while(true)
+            {
+                uint32_t s = seq.load(std::memory_order_acquire);
+                if (0 == (s & 1))
+                {
+                    load_words(w);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (s == seq.load(std::memory_order_relaxed))
+                    {
+                        return retries;
+                    }
+                }
+                ++retries;
+                solist_cpu_relax();
+            }
+        }
+
+        // \@return the even sequence before the write.
+        inline uint32_t lock()
+        {
+            uint32_t s = seq.load(std::memory_order_relaxed);
+            while((s & 1) || !seq.compare_exchange_weak(s, s + 1,
+                        std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                solist_cpu_relax();
+                s = seq.load(std::memory_order_relaxed);
+            }
+            // Orders the stores of the words after the odd sequence.
+            std::atomic_thread_fence(std::memory_order_release);
+            return s;
+        }
+
+        inline void unlock(uint32_t s)
+        {
+            seq.store(s + 2, std::memory_order_release);
+        }
+
+        static inline void to_words(const V& value, uint64_t* w)
+        {
+            w[WORDS - 1] = 0;
+            std::memcpy(w, &value, sizeof(V));
+        }
+
+        public:
+        /// Zero filled, for containers of records such as solist_cdc.
+        solist_seqlock()
+        {
+            uint64_t w[WORDS] = {};
+            store_words(w);
+        }
+
+        solist_seqlock(const V& value)
+        {
+            uint64_t w[WORDS];
+            to_words(value, w);
+            store_words(w);
+        }
+
+        solist_seqlock(const solist_seqlock& other)
+        {
+            uint64_t w[WORDS];
+            other.snapshot(w);
+            store_words(w);
+        }
+
+        solist_seqlock& operator=(const solist_seqlock& other)
+        {
+            uint64_t w[WORDS];
+            other.snapshot(w);
+            uint32_t s = lock();
+            store_words(w);
+            unlock(s);
+            return *this;
+        }
+
+        /// Copy the value.
+        /// \@return the number of retries, because of concurrent writes.
+        inline unsigned load(V& value) const
+        {
+            uint64_t w[WORDS];
+            unsigned retries = snapshot(w);
+            std::memcpy(&value, w, sizeof(V));
+            return retries;
+        }
+
+        inline void store(const V& value)
+        {
+            uint64_t w[WORDS];
+            to_words(value, w);
+            uint32_t s = lock();
+            store_words(w);
+            unlock(s);
+        }
+
+        /// Calls fn(V&) on a copy of the value and stores the result, with
+        /// writers excluded, fn should be short.
+        /// \@return the new value.
+        template <typename F> V update(F fn)
+        {
+            uint64_t w[WORDS];
+            V value;
+            uint32_t s = lock();
+            load_words(w);
+            std::memcpy(&value, w, sizeof(V));
+            fn(value);
+            to_words(value, w);
+            store_words(w);
+            unlock(s);
+            return value;
+        }
+
+        /// Number of completed writes.
+        inline uint32_t version() const
+        {
+            return seq.load(std::memory_order_acquire) >> 1;
+        }
+    };
+
+    /// Accessor for tables of solist_seqlock payloads, values are copied
+    /// out by reads, and updated in place by writes, without allocation.
+    /// Items are inserted, replaced and deleted as for any solist, an in
+    /// place update racing with the replacement or deletion of the item
+    /// is ordered before it, so it may be lost.
+    template <typename V, typename D=solist_directory> class solist_seqlock_accessor:
+        public solist_accessor<solist_seqlock<V>, D>
+    {
+        using base = solist_accessor<solist_seqlock<V>, D>;
+
+        public:
+        using base::base;
+
+        /// Copy the value of hashv.
+        /// \@return false if hashv is absent.
+        bool read(hash_t hashv, V& value)
+        {
+            solist_seqlock<V>* item = this->find_item_node(hashv);
+            if (nullptr == item)
+            {
+                return false;
+            }
+            item->load(value);
+            this->zap();
+            return true;
+        }
+
+        /// Store value as the value of hashv, in place.
+        /// \@return false if hashv is absent.
+        bool write(hash_t hashv, const V& value)
+        {
+            return update(hashv, [&](V& v){ v = value; });
+        }
+
+        /// Calls fn(V&) to update the value of hashv in place, writers of
+        /// the item are excluded for the duration of the call.
+        /// \@return false if hashv is absent.
+        template <typename F> bool update(hash_t hashv, F fn)
+        {
+            solist_seqlock<V>* item = this->find_item_node(hashv);
+            if (nullptr == item)
+            {
+                return false;
+            }
+            V value = item->update(fn);
+            this->zap();
+            if (this->so_list->change_feed())
+            {
+                this->so_list->change_feed()->append_update(hashv, solist_seqlock<V>(value));
+            }
+            return true;
+        }
+    };
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_SEQLOCK_HPP
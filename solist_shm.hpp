@@ -0,0 +1,302 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_SHM_HPP
+#define BENEDIAS_SOLIST_SHM_HPP
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <unistd.h>
+#include "solist_index.hpp"
+#include "shm_region.hpp"
+
+namespace benedias {
+    namespace concurrent {
+
+    // Maximum number of concurrent accessors, across all processes.
+#ifndef SOLIST_SHM_MAX_SLOTS
+#define SOLIST_SHM_MAX_SLOTS    128
+#endif
+
+    struct solist_shm_header
+    {
+        static constexpr uint64_t   MAGIC = 0x54534c4f53484d31ull;
+        static constexpr uint32_t   VERSION = 2;
+        uint64_t                magic;
+        uint32_t                version;
+        uint32_t                node_size;
+        // Total number of nodes, excluding the null node 0.
+        uint32_t                capacity;
+        // Sentinel nodes are [1, sentinel_end), data nodes [sentinel_end, capacity].
+        uint32_t                sentinel_end;
+        uint32_t                max_buckets;
+        uint32_t                max_bucket_length;
+        std::atomic<uint32_t>   ready;
+        std::atomic<uint32_t>   n_buckets;
+        std::atomic<uint32_t>   n_items;
+        // Free list of nodes, generation in the upper 32 bits, index in
+        // the lower 32 bits, the generation makes pops ABA safe.
+        std::atomic<uint64_t>   free_head;
+        // Sentinel nodes are allocated by bumping sentinel_next, nodes of
+        // failed bucket initialisations are recycled on sentinel_head.
+        std::atomic<uint64_t>   sentinel_head;
+        std::atomic<uint32_t>   sentinel_next;
+        solist_index_hazard_slot    slots[SOLIST_SHM_MAX_SLOTS];
+    };
+
+    /// Split ordered list in a shared memory region, usable by multiple
+    /// processes concurrently.
+    /// Nodes, bucket sentinels, the bucket directory, the free list
+    /// and the hazard pointers are in the region, links are node indices.
+    /// The region is sized at creation, the node capacity and the maximum
+    /// number of buckets are fixed, the number of buckets in use doubles
+    /// as items are inserted.
+    /// Payloads must be trivially copyable, they are copied in and out.
+    /// Retired nodes are held by the retiring accessor until they are
+    /// no longer hazardous, then returned to the shared free list, those
+    /// still hazardous when the accessor is destroyed are left in the
+    /// region for other accessors to free.
+    /// The slots of processes which died holding them are reclaimed when
+    /// the slots run out.
+    template <typename T> class solist_shm
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                "solist_shm payloads must be trivially copyable");
+
+        std::unique_ptr<shm_region> region;
+        solist_shm_header*  hdr;
+        std::atomic<uint32_t>*  directory;
+        solist_index_node<T>*   nodes;
+
+        static inline std::size_t align(std::size_t v)
+        {
+            return (v + 63) & ~std::size_t(63);
+        }
+
+        static inline std::size_t directory_offset()
+        {
+            return align(sizeof(solist_shm_header));
+        }
+
+        static inline std::size_t nodes_offset(uint32_t max_buckets)
+        {
+            return align(directory_offset() + max_buckets * sizeof(std::atomic<uint32_t>));
+        }
+
+        explicit solist_shm(std::unique_ptr<shm_region> r):region(std::move(r))
+        {
+            hdr = region->at<solist_shm_header>(0);
+            directory = region->at<std::atomic<uint32_t>>(directory_offset());
+            nodes = region->at<solist_index_node<T>>(nodes_offset(hdr->max_buckets));
+        }
+
+        public:
+        // Non copyable
+        solist_shm& operator=(const solist_shm&) = delete;
+        solist_shm(solist_shm const&) = delete;
+
+        /// Create the named table, fails if the name exists.
+        /// \@param capacity - the number of items.
+        /// \@param max_buckets - rounded up to a power of 2, nodes for the
+        ///         bucket sentinels are reserved in addition to capacity,
+        ///         so inserting items cannot starve bucket initialisation.
+        /// \@return nullptr on failure.
+        static std::shared_ptr<solist_shm> create(const std::string& name, uint32_t capacity,
+                uint32_t max_buckets, uint32_t bucket_length=4)
+        {
+            uint32_t nb = 1;
+            while(nb < max_buckets)
+            {
+                nb <<= 1;
+            }
+            // a bucket sentinel per bucket, plus one in hand per accessor.
+            uint32_t sentinel_end = 1 + nb + SOLIST_SHM_MAX_SLOTS;
+            capacity += sentinel_end - 1;
+            // index 0 is the null link.
+            std::size_t size = nodes_offset(nb) + (std::size_t(capacity) + 1) * sizeof(solist_index_node<T>);
+            auto r = shm_region::create(name, size);
+            if (!r)
+            {
+                return nullptr;
+            }
+            // The region is zero filled, all atomics are 0.
+            solist_shm_header* h = r->at<solist_shm_header>(0);
+            h->magic = solist_shm_header::MAGIC;
+            h->version = solist_shm_header::VERSION;
+            h->node_size = sizeof(solist_index_node<T>);
+            h->capacity = capacity;
+            h->sentinel_end = sentinel_end;
+            h->max_buckets = nb;
+            h->max_bucket_length = bucket_length;
+            std::shared_ptr<solist_shm> table(new solist_shm(std::move(r)));
+            // node 1 is the sentinel of bucket 0, the head of the list.
+            h->sentinel_next.store(2, std::memory_order_relaxed);
+            for(uint32_t i = capacity; i > sentinel_end; --i)
+            {
+                table->node(i).next.store(i - 1, std::memory_order_relaxed);
+            }
+            h->free_head.store(capacity, std::memory_order_relaxed);
+            table->node(1).key = sol_bucket_key(0);
+            table->directory[0].store(1, std::memory_order_relaxed);
+            h->n_buckets.store(std::min(2u, nb), std::memory_order_relaxed);
+            h->ready.store(1, std::memory_order_release);
+            return table;
+        }
+
+        /// Open a table created by create, in this or another process.
+        /// \@param timeout - the maximum wait for the creator to initialise
+        ///         the table, it may have died while doing so.
+        /// \@return nullptr on failure, if the table is incompatible, or
+        ///         was not initialised within timeout.
+        static std::shared_ptr<solist_shm> open(const std::string& name,
+                std::chrono::milliseconds timeout=std::chrono::seconds(1))
+        {
+            auto r = shm_region::open(name);
+            if (!r || r->size() < sizeof(solist_shm_header))
+            {
+                return nullptr;
+            }
+            solist_shm_header* h = r->at<solist_shm_header>(0);
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            while(0 == h->ready.load(std::memory_order_acquire))
+            {
+                if (std::chrono::steady_clock::now() >= deadline)
+                {
+                    return nullptr;
+                }
+                std::this_thread::yield();
+            }
+            if (solist_shm_header::MAGIC != h->magic || solist_shm_header::VERSION != h->version
+                    || sizeof(solist_index_node<T>) != h->node_size
+                    || r->size() < nodes_offset(h->max_buckets) + (std::size_t(h->capacity) + 1) * h->node_size)
+            {
+                return nullptr;
+            }
+            return std::shared_ptr<solist_shm>(new solist_shm(std::move(r)));
+        }
+
+        static bool unlink(const std::string& name)
+        {
+            return shm_region::unlink(name);
+        }
+
+        inline solist_shm_header& header()
+        {
+            return *hdr;
+        }
+
+        inline solist_index_node<T>& node(uint32_t index)
+        {
+            assert(0 != index && index <= hdr->capacity);
+            return nodes[index];
+        }
+
+        inline std::atomic<uint32_t>& bucket(uint32_t slot)
+        {
+            assert(slot < hdr->max_buckets);
+            return directory[slot];
+        }
+
+        inline uint32_t item_count() const
+        {
+            return hdr->n_items.load(std::memory_order_acquire);
+        }
+
+        inline uint32_t bucket_count() const
+        {
+            return hdr->n_buckets.load(std::memory_order_acquire);
+        }
+
+        inline void inc_item_count()
+        {
+            hdr->n_items.fetch_add(1, std::memory_order_release);
+        }
+
+        inline void dec_item_count()
+        {
+            hdr->n_items.fetch_sub(1, std::memory_order_release);
+        }
+
+        inline uint32_t max_bucket_length() const
+        {
+            return hdr->max_bucket_length;
+        }
+
+        /// Double the number of buckets in use, if it is curr_size,
+        /// up to the maximum, the directory is preallocated.
+        inline void expand(uint32_t curr_size)
+        {
+            if (curr_size < hdr->max_buckets)
+            {
+                hdr->n_buckets.compare_exchange_strong(curr_size, curr_size << 1,
+                        std::memory_order_acq_rel, std::memory_order_relaxed);
+            }
+        }
+
+        inline solist_index_hazard_slot* hazard_slots()
+        {
+            return hdr->slots;
+        }
+
+        inline std::size_t hazard_slot_count() const
+        {
+            return SOLIST_SHM_MAX_SLOTS;
+        }
+
+        /// \@return 0 if the table is full.
+        inline uint32_t alloc()
+        {
+            return solist_index_free_list<solist_shm>::pop(*this, hdr->free_head);
+        }
+
+        inline void free(uint32_t index)
+        {
+            assert(index >= hdr->sentinel_end);
+            solist_index_free_list<solist_shm>::push(*this, hdr->free_head, index);
+        }
+
+        uint32_t alloc_sentinel()
+        {
+            uint32_t index = solist_index_free_list<solist_shm>::pop(*this, hdr->sentinel_head);
+            if (0 == index)
+            {
+                index = hdr->sentinel_next.fetch_add(1, std::memory_order_relaxed);
+                assert(index < hdr->sentinel_end);
+            }
+            return index;
+        }
+
+        inline void free_sentinel(uint32_t index)
+        {
+            assert(index < hdr->sentinel_end);
+            solist_index_free_list<solist_shm>::push(*this, hdr->sentinel_head, index);
+        }
+    };
+
+    template <typename T> using solist_shm_accessor = solist_index_accessor<T, solist_shm<T>>;
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_SHM_HPP
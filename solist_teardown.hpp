@@ -0,0 +1,110 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_TEARDOWN_HPP
+#define BENEDIAS_SOLIST_TEARDOWN_HPP
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace benedias {
+    namespace concurrent {
+
+    /// How the nodes of a solist are freed when it is destroyed.
+    enum class solist_teardown_policy : uint8_t
+    {
+        /// By the destroying thread, in one traversal of the list.
+        serial,
+        /// The list is partitioned at bucket nodes, and the partitions are
+        /// freed on several threads, the destroying thread waits for them.
+        parallel,
+        /// The list is handed to the process wide solist_reaper, the
+        /// destroying thread returns at once.
+        background,
+    };
+
+    /// Process wide background destroyer of the lists of destroyed
+    /// tables, a single thread, started on first use, which runs the
+    /// submitted work in order.
+    /// It is never destroyed, so tables destroyed during static
+    /// destruction can still submit, work pending at exit is abandoned,
+    /// call wait() first if the memory must be freed.
+    class solist_reaper
+    {
+        std::mutex  lock;
+        std::condition_variable work_ready;
+        std::condition_variable work_done;
+        std::deque<std::function<void()>>   work;
+        // Work taken off the queue and not yet finished.
+        unsigned    running = 0;
+        bool        started = false;
+
+        solist_reaper();
+        void run();
+
+        public:
+        // Non copyable
+        solist_reaper& operator=(const solist_reaper&) = delete;
+        solist_reaper(solist_reaper const&) = delete;
+
+        static solist_reaper& instance();
+
+        /// Queue fn, runs it on the calling thread if the reaper thread
+        /// could not be started.
+        void submit(std::function<void()> fn);
+
+        /// Wait until the work submitted so far has been run.
+        void wait();
+
+        /// Number of submissions not yet run.
+        std::size_t pending();
+    };
+
+    /// Work submitted to the reaper when it is destroyed, a member of a
+    /// solist declared before the others, so the destructor of the
+    /// solist returns before the work starts, and the other members
+    /// are freed while the allocator is not busy with the list.
+    class solist_deferred_teardown
+    {
+        std::function<void()>   fn;
+
+        public:
+        solist_deferred_teardown() = default;
+        // Non copyable
+        solist_deferred_teardown& operator=(const solist_deferred_teardown&) = delete;
+        solist_deferred_teardown(solist_deferred_teardown const&) = delete;
+
+        ~solist_deferred_teardown()
+        {
+            if (fn)
+            {
+                solist_reaper::instance().submit(std::move(fn));
+            }
+        }
+
+        inline void defer(std::function<void()> work)
+        {
+            fn = std::move(work);
+        }
+    };
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_TEARDOWN_HPP
@@ -0,0 +1,470 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENEDIAS_SOLIST_UNROLLED_HPP
+#define BENEDIAS_SOLIST_UNROLLED_HPP
+#include <cassert>
+#include <cstdint>
+#include "solist.hpp"
+
+namespace benedias {
+    namespace concurrent {
+
+    /// Payload tag of unrolled solists, nodes hold up to K items.
+    template <typename T, unsigned K> struct solist_chunk;
+
+    /// Unrolled data node, a sorted array of up to K keys and payloads,
+    /// the key of the node is the smallest key in the array.
+    /// Chunks are immutable once published, they are replaced, see
+    /// solist_unrolled_accessor.
+    /// The keys are packed together so a search of a chunk reads the
+    /// keys only, with K=4 and 8 byte payloads a chunk is a cache line.
+    template <typename T, unsigned K> struct alignas(64) solist_node<solist_chunk<T, K>>: solist_bucket
+    {
+        static_assert(K > 1 && K <= 32, "unrolled chunks hold 2 to 32 items");
+        uint32_t        count = 0;
+        so_key          keys[K];
+        T               payloads[K];
+
+        // Non copyable
+        solist_node& operator=(const solist_node&) = delete;
+        solist_node(solist_node const&) = delete;
+
+        // Non movable
+        solist_node& operator=(solist_node&&) = delete;
+        solist_node(solist_node&&) = delete;
+
+        solist_node() = default;
+        ~solist_node() = default;
+
+        static inline void destroy(solist_node* node)
+        {
+            delete node;
+        }
+
+        /// \@return the index of k, or count if k is not present.
+        inline uint32_t index_of(so_key k) const
+        {
+            for(uint32_t i = 0; i < count; ++i)
+            {
+                if (keys[i] >= k)
+                {
+                    return keys[i] == k ? i : count;
+                }
+            }
+            return count;
+        }
+
+        inline so_key last_key() const
+        {
+            return keys[count - 1];
+        }
+
+        inline void append(so_key k, const T& payload)
+        {
+            assert(count < K);
+            keys[count] = k;
+            payloads[count] = payload;
+            if (0 == count++)
+            {
+                key = k;
+            }
+        }
+
+        /// Copy of entries [from, to) of this chunk.
+        solist_node* copy(uint32_t from, uint32_t to) const
+        {
+            solist_node* node = new solist_node();
+            for(uint32_t i = from; i < to; ++i)
+            {
+                node->append(keys[i], payloads[i]);
+            }
+            return node;
+        }
+    };
+
+    /// Lookups of unrolled solists search chunks, they do not consult
+    /// bucket filters or first data node hints, so the options are rejected.
+    template <typename T, unsigned K> struct solist_unsupported_options<solist_chunk<T, K>>
+    {
+        static constexpr unsigned value = solist_bucket_filters | solist_bucket_hints;
+    };
+
+    template <typename T, unsigned K=4> using solist_unrolled = solist<solist_chunk<T, K>>;
+
+    /// Accessor for unrolled solists, a chain of n items is a chain of
+    /// about n/K nodes, so a lookup takes fewer cache misses.
+    /// Chunks are replaced by a copy, to insert or delete an item, or to
+    /// split a full chunk, or a chunk spanning a new bucket sentinel.
+    /// A chunk is replaced by building the replacement chain, linked to
+    /// the successor of the chunk, then marking the chunk with its next
+    /// link set to the replacement in a single CAS, so unlinking the marked
+    /// chunk, by any thread, links the replacement.
+    /// Items are never absent from the list during a replacement.
+    /// Payloads are copied, they should be small and copyable.
+    template <typename T, unsigned K=4> class solist_unrolled_accessor:
+        public solist_accessor<solist_chunk<T, K>>
+    {
+        using base = solist_accessor<solist_chunk<T, K>>;
+        using chunk = solist_node<solist_chunk<T, K>>;
+        using base::so_list;
+        using base::hpc;
+        using base::next;
+        using base::next_tag;
+        using base::cur;
+        using base::prev;
+        using base::load_next;
+        using base::next_key_le;
+        using base::advance;
+        using base::retire;
+        using base::zap;
+        using base::hazp_acquire;
+        using base::get_parent;
+        using base::last_status;
+        // Operations of single item nodes, not applicable.
+        using base::find_item_node;
+        using base::find_items;
+        using base::enable_hot_cache;
+        using base::link_node;
+        using base::find_node;
+        using base::insert_key;
+        using base::delete_key;
+        using base::find_key;
+        using base::replace;
+        using base::insert_or_assign;
+        using base::insert_or_assign_key;
+        using base::fetch_add;
+        using base::compare_exchange;
+        using base::update;
+        using base::clear;
+
+        static inline chunk* as_chunk(solist_bucket* node)
+        {
+            return static_cast<chunk*>(node);
+        }
+
+        static void destroy_chain(solist_bucket* head, solist_bucket* end)
+        {
+            while(head != end)
+            {
+                solist_bucket* n = head->next.load(std::memory_order_relaxed);
+                if (head->is_node())
+                {
+                    chunk::destroy(as_chunk(head));
+                }
+                else
+                {
+                    delete head;
+                }
+                head = n;
+            }
+        }
+
+        // Replace node by the chain head ... tail, node is protected,
+        // succ was loaded from node->next unmarked, prev_node precedes node.
+        // \@return false if node has changed.
+        bool replace(solist_bucket* prev_node, solist_bucket* node, solist_bucket* succ,
+                solist_bucket* head, solist_bucket* tail)
+        {
+            uintptr_t head_tag;
+            if (nullptr == head)
+            {
+                // Nothing replaces node, delete it.
+                head = succ;
+                head_tag = next_tag;
+            }
+            else
+            {
+                tail->next.store(succ, std::memory_order_relaxed);
+                head_tag = mark_ptr_tag<solist_bucket>::tag(head);
+            }
+            if (!node->next.CAS(succ, head, true, std::memory_order_release))
+            {
+                destroy_chain(head, succ);
+                return false;
+            }
+            // Once published head may be replaced and reclaimed by other
+            // threads, so it is not dereferenced.
+            if (prev_node->next.CAS_tagged(node, head, head_tag, std::memory_order_release))
+            {
+                retire(node);
+            }
+            return true;
+        }
+
+        // Position cur on the last node with key <= key, a sentinel or a chunk.
+        void locate(hash_t hashv, so_key key)
+        {
+            uint32_t slot = hashv % so_list->buckets.size();
+            if (nullptr == so_list->buckets[slot])
+            {
+                initialise_bucket(slot);
+            }
+locate_try_again:
+            prev = cur = so_list->buckets[slot];
+            hpc->store(base::HP_PREV, prev);
+            hpc->store(base::HP_CUR, cur);
+            load_next();
+            while((nullptr != next) && next_key_le(key))
+            {
+                if (!advance())
+                {
+                    goto locate_try_again;
+                }
+            }
+        }
+
+        public:
+        using base::base;
+
+        /// Lazily initialise a bucket, a chunk spanning the bucket key
+        /// is split around the new sentinel.
+        void initialise_bucket(hash_t slot)
+        {
+            assert(slot < so_list->buckets.size());
+            if (so_list->buckets[slot] != nullptr)
+            {
+                return;
+            }
+
+            hazp_acquire();
+            so_key key = sol_bucket_key(slot);
+            solist_bucket* bucket = nullptr;
+            while(nullptr == so_list->buckets[slot])
+            {
+                get_parent(slot, key);
+                if (nullptr != next && next->key == key)
+                {
+                    bucket = next;
+                    break;
+                }
+                auto node = new solist_bucket(slot);
+                if (cur->is_node() && as_chunk(cur)->last_key() > key)
+                {
+                    // A chunk never spans a sentinel, replace it by
+                    // [lower chunk ->] sentinel -> upper chunk.
+                    chunk* c = as_chunk(cur);
+                    uint32_t split = 0;
+                    while(c->keys[split] < key)
+                    {
+                        ++split;
+                    }
+                    chunk* upper = c->copy(split, c->count);
+                    node->next.store(upper, std::memory_order_relaxed);
+                    solist_bucket* head = node;
+                    if (0 != split)
+                    {
+                        head = c->copy(0, split);
+                        head->next.store(node, std::memory_order_relaxed);
+                    }
+                    if (replace(prev, c, next, head, upper))
+                    {
+                        bucket = node;
+                        break;
+                    }
+                }
+                else
+                {
+                    node->next.store(next, std::memory_order_relaxed);
+                    if (cur->next.CAS(next, node, std::memory_order_release))
+                    {
+                        bucket = node;
+                        break;
+                    }
+                    delete node;
+                }
+            }
+
+            if (nullptr != bucket)
+            {
+                so_list->buckets.set(slot, bucket);
+            }
+            assert(nullptr != so_list->buckets[slot]);
+            assert(so_list->buckets[slot]->key == key);
+        }
+
+        bool insert_node(hash_t hashv, T payload)
+        {
+            hazp_acquire();
+            if (hazptr_status::over_limit == (last_status = hpc->admit()))
+            {
+                return false;
+            }
+            so_key key = sol_node_key(hashv);
+            bool result = false;
+            while(true)
+            {
+                locate(hashv, key);
+                solist_bucket* target_prev = prev;
+                chunk* target = nullptr;
+                solist_bucket* succ = next;
+                if (cur->is_node())
+                {
+                    target = as_chunk(cur);
+                    if (target->index_of(key) != target->count)
+                    {
+                        break;
+                    }
+                }
+                else if (nullptr != next && next->is_node() && as_chunk(next)->count < K)
+                {
+                    // Add to the chunk after the sentinel, it has room,
+                    // key becomes its smallest key.
+                    bool marked;
+                    target_prev = cur;
+                    target = as_chunk(next);
+                    succ = target->next.load(&marked, std::memory_order_acquire);
+                    if (marked)
+                    {
+                        continue;
+                    }
+                }
+                else
+                {
+                    // A new chunk after the sentinel.
+                    chunk* node = new chunk();
+                    node->append(key, payload);
+                    node->next.store(next, std::memory_order_relaxed);
+                    if (cur->next.CAS(next, node, std::memory_order_release))
+                    {
+                        result = true;
+                        break;
+                    }
+                    chunk::destroy(node);
+                    continue;
+                }
+
+                // Merge key into a copy of target, split if it is full.
+                uint32_t pos = 0;
+                while(pos < target->count && target->keys[pos] < key)
+                {
+                    ++pos;
+                }
+                uint32_t total = target->count + 1;
+                uint32_t first = total > K ? total / 2 : total;
+                chunk* head = new chunk();
+                chunk* tail = head;
+                for(uint32_t i = 0; i < total; ++i)
+                {
+                    if (i == first)
+                    {
+                        tail = new chunk();
+                        head->next.store(tail, std::memory_order_relaxed);
+                    }
+                    if (i < pos)
+                    {
+                        tail->append(target->keys[i], target->payloads[i]);
+                    }
+                    else if (i == pos)
+                    {
+                        tail->append(key, payload);
+                    }
+                    else
+                    {
+                        tail->append(target->keys[i - 1], target->payloads[i - 1]);
+                    }
+                }
+                if (replace(target_prev, target, succ, head, tail))
+                {
+                    result = true;
+                    break;
+                }
+            }
+
+            if (result)
+            {
+                so_list->inc_item_count();
+                uint32_t nbuckets = so_list->buckets.size();
+                if (so_list->item_count() >= so_list->max_bucket_length * nbuckets)
+                {
+                    // Buckets are initialised lazily, on first access.
+                    so_list->expand(nbuckets);
+                }
+            }
+            zap();
+            return result;
+        }
+
+        bool delete_node(hash_t hashv)
+        {
+            hazp_acquire();
+            if (hazptr_status::over_limit == (last_status = hpc->admit()))
+            {
+                return false;
+            }
+            so_key key = sol_node_key(hashv);
+            bool result = false;
+            while(true)
+            {
+                locate(hashv, key);
+                if (!cur->is_node())
+                {
+                    break;
+                }
+                chunk* target = as_chunk(cur);
+                uint32_t index = target->index_of(key);
+                if (index == target->count)
+                {
+                    break;
+                }
+                chunk* head = nullptr;
+                if (target->count > 1)
+                {
+                    head = target->copy(0, index);
+                    for(uint32_t i = index + 1; i < target->count; ++i)
+                    {
+                        head->append(target->keys[i], target->payloads[i]);
+                    }
+                }
+                if (replace(prev, target, next, head, head))
+                {
+                    so_list->dec_item_count();
+                    result = true;
+                    break;
+                }
+            }
+            zap();
+            return result;
+        }
+
+        /// Copy the payload of an item out.
+        /// \@return false if the item is not present.
+        bool find_item(hash_t hashv, T* payload)
+        {
+            hazp_acquire();
+            so_key key = sol_node_key(hashv);
+            bool result = false;
+            locate(hashv, key);
+            if (cur->is_node())
+            {
+                chunk* c = as_chunk(cur);
+                uint32_t index = c->index_of(key);
+                if (index != c->count)
+                {
+                    *payload = c->payloads[index];
+                    result = true;
+                }
+            }
+            zap();
+            return result;
+        }
+    };
+
+    } //namespace concurrent
+} //namespace benedias
+#endif // #define BENEDIAS_SOLIST_UNROLLED_HPP
@@ -0,0 +1,321 @@
+/*
+
+Copyright (C) 2018-2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This file is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TAGGED_MARK_PTR_HPP_INCLUDED
+#define _TAGGED_MARK_PTR_HPP_INCLUDED
+
+#include "mark_ptr_type.hpp"
+#include <atomic>
+#include <cstdint>
+
+namespace benedias {
+namespace concurrent {
+
+// Double width CAS is available inline, if the compiler says so,
+// on x86-64 this requires -mcx16 (cmpxchg16b), on AArch64 the
+// LDXP/STXP or LSE CASP instructions are used.
+// Otherwise the __atomic builtins are used, which may be implemented
+// with locks in libatomic, the Makefile links -latomic.
+#if defined(__SIZEOF_INT128__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+#define TAGGED_MARK_PTR_NATIVE_DWCAS    1
+typedef unsigned __int128   tagged_mark_ptr_dword;
+#elif !defined(__SIZEOF_INT128__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+#define TAGGED_MARK_PTR_NATIVE_DWCAS    1
+typedef uint64_t    tagged_mark_ptr_dword;
+#else
+#define TAGGED_MARK_PTR_NATIVE_DWCAS    0
+#if defined(__SIZEOF_INT128__)
+typedef unsigned __int128   tagged_mark_ptr_dword;
+#else
+typedef uint64_t    tagged_mark_ptr_dword;
+#endif
+#endif
+
+/// Pointer with a mark bit and a generation count, which are updated
+/// together with a double width CAS.
+/// The generation count is incremented on every update, so a CAS
+/// with an expected generation fails if the pointer has changed and
+/// changed back in the interim (ABA), which mark_ptr_type cannot detect.
+/// Intended for reclamation free fast paths like node free lists,
+/// where nodes are recycled without a hazard pointer scan.
+/// The API mirrors mark_ptr_type, CAS operations without a generation
+/// behave like mark_ptr_type CAS operations, the CAS_gen operations
+/// additionally require the generation to match.
+/// On the native path the memory order argument is advisory,
+/// double width CAS instructions are full barriers.
+template <typename T> class alignas(2 * sizeof(uintptr_t)) tagged_mark_ptr
+{
+    private:
+        // Pointer and mark in the low word, generation in the high word.
+        uintptr_t   upv = 0;
+        uintptr_t   gen = 0;
+
+        typedef tagged_mark_ptr_dword dword;
+        static constexpr unsigned word_bits = sizeof(uintptr_t) * 8;
+
+        static inline dword make_dword(uintptr_t pv, uintptr_t g)
+        {
+            return static_cast<dword>(pv) | (static_cast<dword>(g) << word_bits);
+        }
+
+        static inline uintptr_t dword_pv(dword v)
+        {
+            return static_cast<uintptr_t>(v);
+        }
+
+        static inline uintptr_t dword_gen(dword v)
+        {
+            return static_cast<uintptr_t>(v >> word_bits);
+        }
+
+        inline dword* dword_address()
+        {
+            return reinterpret_cast<dword*>(&upv);
+        }
+
+        // Compare and swap the pointer and generation, returns the
+        // previous value.
+        inline dword cas_dword(dword expected, dword desired, std::memory_order order)
+        {
+#if TAGGED_MARK_PTR_NATIVE_DWCAS
+            (void)order;
+            return __sync_val_compare_and_swap(dword_address(), expected, desired);
+#else
+            __atomic_compare_exchange_n(dword_address(), &expected, desired, false,
+                    static_cast<int>(order), __ATOMIC_RELAXED);
+            return expected;
+#endif
+        }
+
+        // Read the pointer and generation, the generation is read first,
+        // a later pointer value can only be paired with an earlier
+        // generation, since every update increments the generation a
+        // CAS with a torn snapshot fails.
+        inline dword load_dword(std::memory_order order) const
+        {
+#if TAGGED_MARK_PTR_NATIVE_DWCAS
+            uintptr_t g = __atomic_load_n(&gen, __ATOMIC_ACQUIRE);
+            uintptr_t pv = __atomic_load_n(&upv, static_cast<int>(order));
+            return make_dword(pv, g);
+#else
+            return __atomic_load_n(reinterpret_cast<const dword*>(&upv), static_cast<int>(order));
+#endif
+        }
+
+        inline uintptr_t load_pv(std::memory_order order) const
+        {
+#if TAGGED_MARK_PTR_NATIVE_DWCAS
+            return __atomic_load_n(&upv, static_cast<int>(order));
+#else
+            return dword_pv(load_dword(order));
+#endif
+        }
+
+        // CAS the pointer word, bumping the generation, regardless of
+        // the current generation.
+        // Retries only if the pointer word matched but the generation
+        // did not, so this fails only if the pointer word differs.
+        inline bool cas_value(uintptr_t pv_expected, uintptr_t pv_desired, std::memory_order order)
+        {
+            dword expected = load_dword(std::memory_order_relaxed);
+            if (dword_pv(expected) != pv_expected)
+            {
+                return false;
+            }
+            for(;;)
+            {
+                dword desired = make_dword(pv_desired, dword_gen(expected) + 1);
+                expected = make_dword(pv_expected, dword_gen(expected));
+                dword prev = cas_dword(expected, desired, order);
+                if (prev == expected)
+                {
+                    return true;
+                }
+                if (dword_pv(prev) != pv_expected)
+                {
+                    return false;
+                }
+                expected = prev;
+            }
+        }
+
+        inline bool cas_gen_value(uintptr_t pv_expected, uintptr_t g, uintptr_t pv_desired,
+                std::memory_order order)
+        {
+            dword expected = make_dword(pv_expected, g);
+            return cas_dword(expected, make_dword(pv_desired, g + 1), order) == expected;
+        }
+
+        static inline uintptr_t encode(T* p, bool mark)
+        {
+            return reinterpret_cast<uintptr_t>(p) | (mark ? mark_bits_mask : 0);
+        }
+
+    public:
+
+    inline T* load(std::memory_order order=std::memory_order_acquire) const
+    {
+        return reinterpret_cast<T*>(load_pv(order) & mark_bits_maskoff);
+    }
+
+    inline T* load(bool *mark, std::memory_order order=std::memory_order_acquire) const
+    {
+        uintptr_t v = load_pv(order);
+        *mark = (0 != (v & mark_bits_mask));
+        return reinterpret_cast<T*>(v & mark_bits_maskoff);
+    }
+
+    /// Read the pointer, mark and generation, for use with CAS_gen.
+    inline T* load(bool *mark, uintptr_t *generation, std::memory_order order=std::memory_order_acquire) const
+    {
+        dword v = load_dword(order);
+        *mark = (0 != (dword_pv(v) & mark_bits_mask));
+        *generation = dword_gen(v);
+        return reinterpret_cast<T*>(dword_pv(v) & mark_bits_maskoff);
+    }
+
+    /// Store a pointer, preserving the mark and incrementing the generation.
+    inline void store(T* p, std::memory_order order=std::memory_order_release)
+    {
+        dword expected = load_dword(std::memory_order_relaxed);
+        for(;;)
+        {
+            dword desired = make_dword(encode(p, 0 != (dword_pv(expected) & mark_bits_mask)),
+                    dword_gen(expected) + 1);
+            dword prev = cas_dword(expected, desired, order);
+            if (prev == expected)
+            {
+                return;
+            }
+            expected = prev;
+        }
+    }
+
+    inline void operator=(T* p)
+    {
+        store(p);
+    }
+
+    inline T* operator()(bool *mark)
+    {
+        return load(mark);
+    }
+
+    inline T* operator()()
+    {
+        return load();
+    }
+
+    inline T* operator->()
+    {
+        return load();
+    }
+
+    inline uintptr_t generation(std::memory_order order=std::memory_order_acquire) const
+    {
+        return __atomic_load_n(&gen, static_cast<int>(order));
+    }
+
+    explicit tagged_mark_ptr()
+    {
+    }
+
+    explicit tagged_mark_ptr(T* p):upv(reinterpret_cast<uintptr_t>(p))
+    {
+    }
+
+    tagged_mark_ptr(const tagged_mark_ptr& other) = delete;
+    tagged_mark_ptr& operator=(const tagged_mark_ptr& other) = delete;
+
+    inline bool CAS(T* expected, T* desired, std::memory_order order=std::memory_order_acq_rel)
+    {
+        return cas_value(encode(expected, false), encode(desired, false), order);
+    }
+
+    inline bool CAS(T* expected, T* desired, bool mark, std::memory_order order=std::memory_order_acq_rel)
+    {
+        return cas_value(encode(expected, false), encode(desired, mark), order);
+    }
+
+    inline bool CAS(T* expected, bool mark, std::memory_order order=std::memory_order_acq_rel)
+    {
+        return cas_value(encode(expected, false), encode(expected, mark), order);
+    }
+
+    inline bool CAS(T* expected, bool marked, T* desired, bool mark,
+            std::memory_order order=std::memory_order_acq_rel)
+    {
+        return cas_value(encode(expected, marked), encode(desired, mark), order);
+    }
+
+    /// CAS which succeeds only if the pointer, mark and generation all
+    /// match, the generation is incremented on success.
+    inline bool CAS_gen(T* expected, bool marked, uintptr_t generation, T* desired, bool mark,
+            std::memory_order order=std::memory_order_acq_rel)
+    {
+        return cas_gen_value(encode(expected, marked), generation, encode(desired, mark), order);
+    }
+
+    inline bool CAS_gen(T* expected, uintptr_t generation, T* desired,
+            std::memory_order order=std::memory_order_acq_rel)
+    {
+        return cas_gen_value(encode(expected, false), generation, encode(desired, false), order);
+    }
+
+    /// Set the mark, returns true if this call set the mark.
+    inline bool mark(std::memory_order order=std::memory_order_acq_rel)
+    {
+        dword expected = load_dword(std::memory_order_relaxed);
+        while(0 == (dword_pv(expected) & mark_bits_mask))
+        {
+            dword desired = make_dword(dword_pv(expected) | mark_bits_mask, dword_gen(expected) + 1);
+            dword prev = cas_dword(expected, desired, order);
+            if (prev == expected)
+            {
+                return true;
+            }
+            expected = prev;
+        }
+        return false;
+    }
+
+    /// Clear the pointer and mark, the generation is preserved so that
+    /// stale CAS_gen operations continue to fail.
+    inline void reset(std::memory_order order=std::memory_order_release)
+    {
+        dword expected = load_dword(std::memory_order_relaxed);
+        for(;;)
+        {
+            dword prev = cas_dword(expected, make_dword(0, dword_gen(expected) + 1), order);
+            if (prev == expected)
+            {
+                return;
+            }
+            expected = prev;
+        }
+    }
+
+    ~tagged_mark_ptr() = default;
+};
+
+static_assert(sizeof(tagged_mark_ptr_dword) == 2 * sizeof(uintptr_t),
+        "tagged_mark_ptr requires a double width integer type.");
+
+} // namespace concurrent
+} // namespace benedias
+#endif // _TAGGED_MARK_PTR_HPP_INCLUDED
@@ -17,6 +17,7 @@ along with this file.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "solist.hpp"
 #include "solist_dbg.hpp"
+#include "test_common.hpp"
 #include <clocale>
 #include <cstdio>
 #include <cstdlib>
@@ -24,10 +25,13 @@ along with this file.  If not, see <http://www.gnu.org/licenses/>.
 #include <ctime>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 using   benedias::concurrent::solist;
 using   benedias::concurrent::solist_accessor;
 using   benedias::concurrent::hash_t;
+using   benedias::concurrent::hazptr_domain;
+using   benedias::concurrent::hazptr_group_domain;
 
 void test0_1(hash_t h[3])
 {
@@ -179,6 +183,69 @@ void test3()
 }
 
 
+// test two solists of different types sharing a hazard pointer domain,
+// deleted nodes are reclaimed through the thread context.
+void test4()
+{
+    auto dom = hazptr_domain::make();
+    solist_accessor<uint32_t> sol1(2, dom);
+    solist_accessor<uint64_t> sol2(2, dom);
+
+    for (hash_t v=0; v < 64; ++v)
+    {
+        sol1.insert_node(v, v);
+        sol2.insert_node(v, uint64_t(v) << 32);
+    }
+    for (hash_t v=0; v < 64; v += 2)
+    {
+        check(sol1.delete_node(v) && sol2.delete_node(v), "could not delete item with hash", v);
+    }
+    for (hash_t v=0; v < 64; ++v)
+    {
+        bool expected = (v & 1);
+        check(expected == (nullptr != sol1.find_item_node(v))
+                && expected == (nullptr != sol2.find_item_node(v)),
+                "unexpected find result for hash", v);
+    }
+    benedias::concurrent::dump_solist_items(sol1);
+    benedias::concurrent::check_solist(sol1);
+    benedias::concurrent::check_solist(sol2);
+}
+
+// test many small solists sharing a group hazard pointer domain.
+void test5()
+{
+    constexpr unsigned n_tables = 10000;
+    std::vector<solist_accessor<uint32_t>> tables;
+    tables.reserve(n_tables);
+    auto dom = hazptr_group_domain("test5");
+    std::cout << "sizeof(solist<uint32_t>)=" << sizeof(solist<uint32_t>)
+        << " sizeof(solist_bucket)=" << sizeof(benedias::concurrent::solist_bucket)
+        << " sizeof(solist_node<uint32_t>)=" << sizeof(benedias::concurrent::solist_node<uint32_t>)
+        << " sizeof(solist_node<uint64_t>)=" << sizeof(benedias::concurrent::solist_node<uint64_t>) << std::endl;
+    for (unsigned t=0; t < n_tables; ++t)
+    {
+        tables.emplace_back(std::make_shared<solist<uint32_t>>(2, dom));
+    }
+    for (unsigned t=0; t < n_tables; ++t)
+    {
+        for (hash_t v=0; v < (t % 8); ++v)
+        {
+            tables[t].insert_node(v, t);
+        }
+        tables[t].delete_node(0);
+    }
+    for (unsigned t=0; t < n_tables; ++t)
+    {
+        for (hash_t v=0; v < (t % 8); ++v)
+        {
+            uint32_t* p = tables[t].find_item_node(v);
+            check((0 == v) == (nullptr == p) && (nullptr == p || *p == t), "table hash", t);
+        }
+    }
+    std::cout << "shared domain use count " << dom.use_count() << std::endl;
+}
+
 // experimental function
 void testx()
 {
@@ -209,25 +276,34 @@ int main( int argc, char* argv[] )
 {
     std::setlocale(LC_ALL, "en_US.UTF-8");
     std::srand(std::time(nullptr)); // use current time as seed for random generator
+    // By default the table tests are run, test0 to test2 and testx
+    // are experiments, run on request.
+    if (argc <= 1)
+    {
+        test3();
+        test4();
+        test5();
+        return test_result();
+    }
     void (*tf)() = test3;
-    if (argc > 1)
+    switch(*argv[1])
     {
-        switch(*argv[1])
-        {
-            case '0':
-                tf = test0; break;
-            case '1':
-                tf = test1; break;
-            case '2':
-                tf = test2; break;
-            case '3':
-                tf = test3; break;
-            case 'x':
-                tf = testx; break;
-        }
+        case '0':
+            tf = test0; break;
+        case '1':
+            tf = test1; break;
+        case '2':
+            tf = test2; break;
+        case '3':
+            tf = test3; break;
+        case '4':
+            tf = test4; break;
+        case '5':
+            tf = test5; break;
+        case 'x':
+            tf = testx; break;
     }
 
     tf();
-    std::cout << "All Done. " << std::endl;
-    return 0;
+    return test_result();
 }
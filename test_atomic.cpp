@@ -0,0 +1,179 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the in place atomic operations, threads count keys which are
+initially absent with fetch_add, compare_exchange and update, no count
+may be lost and each key must be inserted once.
+With the argument bench, also times fetch_add against a lookup and an atomic add by the caller.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::solist_cdc_record;
+using   benedias::concurrent::solist_cdc_feed;
+using   benedias::concurrent::solist_cdc_insert;
+using   benedias::concurrent::hash_t;
+
+constexpr unsigned num_threads = 4;
+constexpr unsigned num_keys = 1000;
+constexpr unsigned num_rounds = 20;
+
+// Every thread counts every key, in a different order.
+void worker(std::shared_ptr<solist<uint64_t>> counts, std::shared_ptr<solist<uint64_t>> cas_counts,
+        std::shared_ptr<solist<uint64_t>> maxima, unsigned t)
+{
+    solist_accessor<uint64_t> acc(counts);
+    solist_accessor<uint64_t> cacc(cas_counts);
+    solist_accessor<uint64_t> macc(maxima);
+    for(unsigned round = 0; round < num_rounds; ++round)
+    {
+        for(unsigned i = 0; i < num_keys; ++i)
+        {
+            hash_t k = (i * 7 + t * 131) % num_keys;
+            acc.fetch_add(k, 1);
+            // The hot key.
+            acc.fetch_add(num_keys, 2);
+
+            uint64_t expected = 0;
+            while(!cacc.compare_exchange(k, expected, expected + 1))
+            {
+            }
+
+            uint64_t v = round * num_threads + t;
+            uint64_t m = macc.update(k, [v](uint64_t x){ return std::max(x, v); });
+            check(m >= v, "update result", k);
+        }
+    }
+}
+
+void test_counting()
+{
+    auto counts = std::make_shared<solist<uint64_t>>(2, 4, solist_cdc_feed);
+    auto cas_counts = std::make_shared<solist<uint64_t>>(2, 4);
+    auto maxima = std::make_shared<solist<uint64_t>>(2, 4);
+    std::vector<std::thread> threads;
+    for(unsigned t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back(worker, counts, cas_counts, maxima, t);
+    }
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+    check(counts->item_count() == num_keys + 1, "item count", counts->item_count());
+    solist_accessor<uint64_t> acc(counts);
+    solist_accessor<uint64_t> cacc(cas_counts);
+    solist_accessor<uint64_t> macc(maxima);
+    for(hash_t k = 0; k < num_keys; ++k)
+    {
+        uint64_t* v = acc.find_item_node(k);
+        check(nullptr != v && *v == num_threads * num_rounds, "fetch_add count", k);
+        v = cacc.find_item_node(k);
+        check(nullptr != v && *v == num_threads * num_rounds, "compare_exchange count", k);
+        v = macc.find_item_node(k);
+        check(nullptr != v && *v == num_threads * num_rounds - 1, "update maximum", k);
+    }
+    uint64_t* hot = acc.find_item_node(num_keys);
+    check(nullptr != hot && *hot == 2 * num_threads * num_rounds * num_keys, "hot key count", num_keys);
+
+    // A failed exchange loads the value, absent keys compare with initial.
+    uint64_t expected = 5;
+    check(!acc.compare_exchange(0, expected, 9) && expected == num_threads * num_rounds,
+            "failed compare_exchange", expected);
+    expected = 1;
+    check(!acc.compare_exchange(num_keys + 1, expected, 9) && 0 == expected
+            && nullptr == acc.find_item_node(num_keys + 1), "compare_exchange absent", expected);
+    check(acc.compare_exchange(num_keys + 1, expected, 9) && 9 == *acc.find_item_node(num_keys + 1),
+            "compare_exchange inserts", expected);
+    check(7 == acc.fetch_add(num_keys + 2, 3, 7) && 10 == *acc.find_item_node(num_keys + 2),
+            "fetch_add initial", 0);
+
+    unsigned inserts = 0;
+    counts->change_feed()->drain([&](const solist_cdc_record<uint64_t>& rec){
+            inserts += rec.op == solist_cdc_insert;
+        });
+    check(num_keys + 1 == inserts || 0 != counts->change_feed()->lost(), "cdc inserts", inserts);
+}
+
+// Counts nkeys keys rounds times, the first round inserts them.
+template <typename F> double time_counting(unsigned nkeys, unsigned rounds, F count)
+{
+    solist_accessor<uint64_t> acc(std::make_shared<solist<uint64_t>>(2, 4));
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned r = 0; r < rounds; ++r)
+    {
+        for(hash_t k = 0; k < nkeys; ++k)
+        {
+            count(acc, k * 2654435761u);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    uint64_t* v = acc.find_item_node(0);
+    check(nullptr != v && rounds == *v, "count", rounds);
+    return elapsed.count();
+}
+
+void bench()
+{
+    constexpr unsigned nkeys = 100000;
+    auto by_hand = [](solist_accessor<uint64_t>& acc, hash_t k){
+        uint64_t* v = acc.find_item_node(k);
+        if (nullptr != v)
+        {
+            __atomic_fetch_add(v, 1, __ATOMIC_ACQ_REL);
+        }
+        else if (!acc.insert_node(k, 1))
+        {
+            __atomic_fetch_add(acc.find_item_node(k), 1, __ATOMIC_ACQ_REL);
+        }
+    };
+    auto fetch_add = [](solist_accessor<uint64_t>& acc, hash_t k){
+        acc.fetch_add(k, 1);
+    };
+    const unsigned rounds[] = {1, 10};
+    for(unsigned r : rounds)
+    {
+        double th = time_counting(nkeys, r, by_hand);
+        double tf = time_counting(nkeys, r, fetch_add);
+        printf("%u keys counted %u times: find_item_node, insert_node and atomic add %.3fs, fetch_add %.3fs\n",
+                nkeys, r, th, tf);
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    test_counting();
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+
+    return test_result();
+}
@@ -0,0 +1,179 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the contention backoff policies, threads insert and delete keys
+of a skewed workload, most keys fall in one bucket, so CAS operations on
+the same nodes fail often, then the table is checked.
+With the argument bench, also times the workload with each policy.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist_fixed;
+using   benedias::concurrent::solist_fixed_accessor;
+using   benedias::concurrent::solist_bucket;
+using   benedias::concurrent::solist_backoff;
+using   benedias::concurrent::solist_backoff_policy;
+using   benedias::concurrent::hash_t;
+using   benedias::concurrent::so_key;
+
+constexpr uint32_t num_buckets = 64;
+constexpr unsigned num_keys = 32;
+
+using table_type = solist_fixed<uint64_t, num_buckets>;
+using accessor_type = solist_fixed_accessor<uint64_t, num_buckets>;
+
+// Keys of thread t, 7 of every 8 in bucket 0, adjacent in the list, so
+// threads contend for the same links.
+inline hash_t key_of(unsigned t, unsigned i)
+{
+    hash_t k = (i * 256 + t) * num_buckets;
+    return 7 == (i & 7) ? k + 1 + (i % (num_buckets - 1)) : k;
+}
+
+void worker(std::shared_ptr<table_type> table, unsigned t, unsigned rounds)
+{
+    accessor_type acc(table);
+    for(unsigned round = 0; round < rounds; ++round)
+    {
+        for(unsigned i = 0; i < num_keys; ++i)
+        {
+            check(acc.insert_node(key_of(t, i), i), "insert", key_of(t, i));
+        }
+        for(unsigned i = 0; i < num_keys; ++i)
+        {
+            // The last round leaves the odd keys.
+            if (round + 1 < rounds || 0 == (i & 1))
+            {
+                check(acc.delete_node(key_of(t, i)), "delete", key_of(t, i));
+            }
+        }
+    }
+}
+
+void check_table(table_type& table, unsigned nthreads)
+{
+    accessor_type acc(std::shared_ptr<table_type>(&table, [](table_type*){}));
+    for(unsigned t = 0; t < nthreads; ++t)
+    {
+        for(unsigned i = 0; i < num_keys; ++i)
+        {
+            uint64_t* v = acc.find_item_node(key_of(t, i));
+            check((0 == (i & 1)) == (nullptr == v), "find", key_of(t, i));
+            check(nullptr == v || *v == i, "value", key_of(t, i));
+        }
+    }
+    bool first = true;
+    so_key last = 0;
+    for(solist_bucket* n = table.buckets[0]; nullptr != n; n = n->next.load())
+    {
+        check(first || n->key > last, "key order", n->key);
+        first = false;
+        last = n->key;
+    }
+    check(table.item_count() == nthreads * num_keys / 2, "item count", table.item_count());
+}
+
+double run(solist_backoff_policy policy, unsigned nthreads, unsigned rounds)
+{
+    auto table = std::make_shared<table_type>(num_buckets);
+    table->set_backoff_policy(policy);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned t = 0; t < nthreads; ++t)
+    {
+        threads.emplace_back(worker, table, t, rounds);
+    }
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    check_table(*table, nthreads);
+    return elapsed.count();
+}
+
+void test_backoff_state()
+{
+    solist_backoff none(solist_backoff_policy::none);
+    solist_backoff exponential(solist_backoff_policy::exponential);
+    for(unsigned i = 0; i < 20; ++i)
+    {
+        none.pause();
+        // past the limit it yields.
+        exponential.pause();
+    }
+    check(20 == none.count() && 20 == exponential.count(), "retry count", exponential.count());
+    // Waits for other threads back off under every policy.
+    solist_backoff waiter(solist_backoff_policy::none);
+    for(unsigned i = 0; i < 20; ++i)
+    {
+        waiter.wait();
+    }
+    check(20 == waiter.count(), "wait count", waiter.count());
+}
+
+void bench()
+{
+    const struct
+    {
+        solist_backoff_policy   policy;
+        const char*             name;
+    } policies[] = {
+        {solist_backoff_policy::none, "none"},
+        {solist_backoff_policy::spin, "spin"},
+        {solist_backoff_policy::exponential, "exponential"},
+        {solist_backoff_policy::adaptive, "adaptive"},
+    };
+    const unsigned thread_counts[] = {8, 64};
+    for(unsigned nthreads : thread_counts)
+    {
+        unsigned rounds = 512 / nthreads;
+        printf("%u threads, %u inserts and deletes each:", nthreads, rounds * num_keys);
+        for(auto& p : policies)
+        {
+            printf(" %s %.3fs", p.name, run(p.policy, nthreads, rounds));
+        }
+        printf("\n");
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    test_backoff_state();
+    for(auto policy : {solist_backoff_policy::none, solist_backoff_policy::spin,
+            solist_backoff_policy::exponential, solist_backoff_policy::adaptive})
+    {
+        run(policy, 8, 4);
+        run(policy, 64, 1);
+    }
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+    return test_result();
+}
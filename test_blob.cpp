@@ -0,0 +1,261 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of variable length nodes, threads concurrently insert, find and
+delete string keys with values of varying lengths, including values
+larger than the largest slab size class.
+*/
+#include "solist_blob.hpp"
+#include <atomic>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_blob;
+using   benedias::concurrent::solist_blob_accessor;
+using   benedias::concurrent::solist_node;
+using   benedias::concurrent::solist_slab;
+using   benedias::concurrent::hash_t;
+
+constexpr unsigned num_threads = 4;
+constexpr unsigned num_keys = 1000;
+constexpr unsigned num_rounds = 3;
+
+std::atomic<unsigned> failures{0};
+
+hash_t hash_bytes(const std::string& s)
+{
+    // FNV-1a
+    hash_t h = 2166136261u;
+    for(unsigned char c : s)
+    {
+        h = (h ^ c) * 16777619u;
+    }
+    return h;
+}
+
+std::string make_key(unsigned t, unsigned i)
+{
+    return "key-" + std::to_string(t) + "-" + std::to_string(i);
+}
+
+std::string make_value(const std::string& key, unsigned round)
+{
+    // mostly short values, every 97th value is larger than a slab block.
+    std::size_t len = (0 == (key.size() + round) % 97) ? 5000 : (hash_bytes(key) + round) % 200;
+    std::string v(len, 'a' + round);
+    return key + ":" + v;
+}
+
+bool check(solist_blob_accessor& acc, const std::string& key, const std::string& expected)
+{
+    std::string value;
+    bool found = acc.find(hash_bytes(key), key.data(), key.size(),
+            [&](const solist_blob& blob){ value.assign(blob.value(), blob.value_len); });
+    return found && value == expected;
+}
+
+void worker(std::shared_ptr<solist<solist_blob>> table, unsigned t)
+{
+    solist_blob_accessor acc(table);
+    for(unsigned i = 0; i < num_keys; ++i)
+    {
+        std::string key = make_key(t, i);
+        std::string value = make_value(key, 0);
+        if (!acc.insert(hash_bytes(key), key.data(), key.size(), value.data(), value.size()))
+        {
+            std::cout << "Failed! insert " << key << std::endl;
+            ++failures;
+        }
+    }
+    for(unsigned round = 1; round <= num_rounds; ++round)
+    {
+        for(unsigned i = 1; i < num_keys; i += 2)
+        {
+            std::string key = make_key(t, i);
+            std::string value = make_value(key, round);
+            if (!acc.erase(hash_bytes(key), key.data(), key.size()) || check(acc, key, make_value(key, round - 1)))
+            {
+                std::cout << "Failed! delete " << key << std::endl;
+                ++failures;
+            }
+            if (!acc.insert(hash_bytes(key), key.data(), key.size(), value.data(), value.size()))
+            {
+                std::cout << "Failed! reinsert " << key << std::endl;
+                ++failures;
+            }
+        }
+    }
+    for(unsigned i = 0; i < num_keys; ++i)
+    {
+        std::string key = make_key(t, i);
+        if (!check(acc, key, make_value(key, (i & 1) ? num_rounds : 0)))
+        {
+            std::cout << "Failed! find " << key << std::endl;
+            ++failures;
+        }
+    }
+}
+
+void test_collision()
+{
+    solist_blob_accessor acc(4);
+    std::string a = "alpha";
+    std::string b = "beta";
+    std::string value;
+    auto copy = [&](const solist_blob& blob){ value.assign(blob.value(), blob.value_len); };
+    if (!acc.insert(7, a.data(), a.size(), "1", 1))
+    {
+        std::cout << "Failed! insert alpha" << std::endl;
+        ++failures;
+    }
+    // same hash value, different key.
+    if (!acc.insert(7, b.data(), b.size(), "2", 1))
+    {
+        std::cout << "Failed! colliding insert" << std::endl;
+        ++failures;
+    }
+    if (acc.insert(7, b.data(), b.size(), "3", 1))
+    {
+        std::cout << "Failed! duplicate insert" << std::endl;
+        ++failures;
+    }
+    if (!acc.find(7, b.data(), b.size(), copy) || value != "2")
+    {
+        std::cout << "Failed! find beta" << std::endl;
+        ++failures;
+    }
+    if (!acc.find(7, a.data(), a.size(), copy) || value != "1")
+    {
+        std::cout << "Failed! find alpha" << std::endl;
+        ++failures;
+    }
+    if (!acc.erase(7, b.data(), b.size()) || acc.erase(7, b.data(), b.size()))
+    {
+        std::cout << "Failed! erase beta" << std::endl;
+        ++failures;
+    }
+    if (!acc.find(7, a.data(), a.size(), copy) || value != "1")
+    {
+        std::cout << "Failed! alpha erased with beta" << std::endl;
+        ++failures;
+    }
+    std::string c = "gamma";
+    if (!acc.insert(c.data(), c.size(), "4", 1) || !acc.find(c.data(), c.size(), copy)
+            || value != "4" || !acc.erase(c.data(), c.size()) || acc.find(c.data(), c.size(), copy))
+    {
+        std::cout << "Failed! key aware gamma" << std::endl;
+        ++failures;
+    }
+}
+
+// Threads insert and erase keys which share few hash values, so every
+// chain holds many items of the same hash value.
+void collision_worker(std::shared_ptr<solist<solist_blob>> table, unsigned t)
+{
+    constexpr unsigned n = 200;
+    solist_blob_accessor acc(table);
+    for(unsigned round = 0; round <= num_rounds; ++round)
+    {
+        for(unsigned i = 0; i < n; ++i)
+        {
+            std::string key = make_key(t, i);
+            std::string value = make_value(key, round);
+            if (!acc.insert(i % 8, key.data(), key.size(), value.data(), value.size()))
+            {
+                std::cout << "Failed! colliding insert " << key << std::endl;
+                ++failures;
+            }
+        }
+        for(unsigned i = 0; i < n; ++i)
+        {
+            std::string key = make_key(t, i);
+            std::string value;
+            if (!acc.find(i % 8, key.data(), key.size(),
+                        [&](const solist_blob& blob){ value.assign(blob.value(), blob.value_len); })
+                    || value != make_value(key, round))
+            {
+                std::cout << "Failed! colliding find " << key << std::endl;
+                ++failures;
+            }
+            if (round < num_rounds && !acc.erase(i % 8, key.data(), key.size()))
+            {
+                std::cout << "Failed! colliding erase " << key << std::endl;
+                ++failures;
+            }
+        }
+    }
+}
+
+void test_concurrent_collision()
+{
+    auto table = std::make_shared<solist<solist_blob>>(2, 4, benedias::concurrent::solist_bucket_hints);
+    std::vector<std::thread> threads;
+    for(unsigned t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back(collision_worker, table, t);
+    }
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+    if (table->item_count() != num_threads * 200)
+    {
+        std::cout << "Failed! colliding item count " << table->item_count() << std::endl;
+        ++failures;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    std::cout << "node header " << sizeof(solist_node<solist_blob>)
+        << ", block for an 8 byte key and 24 byte value "
+        << solist_slab::block_size(solist_node<solist_blob>::alloc_size(8, 24)) << std::endl;
+
+    test_collision();
+    test_concurrent_collision();
+    auto table = std::make_shared<solist<solist_blob>>(2);
+    std::vector<std::thread> threads;
+    for(unsigned t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back(worker, table, t);
+    }
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+    if (table->item_count() != num_threads * num_keys)
+    {
+        std::cout << "Failed! item count " << table->item_count() << std::endl;
+        ++failures;
+    }
+    std::cout << "items " << table->item_count() << " buckets " << table->buckets.size() << std::endl;
+
+    if (0 != failures)
+    {
+        return EXIT_FAILURE;
+    }
+    std::cout << "All Done. " << std::endl;
+    return 0;
+}
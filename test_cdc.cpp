@@ -0,0 +1,222 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the change data capture feed, writers insert, delete and reinsert
+keys while a consumer drains the feed into a replica, at the end the
+replica must equal the table.
+With the argument bench, also times inserts with and without the feed.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::solist_cdc;
+using   benedias::concurrent::solist_cdc_record;
+using   benedias::concurrent::solist_cdc_feed;
+using   benedias::concurrent::solist_cdc_insert;
+using   benedias::concurrent::solist_cdc_update;
+using   benedias::concurrent::solist_cdc_delete;
+using   benedias::concurrent::hash_t;
+
+constexpr unsigned num_writers = 4;
+constexpr unsigned num_keys = 2000;
+constexpr unsigned num_rounds = 3;
+
+// Keys of writer w are w, w + num_writers, ...
+void writer(std::shared_ptr<solist<uint64_t>> table, unsigned w)
+{
+    solist_accessor<uint64_t> acc(table);
+    for(unsigned i = 0; i < num_keys; ++i)
+    {
+        hash_t k = i * num_writers + w;
+        check(acc.insert_node(k, uint64_t(k) << 8), "insert", k);
+    }
+    for(unsigned round = 1; round <= num_rounds; ++round)
+    {
+        for(unsigned i = round & 1; i < num_keys - num_rounds; i += 2)
+        {
+            hash_t k = i * num_writers + w;
+            check(acc.delete_node(k), "delete", k);
+            check(acc.insert_node(k, (uint64_t(k) << 8) | round), "reinsert", k);
+        }
+        // Deleted for good.
+        hash_t k = (num_keys - round) * num_writers + w;
+        acc.delete_node(k);
+    }
+}
+
+// Applies the records to the replica, within a drain records must be in
+// sequence order.
+std::size_t apply(solist_cdc<uint64_t>& feed, std::map<hash_t, uint64_t>& replica)
+{
+    bool first = true;
+    uint64_t last = 0;
+    return feed.drain([&](const solist_cdc_record<uint64_t>& rec){
+            check(first || rec.seq > last, "sequence order", rec.seq);
+            first = false;
+            last = rec.seq;
+            switch(rec.op)
+            {
+                case solist_cdc_insert:
+                    check(replica.count(rec.hashv) == 0, "replica insert", rec.hashv);
+                    replica[rec.hashv] = rec.payload;
+                    break;
+                case solist_cdc_update:
+                    check(replica.count(rec.hashv) == 1, "replica update", rec.hashv);
+                    replica[rec.hashv] = rec.payload;
+                    break;
+                case solist_cdc_delete:
+                    check(replica.erase(rec.hashv) == 1, "replica delete", rec.hashv);
+                    break;
+            }
+        });
+}
+
+void test_replica()
+{
+    auto table = std::make_shared<solist<uint64_t>>(2, 4, solist_cdc_feed);
+    // Rings large enough for every record, so none are lost however slow
+    // the consumer is.
+    table->set_change_feed(std::make_shared<solist_cdc<uint64_t>>(1u << 15));
+    std::map<hash_t, uint64_t> replica;
+    std::atomic<bool> done{false};
+    std::size_t drained = 0;
+    std::size_t drains = 0;
+    std::thread consumer([&](){
+            while(!done.load())
+            {
+                drained += apply(*table->change_feed(), replica);
+                ++drains;
+            }
+        });
+    std::vector<std::thread> writers;
+    for(unsigned w = 0; w < num_writers; ++w)
+    {
+        writers.emplace_back(writer, table, w);
+    }
+    for(auto& w : writers)
+    {
+        w.join();
+    }
+    done.store(true);
+    consumer.join();
+    drained += apply(*table->change_feed(), replica);
+
+    check(0 == table->change_feed()->lost(), "lost records", table->change_feed()->lost());
+    check(replica.size() == table->item_count(), "replica size", replica.size());
+    solist_accessor<uint64_t> acc(table);
+    for(auto& kv : replica)
+    {
+        uint64_t* v = acc.find_item_node(kv.first);
+        check(nullptr != v && *v == kv.second, "replica value", kv.first);
+    }
+    std::cout << "records " << drained << " drains " << drains
+        << " items " << table->item_count() << std::endl;
+}
+
+void test_lost()
+{
+    auto table = std::make_shared<solist<uint64_t>>(2, 4, solist_cdc_feed);
+    table->set_change_feed(std::make_shared<solist_cdc<uint64_t>>(16));
+    solist_accessor<uint64_t> acc(table);
+    for(hash_t k = 0; k < 100; ++k)
+    {
+        acc.insert_node(k, k);
+    }
+    std::map<hash_t, uint64_t> replica;
+    check(16 == apply(*table->change_feed(), replica), "drain full ring", replica.size());
+    check(84 == table->change_feed()->lost(), "lost count", table->change_feed()->lost());
+    // Space again once drained.
+    acc.delete_node(0);
+    check(1 == apply(*table->change_feed(), replica) && 0 == replica.count(0), "drain after full", 0);
+    check(84 == table->change_feed()->lost(), "lost count", table->change_feed()->lost());
+}
+
+// Rings of exited producer threads are dropped once drained, the rings
+// of destroyed feeds are dropped by the producer thread.
+void test_thread_exit()
+{
+    auto table = std::make_shared<solist<uint64_t>>(2, 4, solist_cdc_feed);
+    std::map<hash_t, uint64_t> replica;
+    for(hash_t w = 0; w < 8; ++w)
+    {
+        std::thread th([table, w]{
+            solist_accessor<uint64_t> acc(table);
+            acc.insert_node(w, w);
+        });
+        th.join();
+    }
+    check(8 == table->change_feed()->producers(), "rings before drain", table->change_feed()->producers());
+    check(8 == apply(*table->change_feed(), replica), "drain exited threads", replica.size());
+    check(0 == table->change_feed()->producers(), "rings after drain", table->change_feed()->producers());
+
+    // Each new feed drops the ring of the previous one, destroyed.
+    for(unsigned n = 0; n < 4; ++n)
+    {
+        solist_cdc<uint64_t> feed(16);
+        feed.append_insert(n, n);
+        check(1 == feed.producers(), "feed rings", feed.producers());
+    }
+}
+
+double time_inserts(unsigned options, unsigned n)
+{
+    auto table = std::make_shared<solist<uint64_t>>(2, 4, options);
+    solist_accessor<uint64_t> acc(table);
+    auto start = std::chrono::steady_clock::now();
+    for(hash_t k = 0; k < n; ++k)
+    {
+        acc.insert_node(k * 2654435761u, k);
+        if (options && 0 == (k & 1023))
+        {
+            table->change_feed()->drain([](const solist_cdc_record<uint64_t>&){});
+        }
+    }
+    return seconds_since(start);
+}
+
+void bench()
+{
+    constexpr unsigned n = 500000;
+    double tp = time_inserts(0, n);
+    double tc = time_inserts(solist_cdc_feed, n);
+    printf("%u inserts: %.3fs, with the feed %.3fs\n", n, tp, tc);
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    test_replica();
+    test_lost();
+    test_thread_exit();
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+    return test_result();
+}
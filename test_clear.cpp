@@ -0,0 +1,187 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of clear, readers look up keys and a writer inserts keys while the
+table is cleared repeatedly, then the table must be empty, with its
+buckets intact and usable.
+With the argument bench, also times clear against deleting the keys one by one.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::solist_bucket;
+using   benedias::concurrent::solist_bucket_hints;
+using   benedias::concurrent::solist_bucket_filters;
+using   benedias::concurrent::hash_t;
+using   benedias::concurrent::so_key;
+
+constexpr unsigned num_readers = 2;
+constexpr unsigned num_keys = 5000;
+constexpr unsigned num_clears = 20;
+
+void reader(std::shared_ptr<solist<uint64_t>> table, std::atomic<bool>& done)
+{
+    solist_accessor<uint64_t> acc(table);
+    acc.enable_hot_cache();
+    while(!done.load())
+    {
+        for(hash_t k = 0; k < num_keys; k += 7)
+        {
+            uint64_t* v = acc.find_item_node(k);
+            check(nullptr == v || *v == k, "reader value", k);
+        }
+    }
+}
+
+void writer(std::shared_ptr<solist<uint64_t>> table, std::atomic<bool>& done)
+{
+    solist_accessor<uint64_t> acc(table);
+    while(!done.load())
+    {
+        for(hash_t k = 0; k < num_keys; ++k)
+        {
+            acc.insert_node(k, k);
+        }
+    }
+}
+
+// \@return the number of bucket nodes, keys must be in order.
+unsigned check_list(solist<uint64_t>& table)
+{
+    unsigned sentinels = 0;
+    unsigned items = 0;
+    bool first = true;
+    so_key last = 0;
+    for(solist_bucket* n = table.buckets[0]; nullptr != n; n = n->next.load())
+    {
+        check(first || n->key > last, "key order", n->key);
+        first = false;
+        last = n->key;
+        n->is_node() ? ++items : ++sentinels;
+    }
+    check(items == table.item_count(), "item count", items);
+    return sentinels;
+}
+
+void test_concurrent()
+{
+    auto table = std::make_shared<solist<uint64_t>>(2, 4, solist_bucket_hints | solist_bucket_filters);
+    solist_accessor<uint64_t> acc(table);
+    std::atomic<bool> done{false};
+    std::atomic<bool> writing{false};
+    std::vector<std::thread> threads;
+    for(unsigned r = 0; r < num_readers; ++r)
+    {
+        threads.emplace_back(reader, table, std::ref(done));
+    }
+    std::size_t cleared = 0;
+    for(unsigned c = 0; c < num_clears; ++c)
+    {
+        for(hash_t k = 0; k < num_keys; ++k)
+        {
+            acc.insert_node(k, k);
+        }
+        if (c == num_clears / 2)
+        {
+            threads.emplace_back(writer, table, std::ref(writing));
+        }
+        cleared += acc.clear();
+    }
+    writing.store(true);
+    threads.back().join();
+    threads.pop_back();
+    uint32_t buckets = table->buckets.size();
+    unsigned sentinels = check_list(*table);
+    cleared += acc.clear();
+    done.store(true);
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+
+    check(0 == table->item_count(), "item count after clear", table->item_count());
+    check(sentinels == check_list(*table), "bucket nodes kept", sentinels);
+    check(buckets == table->buckets.size(), "directory kept", buckets);
+    for(hash_t k = 0; k < num_keys; ++k)
+    {
+        check(nullptr == acc.find_item_node(k), "found after clear", k);
+    }
+    for(hash_t k = 0; k < num_keys; ++k)
+    {
+        check(acc.insert_node(k, k), "insert after clear", k);
+    }
+    check(num_keys == table->item_count(), "item count after reinsert", table->item_count());
+    std::cout << "cleared " << cleared << " items, buckets " << buckets << std::endl;
+}
+
+void bench()
+{
+    constexpr unsigned nkeys = 1000000;
+    solist_accessor<uint64_t> acc(std::make_shared<solist<uint64_t>>(2, 4));
+    // Keys are deleted in a different order from the insertion order,
+    // as they would be by a caller emptying the table.
+    std::vector<hash_t> keys(nkeys);
+    for(hash_t k = 0; k < nkeys; ++k)
+    {
+        keys[k] = k;
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+    for(hash_t k = 0; k < nkeys; ++k)
+    {
+        acc.insert_node(k, k);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for(hash_t k : keys)
+    {
+        acc.delete_node(k);
+    }
+    std::chrono::duration<double> tdel = std::chrono::steady_clock::now() - start;
+    for(hash_t k = 0; k < nkeys; ++k)
+    {
+        acc.insert_node(k, k);
+    }
+    start = std::chrono::steady_clock::now();
+    std::size_t n = acc.clear();
+    std::chrono::duration<double> tclear = std::chrono::steady_clock::now() - start;
+    check(nkeys == n, "clear count", n);
+    printf("%u items: delete_node %.3fs, clear %.3fs\n", nkeys, tdel.count(), tclear.count());
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    test_concurrent();
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+
+    return test_result();
+}
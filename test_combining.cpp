@@ -0,0 +1,234 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of flat combining of hot buckets, threads insert and delete keys of
+one bucket, which is switched to combining, the table is then checked,
+and the bucket must switch back once a single thread uses it.
+The status of an operation applied by another thread's combiner must be
+reported by the poster's accessor.
+With the argument bench, also times the workload with and without combining.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::solist_bucket;
+using   benedias::concurrent::solist_combiner;
+using   benedias::concurrent::solist_flat_combining;
+using   benedias::concurrent::hash_t;
+using   benedias::concurrent::hazptr_backpressure;
+using   benedias::concurrent::hazptr_context;
+using   benedias::concurrent::hazptr_domain;
+using   benedias::concurrent::hazptr_reclaimer;
+using   benedias::concurrent::hazptr_status;
+using   benedias::concurrent::so_key;
+
+constexpr unsigned num_keys = 16;
+// Hash values of multiples of 2^16 fall in bucket 0.
+constexpr unsigned key_shift = 16;
+
+inline hash_t key_of(unsigned t, unsigned i)
+{
+    return (i * 64 + t) << key_shift;
+}
+
+void worker(std::shared_ptr<solist<uint64_t>> table, unsigned t, unsigned rounds)
+{
+    solist_accessor<uint64_t> acc(table);
+    for(unsigned round = 0; round < rounds; ++round)
+    {
+        for(unsigned i = 0; i < num_keys; ++i)
+        {
+            check(acc.insert_node(key_of(t, i), i), "insert", key_of(t, i));
+            check(!acc.insert_node(key_of(t, i), i), "duplicate insert", key_of(t, i));
+        }
+        for(unsigned i = 0; i < num_keys; ++i)
+        {
+            // The last round leaves the odd keys.
+            if (round + 1 < rounds || 0 == (i & 1))
+            {
+                check(acc.delete_node(key_of(t, i)), "delete", key_of(t, i));
+            }
+        }
+    }
+}
+
+void check_table(std::shared_ptr<solist<uint64_t>> table, unsigned nthreads)
+{
+    solist_accessor<uint64_t> acc(table);
+    for(unsigned t = 0; t < nthreads; ++t)
+    {
+        for(unsigned i = 0; i < num_keys; ++i)
+        {
+            uint64_t* v = acc.find_item_node(key_of(t, i));
+            check((0 == (i & 1)) == (nullptr == v), "find", key_of(t, i));
+            check(nullptr == v || *v == i, "value", key_of(t, i));
+        }
+    }
+    bool first = true;
+    so_key last = 0;
+    for(solist_bucket* n = table->buckets[0]; nullptr != n; n = n->next.load())
+    {
+        check(first || n->key > last, "key order", n->key);
+        first = false;
+        last = n->key;
+    }
+    check(table->item_count() == nthreads * num_keys / 2, "item count", table->item_count());
+}
+
+double run(std::shared_ptr<solist<uint64_t>> table, unsigned nthreads, unsigned rounds)
+{
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned t = 0; t < nthreads; ++t)
+    {
+        threads.emplace_back(worker, table, t, rounds);
+    }
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    check_table(table, nthreads);
+    return elapsed.count();
+}
+
+void test_switching()
+{
+    constexpr unsigned nthreads = 16;
+    constexpr unsigned rounds = 40;
+    auto table = std::make_shared<solist<uint64_t>>(2, 4, solist_flat_combining);
+    // Combining until the end of the run.
+    table->set_flat_combiner(new solist_combiner(4, std::chrono::seconds(10), 1u << 30));
+    solist_combiner* fc = table->flat_combiner();
+    check(!fc->active(0), "initially combining", 0);
+    fc->contended(0, 1);
+    fc->contended(0, 4);
+    check(fc->active(0) && !fc->active(1) && 1 == fc->switches(), "switch to combining", 0);
+
+    run(table, nthreads, rounds);
+    // The last round deletes half the keys.
+    check(nthreads * (rounds * num_keys * 3 - num_keys / 2) == fc->combined(), "combined operations", fc->combined());
+
+    // A single thread, batches of one switch the bucket back.
+    table->set_flat_combiner(new solist_combiner(4, std::chrono::seconds(10), 32));
+    fc = table->flat_combiner();
+    fc->contended(0, 1);
+    fc->contended(0, 4);
+    solist_accessor<uint64_t> acc(table);
+    for(unsigned i = 0; i < 32; ++i)
+    {
+        check(fc->active(0), "switched back early", i);
+        check(acc.insert_node(key_of(63, i), i), "insert", key_of(63, i));
+    }
+    check(!fc->active(0), "switch back", fc->switches());
+    check(acc.delete_node(key_of(63, 0)) && nullptr == acc.find_item_node(key_of(63, 0)),
+            "direct delete", key_of(63, 0));
+    check(32 == fc->combined(), "combined operations", fc->combined());
+}
+
+// Posters wait while the channel is locked, so one of them combines the
+// operations of both, the domain is over its limit, both inserts must
+// fail with the over_limit status.
+void test_status()
+{
+    auto dom = hazptr_domain::make();
+    auto table = std::make_shared<solist<uint64_t>>(2, 4, solist_flat_combining, dom);
+    table->set_flat_combiner(new solist_combiner(1, std::chrono::seconds(10), 1u << 30));
+    solist_combiner* fc = table->flat_combiner();
+    fc->contended(0, 1);
+    fc->contended(0, 1);
+    check(fc->active(0), "combining", 0);
+
+    // Two objects pending reclamation, held by hazard pointers.
+    auto& hpc = hazptr_context<2, 1>::local(dom);
+    uint64_t* held[2] = {new uint64_t(0), new uint64_t(1)};
+    for(unsigned i = 0; i < 2; ++i)
+    {
+        hpc.store(i, held[i]);
+        dom->enqueue_for_delete(held[i], hazptr_reclaimer<uint64_t>::instance());
+    }
+    dom->set_pending_limit(1, 0, hazptr_backpressure::fail);
+
+    check(fc->try_lock(0), "lock channel", 0);
+    hazptr_status status[2] = {hazptr_status::ok, hazptr_status::ok};
+    bool result[2] = {true, true};
+    std::vector<std::thread> posters;
+    for(unsigned t = 0; t < 2; ++t)
+    {
+        posters.emplace_back([&, t]{
+            solist_accessor<uint64_t> acc(table);
+            result[t] = acc.insert_node(key_of(t, 0), t);
+            status[t] = acc.status();
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    fc->unlock(0);
+    for(auto& t : posters)
+    {
+        t.join();
+    }
+    for(unsigned t = 0; t < 2; ++t)
+    {
+        check(!result[t], "insert over limit", t);
+        check(hazptr_status::over_limit == status[t], "poster status", t);
+    }
+    hpc.clear();
+    dom->set_pending_limit(0, 0);
+    dom->collect();
+    check(0 == dom->pending_objects(), "pending after collect", dom->pending_objects());
+}
+
+void bench()
+{
+    constexpr unsigned nthreads = 64;
+    constexpr unsigned rounds = 8;
+    auto plain = std::make_shared<solist<uint64_t>>(2, 4);
+    auto combined = std::make_shared<solist<uint64_t>>(2, 4, solist_flat_combining);
+    auto forced = std::make_shared<solist<uint64_t>>(2, 4, solist_flat_combining);
+    forced->set_flat_combiner(new solist_combiner(1, std::chrono::seconds(10), 1u << 30));
+    forced->flat_combiner()->contended(0, 1);
+    forced->flat_combiner()->contended(0, 1);
+    double tp = run(plain, nthreads, rounds);
+    double tc = run(combined, nthreads, rounds);
+    double tf = run(forced, nthreads, rounds);
+    printf("%u threads, %u operations each: %.3fs, with flat combining %.3fs, %lu combined,"
+            " always combined %.3fs\n",
+            nthreads, rounds * num_keys * 3 - num_keys / 2, tp, tc, combined->flat_combiner()->combined(), tf);
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    test_switching();
+    test_status();
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+    return test_result();
+}
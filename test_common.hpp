@@ -0,0 +1,75 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Checks and timing shared by the test programs.
+*/
+
+#ifndef BENEDIAS_TEST_COMMON_HPP
+#define BENEDIAS_TEST_COMMON_HPP
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+/// Number of failed checks, from all threads.
+inline std::atomic<unsigned> failures{0};
+
+inline void check(bool ok, const char* what, uint64_t v)
+{
+    if (!ok)
+    {
+        std::cout << "Failed! " << what << " " << v << std::endl;
+        ++failures;
+    }
+}
+
+/// Timing benchmarks are not part of the pass/fail tests, they are run
+/// when the program is started with the argument "bench".
+inline bool bench_requested(int argc, char* argv[])
+{
+    for(int n = 1; n < argc; ++n)
+    {
+        if (0 == strcmp(argv[n], "bench"))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Seconds elapsed since start.
+inline double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/// The exit status of a test program, "All Done." is printed if all
+/// checks passed.
+inline int test_result()
+{
+    if (0 != failures)
+    {
+        return EXIT_FAILURE;
+    }
+    std::cout << "All Done. " << std::endl;
+    return 0;
+}
+
+#endif // #define BENEDIAS_TEST_COMMON_HPP
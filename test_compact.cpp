@@ -0,0 +1,154 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the index linked solist, threads concurrently insert, find and
+delete on disjoint ranges of keys, while reader threads look up all keys.
+Deleted nodes are recycled, so the arena should not grow much beyond
+the number of live items.
+*/
+#include "solist_compact.hpp"
+#include <atomic>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist_compact;
+using   benedias::concurrent::solist_compact_accessor;
+using   benedias::concurrent::solist_index_node;
+using   benedias::concurrent::solist_node;
+using   benedias::concurrent::hash_t;
+
+constexpr unsigned num_threads = 4;
+constexpr unsigned num_readers = 2;
+constexpr unsigned num_keys = 2000;
+constexpr unsigned num_rounds = 4;
+
+std::atomic<unsigned> failures{0};
+
+void writer(std::shared_ptr<solist_compact<uint64_t>> table, unsigned index)
+{
+    solist_compact_accessor<uint64_t> acc(table);
+    hash_t base = index * num_keys;
+    uint64_t v;
+
+    for(hash_t k = base; k < base + num_keys; ++k)
+    {
+        if (!acc.insert_node(k, uint64_t(k) << 8))
+        {
+            std::cout << "Failed! insert " << k << std::endl;
+            ++failures;
+        }
+    }
+    for(uint32_t round = 1; round <= num_rounds; ++round)
+    {
+        for(hash_t k = base + 1; k < base + num_keys; k += 2)
+        {
+            if (!acc.delete_node(k) || acc.find_item(k, &v))
+            {
+                std::cout << "Failed! delete " << k << std::endl;
+                ++failures;
+            }
+            if (!acc.insert_node(k, (uint64_t(k) << 8) | round))
+            {
+                std::cout << "Failed! reinsert " << k << std::endl;
+                ++failures;
+            }
+        }
+    }
+    for(hash_t k = base; k < base + num_keys; ++k)
+    {
+        uint64_t expected = (uint64_t(k) << 8) | ((k & 1) ? num_rounds : 0);
+        if (!acc.find_item(k, &v) || v != expected)
+        {
+            std::cout << "Failed! find " << k << std::endl;
+            ++failures;
+        }
+    }
+}
+
+void reader(std::shared_ptr<solist_compact<uint64_t>> table, std::atomic<bool>& done)
+{
+    solist_compact_accessor<uint64_t> acc(table);
+    uint64_t v;
+    while(!done.load())
+    {
+        for(hash_t k = 0; k < num_threads * num_keys; k += 7)
+        {
+            if (acc.find_item(k, &v) && (v >> 8) != k)
+            {
+                std::cout << "Failed! reader " << k << " " << v << std::endl;
+                ++failures;
+            }
+        }
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    std::cout << "node size " << sizeof(solist_index_node<uint64_t>)
+        << " (pointer linked " << sizeof(solist_node<uint64_t>) << "), directory entry "
+        << sizeof(std::atomic<uint32_t>) << " (pointer linked " << sizeof(void*) << ")" << std::endl;
+
+    auto table = std::make_shared<solist_compact<uint64_t>>(2);
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+    std::vector<std::thread> readers;
+    for(unsigned r = 0; r < num_readers; ++r)
+    {
+        readers.emplace_back(reader, table, std::ref(done));
+    }
+    for(unsigned t = 0; t < num_threads; ++t)
+    {
+        writers.emplace_back(writer, table, t);
+    }
+    for(auto& th : writers)
+    {
+        th.join();
+    }
+    done.store(true);
+    for(auto& th : readers)
+    {
+        th.join();
+    }
+
+    if (table->item_count() != num_threads * num_keys)
+    {
+        std::cout << "Failed! item count " << table->item_count() << std::endl;
+        ++failures;
+    }
+    // Live items, sentinels and nodes retired by accessors at the time,
+    // without recycling the arena would hold every node ever inserted.
+    unsigned inserted = num_threads * num_keys * (num_rounds + 2) / 2;
+    if (table->arena_size() >= inserted)
+    {
+        std::cout << "Failed! arena size " << table->arena_size() << " not recycled" << std::endl;
+        ++failures;
+    }
+    std::cout << "items " << table->item_count() << " buckets " << table->bucket_count()
+        << " arena " << table->arena_size() << " nodes, " << inserted << " inserted" << std::endl;
+    if (0 != failures)
+    {
+        return EXIT_FAILURE;
+    }
+    std::cout << "All Done. " << std::endl;
+    return 0;
+}
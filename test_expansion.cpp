@@ -24,6 +24,8 @@ along with sqzbsrv.  If not, see <http://www.gnu.org/licenses/>.
 #include <ctime>
 #include <iostream>
 #include <memory>
+#include <thread>
+#include <vector>
 
 using   benedias::concurrent::solist;
 using   benedias::concurrent::solist_accessor;
@@ -94,12 +96,59 @@ void test_expansion()
     benedias::concurrent::check_solist(sol);
 }
 
+// test concurrent insertion and deletion, with expansion of the directory.
+void test_concurrent_expansion()
+{
+    constexpr unsigned num_threads = 8;
+    constexpr unsigned num_values = 4000;
+    auto sl = std::make_shared<solist<uint32_t>>(2);
+    std::vector<std::thread> threads;
+
+    for (unsigned t=0; t < num_threads; ++t)
+    {
+        threads.emplace_back([sl, t]{
+            solist_accessor<uint32_t> sol(sl);
+            for (uint32_t v = t; v < num_values; v += num_threads)
+            {
+                if (!sol.insert_node(v, v))
+                {
+                    std::cout << "Failed! insert " << v << std::endl;
+                }
+            }
+            for (uint32_t v = t; v < num_values; v += num_threads * 2)
+            {
+                if (!sol.delete_node(v))
+                {
+                    std::cout << "Failed! delete " << v << std::endl;
+                }
+            }
+        });
+    }
+    for (auto& th: threads)
+    {
+        th.join();
+    }
+
+    solist_accessor<uint32_t> sol(sl);
+    for (uint32_t v = 0; v < num_values; ++v)
+    {
+        bool deleted = (v % (num_threads * 2)) < num_threads;
+        uint32_t* p = sol.find_item_node(v);
+        if (deleted != (nullptr == p))
+        {
+            std::cout << "Failed! find " << v << std::endl;
+        }
+    }
+    std::cout << "n_buckets=" << sl->buckets.size() << " n_items=" << sl->item_count() << std::endl;
+    benedias::concurrent::check_solist(sol);
+}
 
 int main( int argc, char* argv[] )
 {
     std::setlocale(LC_ALL, "en_US.UTF-8");
     std::srand(std::time(nullptr)); // use current time as seed for random generator
     test_expansion();
+    test_concurrent_expansion();
     std::cout << "All Done. " << std::endl;
     return 0;
 }
@@ -0,0 +1,170 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the per bucket Bloom filters, writers insert keys while the
+table expands from 2 buckets, each writer publishes the number of keys
+it has inserted, readers must find every published key, a filter must
+never report a present key as absent.
+With the argument bench, also times lookups of absent keys with and without filters.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::hash_t;
+using   benedias::concurrent::solist_bucket_filters;
+
+constexpr unsigned num_writers = 4;
+constexpr unsigned num_readers = 2;
+constexpr unsigned num_keys = 20000;
+
+std::atomic<unsigned> published[num_writers];
+
+inline hash_t key_of(unsigned w, unsigned i)
+{
+    // spread keys, including hash values with the top bit set.
+    return (i * num_writers + w) * 2654435761u;
+}
+
+void writer(std::shared_ptr<solist<uint32_t>> table, unsigned w)
+{
+    solist_accessor<uint32_t> acc(table);
+    for(unsigned i = 0; i < num_keys; ++i)
+    {
+        if (!acc.insert_node(key_of(w, i), i))
+        {
+            std::cout << "Failed! insert " << key_of(w, i) << std::endl;
+            ++failures;
+        }
+        published[w].store(i + 1, std::memory_order_release);
+    }
+}
+
+void reader(std::shared_ptr<solist<uint32_t>> table)
+{
+    solist_accessor<uint32_t> acc(table);
+    unsigned done = 0;
+    while(done < num_writers)
+    {
+        done = 0;
+        for(unsigned w = 0; w < num_writers; ++w)
+        {
+            unsigned n = published[w].load(std::memory_order_acquire);
+            done += (n == num_keys);
+            // the most recently published keys, inserted during expansion.
+            for(unsigned i = n > 64 ? n - 64 : 0; i < n; ++i)
+            {
+                uint32_t* v = acc.find_item_node(key_of(w, i));
+                if (nullptr == v || *v != i)
+                {
+                    std::cout << "Failed! find " << key_of(w, i) << std::endl;
+                    ++failures;
+                }
+            }
+        }
+    }
+}
+
+// Bijective, so even and odd x never collide, and spread over all buckets.
+inline hash_t mix(hash_t x)
+{
+    x *= 2654435761u;
+    return x ^ (x >> 16);
+}
+
+double time_misses(solist_accessor<uint32_t>& acc, unsigned n, unsigned& hits)
+{
+    auto start = std::chrono::steady_clock::now();
+    hits = 0;
+    for(unsigned i = 0; i < n; ++i)
+    {
+        // odd values are never inserted.
+        hits += nullptr != acc.find_item_node(mix(2 * i + 1));
+    }
+    return seconds_since(start);
+}
+
+void bench()
+{
+    constexpr unsigned n = 1000000;
+    constexpr unsigned bucket_length = 16;
+    solist_accessor<uint32_t> plain(std::make_shared<solist<uint32_t>>(2, bucket_length));
+    solist_accessor<uint32_t> filtered(std::make_shared<solist<uint32_t>>(2, bucket_length, solist_bucket_filters));
+    for(unsigned i = 0; i < 100000; ++i)
+    {
+        plain.insert_node(mix(2 * i), i);
+        filtered.insert_node(mix(2 * i), i);
+    }
+    unsigned hits;
+    double tp = time_misses(plain, n, hits);
+    double tf = time_misses(filtered, n, hits);
+    printf("%u absent key lookups: %.3fs, with bucket filters %.3fs\n", n, tp, tf);
+    if (0 != hits)
+    {
+        std::cout << "Failed! absent keys found " << hits << std::endl;
+        ++failures;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    auto table = std::make_shared<solist<uint32_t>>(2, 4, solist_bucket_filters);
+    std::vector<std::thread> threads;
+    for(unsigned r = 0; r < num_readers; ++r)
+    {
+        threads.emplace_back(reader, table);
+    }
+    for(unsigned w = 0; w < num_writers; ++w)
+    {
+        threads.emplace_back(writer, table, w);
+    }
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+    solist_accessor<uint32_t> acc(table);
+    for(unsigned w = 0; w < num_writers; ++w)
+    {
+        for(unsigned i = 0; i < num_keys; ++i)
+        {
+            uint32_t* v = acc.find_item_node(key_of(w, i));
+            if (nullptr == v || *v != i)
+            {
+                std::cout << "Failed! final find " << key_of(w, i) << std::endl;
+                ++failures;
+            }
+        }
+    }
+    std::cout << "items " << table->item_count() << " buckets " << table->buckets.size() << std::endl;
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+
+    return test_result();
+}
@@ -0,0 +1,162 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the fixed capacity solist, threads concurrently insert, find
+and delete, then the list is checked, keys must be in order and every
+bucket node must be in its slot.
+With the argument bench, also times lookups against a solist of the same number of buckets.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::solist_fixed;
+using   benedias::concurrent::solist_fixed_accessor;
+using   benedias::concurrent::solist_bucket;
+using   benedias::concurrent::hash_t;
+using   benedias::concurrent::so_key;
+
+constexpr unsigned num_threads = 4;
+constexpr unsigned num_keys = 5000;
+constexpr unsigned num_rounds = 3;
+constexpr uint32_t num_buckets = 4096;
+
+using fixed_table = solist_fixed<uint64_t, num_buckets>;
+using fixed_accessor = solist_fixed_accessor<uint64_t, num_buckets>;
+
+// Keys of thread t are t, t + num_threads, ... spread by a multiplier.
+inline hash_t key_of(unsigned t, unsigned i)
+{
+    return (i * num_threads + t) * 2654435761u;
+}
+
+void worker(std::shared_ptr<fixed_table> table, unsigned t)
+{
+    fixed_accessor acc(table);
+    for(unsigned i = 0; i < num_keys; ++i)
+    {
+        check(acc.insert_node(key_of(t, i), i), "insert", key_of(t, i));
+    }
+    for(unsigned round = 1; round <= num_rounds; ++round)
+    {
+        for(unsigned i = round & 1; i < num_keys; i += 2)
+        {
+            hash_t k = key_of(t, i);
+            check(acc.delete_node(k), "delete", k);
+            check(nullptr == acc.find_item_node(k), "found deleted", k);
+            check(acc.insert_node(k, i + round * num_keys), "reinsert", k);
+        }
+    }
+    for(unsigned i = 0; i < num_keys; ++i)
+    {
+        uint64_t* v = acc.find_item_node(key_of(t, i));
+        // the last round to reinsert i.
+        uint64_t expected = i + (((i & 1) == (num_rounds & 1)) ? num_rounds : num_rounds - 1) * num_keys;
+        check(nullptr != v && *v == expected, "find", key_of(t, i));
+    }
+}
+
+void check_list(fixed_table& table)
+{
+    unsigned items = 0;
+    unsigned sentinels = 0;
+    bool first = true;
+    so_key last = 0;
+    for(solist_bucket* n = table.buckets[0]; nullptr != n; n = n->next.load())
+    {
+        check(first || n->key > last, "key order", n->key);
+        first = false;
+        last = n->key;
+        if (n->is_node())
+        {
+            ++items;
+        }
+        else
+        {
+            ++sentinels;
+            check(table.buckets[n->hashv()] == n, "sentinel slot", n->hashv());
+        }
+    }
+    check(sentinels == num_buckets, "sentinels", sentinels);
+    check(items == table.item_count(), "item count", items);
+    std::cout << "items " << items << " buckets " << sentinels << std::endl;
+}
+
+template <typename A> double time_lookups(A& acc, unsigned n)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for(unsigned i = 0; i < n; ++i)
+    {
+        uint64_t* v = acc.find_item_node(key_of(i % num_threads, (i / num_threads) % num_keys));
+        sum += nullptr == v ? 0 : *v;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    check(0 != sum, "lookups", 0);
+    return elapsed.count();
+}
+
+void bench()
+{
+    constexpr unsigned n = 2000000;
+    fixed_accessor fixed(std::make_shared<fixed_table>(num_buckets));
+    solist_accessor<uint64_t> plain(std::make_shared<solist<uint64_t>>(num_buckets, 8));
+    for(unsigned t = 0; t < num_threads; ++t)
+    {
+        for(unsigned i = 0; i < num_keys; ++i)
+        {
+            fixed.insert_node(key_of(t, i), i + 1);
+            plain.insert_node(key_of(t, i), i + 1);
+        }
+    }
+    double tp = time_lookups(plain, n);
+    double tf = time_lookups(fixed, n);
+    printf("%u lookups, %u buckets: solist %.3fs, solist_fixed %.3fs\n", n, num_buckets, tp, tf);
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    auto table = std::make_shared<fixed_table>(num_buckets);
+    std::vector<std::thread> threads;
+    for(unsigned t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back(worker, table, t);
+    }
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+    check(table->item_count() == num_threads * num_keys, "item count", table->item_count());
+    check_list(*table);
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+
+    return test_result();
+}
@@ -0,0 +1,191 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the key hash, 31 bit keys must never collide, seeds must change
+the mapping, and keys which all fall in one bucket when used as hash
+values must be spread by the key aware interface.
+With the argument bench, also times inserts of such keys.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <algorithm>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::solist_bucket;
+using   benedias::concurrent::solist_key_hash;
+using   benedias::concurrent::solist_seeded_hash;
+using   benedias::concurrent::solist_random_seed;
+using   benedias::concurrent::hash_t;
+
+// Distinct keys, in runs and with the low bits clear.
+std::vector<uint32_t> sample_keys()
+{
+    std::vector<uint32_t> keys;
+    for(uint32_t k = 0; k < 200000; ++k)
+    {
+        keys.push_back(k);
+        keys.push_back(0x7fffffff - k);
+        keys.push_back((k << 11) | 0x200000);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+void test_bijection(const solist_key_hash& h, const char* what)
+{
+    std::vector<uint32_t> keys = sample_keys();
+    std::vector<uint32_t> hashes;
+    for(uint32_t k : keys)
+    {
+        uint32_t v = h(k);
+        check(v <= 0x7fffffff, what, k);
+        hashes.push_back(v);
+    }
+    std::sort(hashes.begin(), hashes.end());
+    check(std::adjacent_find(hashes.begin(), hashes.end()) == hashes.end(), what, keys.size());
+}
+
+void test_seeds()
+{
+    solist_key_hash h0;
+    solist_key_hash h1(solist_random_seed());
+    solist_key_hash h2(solist_random_seed());
+    test_bijection(h0, "unseeded collision");
+    test_bijection(h1, "seeded collision");
+    unsigned same = 0;
+    for(uint32_t k = 0; k < 1000; ++k)
+    {
+        same += h1(k) == h2(k);
+        check(h1(k) == solist_key_hash(h1)(k), "copy differs", k);
+    }
+    check(same < 10, "seeds map keys alike", same);
+
+    std::string s = "key-0123456789";
+    check(h1(s.data(), s.size()) != h2(s.data(), s.size()), "seeds hash bytes alike", 0);
+    check(h1(s.data(), s.size()) == h1(s.data(), s.size()), "bytes hash unstable", 0);
+    std::vector<uint32_t> hashes;
+    for(unsigned i = 0; i < 100000; ++i)
+    {
+        std::string key = "user:" + std::to_string(i);
+        uint32_t v = h1(key.data(), key.size()) & 0x7fffffff;
+        hashes.push_back(v);
+    }
+    std::sort(hashes.begin(), hashes.end());
+    unsigned dups = 0;
+    for(std::size_t i = 1; i < hashes.size(); ++i)
+    {
+        dups += hashes[i] == hashes[i - 1];
+    }
+    // About n^2 / 2^32 collisions are expected.
+    check(dups < 20, "bytes hash collisions", dups);
+}
+
+// The longest run of data nodes between two bucket nodes.
+template <typename T> unsigned longest_chain(solist<T>& table)
+{
+    unsigned longest = 0;
+    unsigned length = 0;
+    for(solist_bucket* n = table.buckets[0]; nullptr != n; n = n->next.load())
+    {
+        length = n->is_node() ? length + 1 : 0;
+        longest = std::max(longest, length);
+    }
+    return longest;
+}
+
+void test_spread()
+{
+    constexpr unsigned n = 2048;
+    auto seeded = std::make_shared<solist<uint32_t>>(2, 4, solist_seeded_hash);
+    solist_accessor<uint32_t> sacc(seeded);
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        check(sacc.insert_key(i << 16, i), "insert_key", i);
+    }
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        uint32_t* v = sacc.find_key(i << 16);
+        check(nullptr != v && *v == i, "find_key", i);
+    }
+    check(sacc.delete_key(5 << 16) && nullptr == sacc.find_key(5 << 16), "delete_key", 5);
+    unsigned lseeded = longest_chain(*seeded);
+    check(lseeded < 32, "seeded longest chain", lseeded);
+}
+
+// Keys above MAX_KEY would alias the key without the top bit, they are
+// rejected.
+void test_large_keys()
+{
+    auto table = std::make_shared<solist<uint32_t>>(2, 4, solist_seeded_hash);
+    solist_accessor<uint32_t> acc(table);
+    constexpr uint32_t large = solist_key_hash::MAX_KEY + 6;
+    check(acc.insert_key(5, 5), "insert_key", 5);
+    check(!acc.insert_key(large, 6), "insert large key", large);
+    check(!acc.insert_or_assign_key(large, 6), "assign large key", large);
+    check(nullptr == acc.find_key(large), "find large key", large);
+    check(!acc.delete_key(large), "delete large key", large);
+    uint32_t* v = acc.find_key(5);
+    check(nullptr != v && 5 == *v && 1 == table->item_count(), "aliased key", 5);
+}
+
+void bench()
+{
+    constexpr unsigned n = 2048;
+    // Multiples of 2^16 all fall in bucket 0 of a table with up to 2^16
+    // buckets when used as hash values.
+    auto raw = std::make_shared<solist<uint32_t>>(2, 4);
+    auto seeded = std::make_shared<solist<uint32_t>>(2, 4, solist_seeded_hash);
+    solist_accessor<uint32_t> racc(raw);
+    solist_accessor<uint32_t> sacc(seeded);
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        racc.insert_node(i << 16, i);
+    }
+    double traw = seconds_since(start);
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        sacc.insert_key(i << 16, i);
+    }
+    double tseeded = seconds_since(start);
+    printf("%u keys i << 16: longest chain %u as hash values %.3fs, %u with insert_key %.3fs\n",
+            n, longest_chain(*raw), traw, longest_chain(*seeded), tseeded);
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    test_seeds();
+    test_spread();
+    test_large_keys();
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+    return test_result();
+}
@@ -0,0 +1,159 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the directory first data node hints, writers delete and reinsert
+keys, so the first nodes of buckets are repeatedly retired, while readers
+look up keys starting from the hints, and the table expands.
+With the argument bench, also times lookups with and without hints.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::solist_bucket_hints;
+using   benedias::concurrent::hash_t;
+
+constexpr unsigned num_writers = 4;
+constexpr unsigned num_readers = 2;
+constexpr unsigned num_keys = 4000;
+constexpr unsigned num_rounds = 4;
+
+// Keys of writer w are w, w + num_writers, ...
+void writer(std::shared_ptr<solist<uint64_t>> table, unsigned w)
+{
+    solist_accessor<uint64_t> acc(table);
+    for(unsigned i = 0; i < num_keys; ++i)
+    {
+        hash_t k = i * num_writers + w;
+        check(acc.insert_node(k, uint64_t(k) << 8), "insert", k);
+    }
+    for(unsigned round = 1; round <= num_rounds; ++round)
+    {
+        for(unsigned i = round & 1; i < num_keys; i += 2)
+        {
+            hash_t k = i * num_writers + w;
+            check(acc.delete_node(k), "delete", k);
+            check(nullptr == acc.find_item_node(k), "found deleted", k);
+            check(acc.insert_node(k, (uint64_t(k) << 8) | round), "reinsert", k);
+        }
+    }
+    for(unsigned i = 0; i < num_keys; ++i)
+    {
+        hash_t k = i * num_writers + w;
+        uint64_t* v = acc.find_item_node(k);
+        uint64_t expected = (uint64_t(k) << 8) | ((i & 1) ? num_rounds - 1 : num_rounds);
+        check(nullptr != v && *v == expected, "find", k);
+    }
+}
+
+void reader(std::shared_ptr<solist<uint64_t>> table, std::atomic<bool>& done)
+{
+    solist_accessor<uint64_t> acc(table);
+    while(!done.load())
+    {
+        for(hash_t k = 0; k < num_writers * num_keys; k += 3)
+        {
+            uint64_t* v = acc.find_item_node(k);
+            check(nullptr == v || (*v >> 8) == k, "reader value", k);
+        }
+    }
+}
+
+double time_lookups(solist_accessor<uint64_t>& acc, unsigned n, unsigned nkeys)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    uint32_t x = 1;
+    for(unsigned i = 0; i < n; ++i)
+    {
+        // pseudo random order, so directory and bucket nodes are not cached.
+        x = x * 1664525u + 1013904223u;
+        uint64_t* v = acc.find_item_node((x >> 8) % nkeys);
+        sum += nullptr == v ? 0 : *v;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    check(0 != sum, "lookups", 0);
+    return elapsed.count();
+}
+
+void bench()
+{
+    constexpr unsigned n = 1000000;
+    constexpr unsigned nkeys = 1000000;
+    solist_accessor<uint64_t> plain(std::make_shared<solist<uint64_t>>(2, 4, 0));
+    solist_accessor<uint64_t> hinted(std::make_shared<solist<uint64_t>>(2, 4, solist_bucket_hints));
+    for(hash_t k = 0; k < nkeys; ++k)
+    {
+        plain.insert_node(k, uint64_t(k) << 8);
+        hinted.insert_node(k, uint64_t(k) << 8);
+    }
+    double tp = time_lookups(plain, n, nkeys);
+    double th = time_lookups(hinted, n, nkeys);
+    printf("%u lookups of %u keys: %.3fs, with hints %.3fs\n", n, nkeys, tp, th);
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    auto table = std::make_shared<solist<uint64_t>>(2, 4, solist_bucket_hints);
+    {
+        // keys inserted before the readers start.
+        solist_accessor<uint64_t> acc(table);
+        for(hash_t k = 0; k < 64; ++k)
+        {
+            check(acc.insert_node(k + num_writers * num_keys, 1), "insert", k);
+        }
+    }
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+    std::vector<std::thread> readers;
+    for(unsigned r = 0; r < num_readers; ++r)
+    {
+        readers.emplace_back(reader, table, std::ref(done));
+    }
+    for(unsigned w = 0; w < num_writers; ++w)
+    {
+        writers.emplace_back(writer, table, w);
+    }
+    for(auto& w : writers)
+    {
+        w.join();
+    }
+    done.store(true);
+    for(auto& r : readers)
+    {
+        r.join();
+    }
+    check(table->item_count() == num_writers * num_keys + 64, "item count", table->item_count());
+    std::cout << "items " << table->item_count() << " buckets " << table->buckets.size() << std::endl;
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+
+    return test_result();
+}
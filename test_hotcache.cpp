@@ -0,0 +1,157 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the per thread hot key cache, cached lookups must never return
+deleted items, or items of a destroyed table, readers look up a small
+set of hot keys while a writer deletes and reinserts them.
+With the argument bench, also times lookups of hot keys with and without the cache.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::hash_t;
+
+constexpr unsigned num_readers = 3;
+constexpr unsigned num_hot = 64;
+constexpr unsigned num_keys = 20000;
+constexpr unsigned num_rounds = 200;
+
+void test_invalidation()
+{
+    for(unsigned pass = 0; pass < 2; ++pass)
+    {
+        // A new table may be allocated where the last one was.
+        solist_accessor<uint64_t> acc(4);
+        acc.enable_hot_cache();
+        check(nullptr == acc.find_item_node(5), "empty table hit", 5);
+        acc.insert_node(5, 500 + pass);
+        uint64_t* v = acc.find_item_node(5);
+        check(nullptr != v && *v == 500 + pass, "find", 5);
+        v = acc.find_item_node(5);
+        check(nullptr != v && *v == 500 + pass, "cached find", 5);
+        acc.delete_node(5);
+        check(nullptr == acc.find_item_node(5), "deleted hit", 5);
+        acc.insert_node(5, 600);
+        v = acc.find_item_node(5);
+        check(nullptr != v && *v == 600, "reinserted find", 5);
+    }
+}
+
+void reader(std::shared_ptr<solist<uint64_t>> table, std::atomic<bool>& done)
+{
+    solist_accessor<uint64_t> acc(table);
+    acc.enable_hot_cache();
+    while(!done.load())
+    {
+        for(hash_t k = 0; k < num_hot; ++k)
+        {
+            uint64_t* v = acc.find_item_node(k);
+            if (nullptr != v && (*v >> 8) != k)
+            {
+                check(false, "reader", k);
+            }
+        }
+    }
+}
+
+void test_concurrent()
+{
+    auto table = std::make_shared<solist<uint64_t>>(64);
+    solist_accessor<uint64_t> acc(table);
+    for(hash_t k = 0; k < num_hot; ++k)
+    {
+        acc.insert_node(k, uint64_t(k) << 8);
+    }
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for(unsigned r = 0; r < num_readers; ++r)
+    {
+        readers.emplace_back(reader, table, std::ref(done));
+    }
+    for(unsigned round = 1; round <= num_rounds; ++round)
+    {
+        for(hash_t k = round % 4; k < num_hot; k += 4)
+        {
+            check(acc.delete_node(k), "delete", k);
+            check(acc.insert_node(k, (uint64_t(k) << 8) | (round & 0xff)), "insert", k);
+        }
+    }
+    done.store(true);
+    for(auto& r : readers)
+    {
+        r.join();
+    }
+    acc.enable_hot_cache();
+    for(hash_t k = 0; k < num_hot; ++k)
+    {
+        uint64_t* v = acc.find_item_node(k);
+        check(nullptr != v && (*v >> 8) == k, "final find", k);
+    }
+}
+
+double time_lookups(solist_accessor<uint64_t>& acc, unsigned n)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for(unsigned i = 0; i < n; ++i)
+    {
+        // Most lookups to a few hot keys, spread across the table.
+        hash_t k = (i % 8) ? (i % num_hot) * 311 : i % num_keys;
+        uint64_t* v = acc.find_item_node(k);
+        sum += nullptr == v ? 0 : *v;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    check(0 != sum, "lookups", 0);
+    return elapsed.count();
+}
+
+void bench()
+{
+    constexpr unsigned n = 2000000;
+    solist_accessor<uint64_t> acc(2, 8);
+    for(hash_t k = 0; k < num_keys; ++k)
+    {
+        acc.insert_node(k, uint64_t(k) << 8);
+    }
+    double plain = time_lookups(acc, n);
+    acc.enable_hot_cache();
+    double cached = time_lookups(acc, n);
+    printf("%u lookups, bucket length 8: %.3fs, with hot cache %.3fs\n", n, plain, cached);
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    test_invalidation();
+    test_concurrent();
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+    return test_result();
+}
@@ -0,0 +1,183 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of value replacement, writers replace the items of keys with newer
+versions while readers look them up, keys must never be absent and the
+versions seen by a reader must never go back.
+With the argument bench, also times replace against delete and insert.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::solist_cdc;
+using   benedias::concurrent::solist_cdc_record;
+using   benedias::concurrent::solist_cdc_feed;
+using   benedias::concurrent::solist_cdc_insert;
+using   benedias::concurrent::solist_cdc_update;
+using   benedias::concurrent::solist_bucket_hints;
+using   benedias::concurrent::hash_t;
+
+constexpr unsigned num_writers = 4;
+constexpr unsigned num_readers = 2;
+constexpr unsigned num_keys = 256;
+constexpr unsigned num_versions = 200;
+
+inline uint64_t value_of(hash_t k, unsigned version)
+{
+    return (uint64_t(k) << 32) | version;
+}
+
+// Writer w replaces the keys k with k % num_writers == w.
+void writer(std::shared_ptr<solist<uint64_t>> table, unsigned w)
+{
+    solist_accessor<uint64_t> acc(table);
+    for(unsigned version = 1; version <= num_versions; ++version)
+    {
+        for(hash_t k = w; k < num_keys; k += num_writers)
+        {
+            check(acc.replace(k, value_of(k, version)), "replace", k);
+        }
+    }
+}
+
+void reader(std::shared_ptr<solist<uint64_t>> table, std::atomic<bool>& done)
+{
+    solist_accessor<uint64_t> acc(table);
+    std::vector<unsigned> seen(num_keys, 0);
+    while(!done.load())
+    {
+        for(hash_t k = 0; k < num_keys; ++k)
+        {
+            uint64_t* v = acc.find_item_node(k);
+            check(nullptr != v, "absent", k);
+            if (nullptr != v)
+            {
+                unsigned version = *v & 0xffffffff;
+                check((*v >> 32) == k, "reader key", k);
+                check(version >= seen[k], "version went back", k);
+                seen[k] = version;
+            }
+        }
+    }
+}
+
+void test_concurrent()
+{
+    auto table = std::make_shared<solist<uint64_t>>(2, 4, solist_cdc_feed | solist_bucket_hints);
+    // Rings large enough for every record.
+    table->set_change_feed(std::make_shared<solist_cdc<uint64_t>>(1u << 14));
+    solist_accessor<uint64_t> acc(table);
+    for(hash_t k = 0; k < num_keys; ++k)
+    {
+        check(acc.insert_or_assign(k, value_of(k, 0)), "insert_or_assign inserts", k);
+    }
+    check(!acc.replace(num_keys, 0), "replace absent", num_keys);
+    check(nullptr == acc.find_item_node(num_keys), "replace inserted", num_keys);
+
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    for(unsigned r = 0; r < num_readers; ++r)
+    {
+        threads.emplace_back(reader, table, std::ref(done));
+    }
+    std::vector<std::thread> writers;
+    for(unsigned w = 0; w < num_writers; ++w)
+    {
+        writers.emplace_back(writer, table, w);
+    }
+    for(auto& w : writers)
+    {
+        w.join();
+    }
+    done.store(true);
+    for(auto& r : threads)
+    {
+        r.join();
+    }
+
+    check(table->item_count() == num_keys, "item count", table->item_count());
+    for(hash_t k = 0; k < num_keys; ++k)
+    {
+        check(!acc.insert_or_assign(k, value_of(k, num_versions + 1)), "insert_or_assign assigns", k);
+        uint64_t* v = acc.find_item_node(k);
+        check(nullptr != v && *v == value_of(k, num_versions + 1), "final value", k);
+    }
+    check(table->item_count() == num_keys, "item count", table->item_count());
+
+    unsigned inserts = 0;
+    unsigned updates = 0;
+    table->change_feed()->drain([&](const solist_cdc_record<uint64_t>& rec){
+            inserts += rec.op == solist_cdc_insert;
+            updates += rec.op == solist_cdc_update;
+        });
+    check(inserts == num_keys, "cdc inserts", inserts);
+    check(updates == num_keys * (num_versions + 1), "cdc updates", updates);
+}
+
+void bench()
+{
+    constexpr unsigned nkeys = 100000;
+    constexpr unsigned rounds = 5;
+    solist_accessor<uint64_t> acc(std::make_shared<solist<uint64_t>>(2, 4));
+    for(hash_t k = 0; k < nkeys; ++k)
+    {
+        acc.insert_node(k, k);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned r = 0; r < rounds; ++r)
+    {
+        for(hash_t k = 0; k < nkeys; ++k)
+        {
+            acc.delete_node(k);
+            acc.insert_node(k, r);
+        }
+    }
+    std::chrono::duration<double> tdi = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for(unsigned r = 0; r < rounds; ++r)
+    {
+        for(hash_t k = 0; k < nkeys; ++k)
+        {
+            acc.replace(k, r);
+        }
+    }
+    std::chrono::duration<double> trep = std::chrono::steady_clock::now() - start;
+    printf("%u updates: delete and insert %.3fs, replace %.3fs\n", nkeys * rounds, tdi.count(), trep.count());
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    test_concurrent();
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+
+    return test_result();
+}
@@ -0,0 +1,195 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of sequence locked payloads, writers update the fields of structs in
+place while readers copy them, a copy must never mix fields of different
+updates, and no update may be lost.
+With the argument bench, also times in place updates against replacing the node.
+*/
+#include "solist_seqlock.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::solist_seqlock;
+using   benedias::concurrent::solist_seqlock_accessor;
+using   benedias::concurrent::solist_cdc_record;
+using   benedias::concurrent::solist_cdc_feed;
+using   benedias::concurrent::solist_cdc_update;
+using   benedias::concurrent::hash_t;
+
+constexpr unsigned num_writers = 4;
+constexpr unsigned num_readers = 2;
+constexpr unsigned num_keys = 64;
+constexpr unsigned num_updates = 500;
+
+// The fields are consistent if y and z are multiples of x.
+struct position
+{
+    double      x;
+    double      y;
+    double      z;
+    uint64_t    n;
+};
+
+inline bool consistent(const position& p)
+{
+    return p.y == 2 * p.x && p.z == 3 * p.x && p.x == double(p.n);
+}
+
+using table_type = solist<solist_seqlock<position>>;
+using accessor_type = solist_seqlock_accessor<position>;
+
+// Every writer updates every key.
+void writer(std::shared_ptr<table_type> table)
+{
+    accessor_type acc(table);
+    for(unsigned u = 0; u < num_updates; ++u)
+    {
+        for(hash_t k = 0; k < num_keys; ++k)
+        {
+            check(acc.update(k, [](position& p){
+                        ++p.n;
+                        p.x = double(p.n);
+                        p.y = 2 * p.x;
+                        p.z = 3 * p.x;
+                    }), "update", k);
+        }
+    }
+}
+
+void reader(std::shared_ptr<table_type> table, std::atomic<bool>& done)
+{
+    accessor_type acc(table);
+    std::vector<uint64_t> seen(num_keys, 0);
+    while(!done.load())
+    {
+        for(hash_t k = 0; k < num_keys; ++k)
+        {
+            position p{};
+            check(acc.read(k, p), "read", k);
+            check(consistent(p), "torn read", k);
+            check(p.n >= seen[k], "update went back", k);
+            seen[k] = p.n;
+        }
+    }
+}
+
+void test_concurrent()
+{
+    auto table = std::make_shared<table_type>(2, 4, solist_cdc_feed);
+    accessor_type acc(table);
+    for(hash_t k = 0; k < num_keys; ++k)
+    {
+        check(acc.insert_node(k, position{0, 0, 0, 0}), "insert", k);
+    }
+    position p{};
+    check(!acc.read(num_keys, p) && !acc.write(num_keys, p), "absent key", num_keys);
+
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for(unsigned r = 0; r < num_readers; ++r)
+    {
+        readers.emplace_back(reader, table, std::ref(done));
+    }
+    std::vector<std::thread> writers;
+    for(unsigned w = 0; w < num_writers; ++w)
+    {
+        writers.emplace_back(writer, table);
+    }
+    for(auto& w : writers)
+    {
+        w.join();
+    }
+    done.store(true);
+    for(auto& r : readers)
+    {
+        r.join();
+    }
+
+    for(hash_t k = 0; k < num_keys; ++k)
+    {
+        check(acc.read(k, p) && consistent(p) && p.n == num_writers * num_updates, "lost update", k);
+    }
+    check(acc.write(0, position{1, 2, 3, 1}) && acc.read(0, p) && 1 == p.n, "write", 0);
+
+    // Changes are recorded, the feed keeps the latest records.
+    unsigned updates = 0;
+    table->change_feed()->drain([&](const solist_cdc_record<solist_seqlock<position>>& rec){
+            position v;
+            rec.payload.load(v);
+            check(consistent(v), "cdc record", rec.hashv);
+            updates += rec.op == solist_cdc_update;
+        });
+    check(0 != updates, "cdc updates", updates);
+}
+
+void bench()
+{
+    constexpr unsigned nkeys = 10000;
+    constexpr unsigned rounds = 50;
+    auto step = [](position& p){ ++p.n; p.x = double(p.n); p.y = 2 * p.x; p.z = 3 * p.x; };
+    accessor_type sacc(std::make_shared<table_type>(2, 4));
+    solist_accessor<position> racc(std::make_shared<solist<position>>(2, 4));
+    for(hash_t k = 0; k < nkeys; ++k)
+    {
+        sacc.insert_node(k, position{0, 0, 0, 0});
+        racc.insert_node(k, position{0, 0, 0, 0});
+    }
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned r = 0; r < rounds; ++r)
+    {
+        for(hash_t k = 0; k < nkeys; ++k)
+        {
+            sacc.update(k, step);
+        }
+    }
+    std::chrono::duration<double> tin = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for(unsigned r = 0; r < rounds; ++r)
+    {
+        for(hash_t k = 0; k < nkeys; ++k)
+        {
+            position p = *racc.find_item_node(k);
+            step(p);
+            racc.replace(k, p);
+        }
+    }
+    std::chrono::duration<double> trep = std::chrono::steady_clock::now() - start;
+    printf("%u updates: in place %.3fs, replacing the node %.3fs\n", nkeys * rounds, tin.count(), trep.count());
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    test_concurrent();
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+
+    return test_result();
+}
@@ -0,0 +1,159 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the teardown policies, every payload of a destroyed table must
+be destroyed exactly once, by the serial, parallel and background
+teardown, for expandable and fixed directories.
+With the argument bench, also times the destruction of a large table with each policy.
+*/
+#include "solist.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <memory>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_fixed;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::solist_bucket_hints;
+using   benedias::concurrent::solist_reaper;
+using   benedias::concurrent::solist_teardown_policy;
+using   benedias::concurrent::hash_t;
+
+// Number of payloads alive.
+std::atomic<int64_t> live{0};
+
+struct counted
+{
+    uint64_t    value;
+
+    counted(uint64_t v=0):value(v)
+    {
+        ++live;
+    }
+
+    counted(const counted& other):value(other.value)
+    {
+        ++live;
+    }
+
+    ~counted()
+    {
+        --live;
+    }
+};
+
+std::clock_t thread_cpu()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::clock_t(ts.tv_sec) * CLOCKS_PER_SEC + ts.tv_nsec / (1000000000 / CLOCKS_PER_SEC);
+}
+
+const char* policy_name(solist_teardown_policy policy)
+{
+    switch(policy)
+    {
+        case solist_teardown_policy::serial:
+            return "serial";
+        case solist_teardown_policy::parallel:
+            return "parallel";
+        case solist_teardown_policy::background:
+            return "background";
+    }
+    return "";
+}
+
+template <typename L> void fill(std::shared_ptr<L> table, unsigned nkeys)
+{
+    solist_accessor<counted, typename std::remove_reference<decltype(table->buckets)>::type> acc(table);
+    for(hash_t k = 0; k < nkeys; ++k)
+    {
+        acc.insert_node(k, counted(k));
+    }
+    check(nkeys == table->item_count(), "item count", table->item_count());
+}
+
+template <typename L> void test_policy(std::shared_ptr<L> table, solist_teardown_policy policy,
+        unsigned threads, unsigned nkeys)
+{
+    fill(table, nkeys);
+    check(nkeys == live.load(), "live before", live.load());
+    table->set_teardown(policy, threads);
+    table.reset();
+    solist_reaper::instance().wait();
+    check(0 == live.load(), policy_name(policy), live.load());
+}
+
+void test_policies()
+{
+    constexpr unsigned nkeys = 20000;
+    for(auto policy : {solist_teardown_policy::serial, solist_teardown_policy::parallel,
+            solist_teardown_policy::background})
+    {
+        for(unsigned threads : {0u, 1u, 7u})
+        {
+            test_policy(std::make_shared<solist<counted>>(2, 4), policy, threads, nkeys);
+            test_policy(std::make_shared<solist<counted>>(2, 4, solist_bucket_hints), policy, threads, nkeys);
+            test_policy(std::make_shared<solist_fixed<counted, 1 << 16>>(1 << 16, 4), policy, threads, nkeys);
+            test_policy(std::make_shared<solist<counted>>(2, 4), policy, threads, 100);
+        }
+        // Few of the slots initialised, most ranges merge.
+        test_policy(std::make_shared<solist<counted>>(1 << 12, 1 << 12), policy, 4, nkeys);
+    }
+}
+
+void bench()
+{
+    constexpr unsigned nkeys = 2000000;
+    for(auto policy : {solist_teardown_policy::serial, solist_teardown_policy::parallel,
+            solist_teardown_policy::background})
+    {
+        auto table = std::make_shared<solist<counted>>(2, 4);
+        fill(table, nkeys);
+        table->set_teardown(policy, 4);
+        auto start = std::chrono::steady_clock::now();
+        std::clock_t cpu_start = thread_cpu();
+        table.reset();
+        // The destroying thread may be descheduled in favour of the
+        // threads it started, its CPU time is the cost to the caller.
+        double tcpu = double(thread_cpu() - cpu_start) / CLOCKS_PER_SEC;
+        std::chrono::duration<double> treturn = std::chrono::steady_clock::now() - start;
+        solist_reaper::instance().wait();
+        std::chrono::duration<double> tfreed = std::chrono::steady_clock::now() - start;
+        check(0 == live.load(), "bench", live.load());
+        printf("%u items %s teardown: returned in %.3fs, %.3fs CPU, freed in %.3fs\n",
+                nkeys, policy_name(policy), treturn.count(), tcpu, tfreed.count());
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    test_policies();
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+
+    return test_result();
+}
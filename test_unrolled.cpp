@@ -0,0 +1,235 @@
+/*
+
+Copyright (C) 2019  Blaise Dias
+
+This file is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+Test of the unrolled solist, threads concurrently insert, find and
+delete on interleaved keys, so chunks are shared between threads, while
+reader threads look up all keys.
+The list is then checked, keys must be in order, every initialised
+bucket sentinel must be in the list, and no chunk may span a sentinel.
+With the argument bench, also times lookups against a solist with the same bucket length.
+*/
+#include "solist_unrolled.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using   benedias::concurrent::solist;
+using   benedias::concurrent::solist_accessor;
+using   benedias::concurrent::solist_unrolled;
+using   benedias::concurrent::solist_unrolled_accessor;
+using   benedias::concurrent::solist_bucket;
+using   benedias::concurrent::solist_node;
+using   benedias::concurrent::solist_chunk;
+using   benedias::concurrent::hash_t;
+using   benedias::concurrent::so_key;
+
+constexpr unsigned num_threads = 4;
+constexpr unsigned num_readers = 2;
+constexpr unsigned num_keys = 3000;
+constexpr unsigned num_rounds = 4;
+
+// Keys of thread t are t, t + num_threads, ...
+void writer(std::shared_ptr<solist_unrolled<uint64_t>> table, unsigned t)
+{
+    solist_unrolled_accessor<uint64_t> acc(table);
+    uint64_t v;
+    for(unsigned i = 0; i < num_keys; ++i)
+    {
+        hash_t k = i * num_threads + t;
+        check(acc.insert_node(k, uint64_t(k) << 8), "insert", k);
+    }
+    for(uint32_t round = 1; round <= num_rounds; ++round)
+    {
+        for(unsigned i = round & 1; i < num_keys; i += 2)
+        {
+            hash_t k = i * num_threads + t;
+            check(acc.delete_node(k), "delete", k);
+            check(!acc.find_item(k, &v), "found deleted", k);
+            check(!acc.delete_node(k), "deleted twice", k);
+            check(acc.insert_node(k, (uint64_t(k) << 8) | round), "reinsert", k);
+            check(!acc.insert_node(k, 0), "duplicate insert", k);
+        }
+    }
+    for(unsigned i = 0; i < num_keys; ++i)
+    {
+        hash_t k = i * num_threads + t;
+        uint64_t expected = (uint64_t(k) << 8) | ((i & 1) ? num_rounds - 1 : num_rounds);
+        check(acc.find_item(k, &v) && v == expected, "find", k);
+    }
+}
+
+void reader(std::shared_ptr<solist_unrolled<uint64_t>> table, std::atomic<bool>& done)
+{
+    solist_unrolled_accessor<uint64_t> acc(table);
+    uint64_t v;
+    while(!done.load())
+    {
+        for(hash_t k = 0; k < num_threads * num_keys; k += 5)
+        {
+            // keys inserted before the readers started are never absent.
+            bool found = acc.find_item(k, &v);
+            check(!found || (v >> 8) == k, "reader value", k);
+        }
+    }
+}
+
+void check_list(solist_unrolled<uint64_t>& table)
+{
+    using chunk = solist_node<solist_chunk<uint64_t, 4>>;
+    unsigned items = 0;
+    unsigned chunks = 0;
+    so_key last = 0;
+    bool first = true;
+    solist_bucket* sentinel = nullptr;
+    for(solist_bucket* n = table.buckets[0]; nullptr != n; n = n->next.load())
+    {
+        bool marked;
+        n->next.load(&marked);
+        check(!marked, "marked node", n->key);
+        if (n->is_node())
+        {
+            chunk* c = static_cast<chunk*>(n);
+            ++chunks;
+            check(c->count > 0 && c->keys[0] == c->key, "chunk key", c->key);
+            for(uint32_t i = 0; i < c->count; ++i)
+            {
+                check(first || c->keys[i] > last, "key order", c->keys[i]);
+                last = c->keys[i];
+                first = false;
+                ++items;
+                // the bucket of the key, at the current size, must be
+                // the last sentinel, or an uninitialised descendant.
+                hash_t hashv = benedias::concurrent::reverse_hasht_bits(c->keys[i] & ~1u);
+                uint32_t slot = hashv % table.buckets.size();
+                while(nullptr == table.buckets[slot])
+                {
+                    slot &= ~(1u << (31 - __builtin_clz(slot)));
+                }
+                check(table.buckets[slot] == sentinel, "chunk spans a sentinel", hashv);
+            }
+        }
+        else
+        {
+            check(first || n->key > last, "sentinel order", n->key);
+            last = n->key;
+            first = false;
+            sentinel = n;
+            check(table.buckets[n->hashv()] == n, "sentinel slot", n->hashv());
+        }
+    }
+    check(items == table.item_count(), "item count", items);
+    std::cout << "items " << items << " chunks " << chunks << " buckets "
+        << table.buckets.size() << std::endl;
+}
+
+template <typename A> double time_lookups(A& acc, unsigned n)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t v;
+    uint64_t sum = 0;
+    for(unsigned i = 0; i < n; ++i)
+    {
+        if (acc.find_item(i % (num_threads * num_keys), &v))
+        {
+            sum += v;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    check(0 != sum, "lookups", 0);
+    return elapsed.count();
+}
+
+// find_item for a solist, to time both with the same code.
+struct solist_finder
+{
+    solist_accessor<uint64_t> acc;
+    bool find_item(hash_t k, uint64_t* v)
+    {
+        uint64_t* p = acc.find_item_node(k);
+        if (nullptr != p)
+        {
+            *v = *p;
+        }
+        return nullptr != p;
+    }
+};
+
+void bench()
+{
+    constexpr unsigned n = 1000000;
+    constexpr uint32_t bucket_length = 8;
+    solist_unrolled_accessor<uint64_t> unrolled(2, bucket_length);
+    solist_finder plain{solist_accessor<uint64_t>(2, bucket_length)};
+    for(hash_t k = 0; k < num_threads * num_keys; ++k)
+    {
+        unrolled.insert_node(k, k + 1);
+        plain.acc.insert_node(k, k + 1);
+    }
+    double tp = time_lookups(plain, n);
+    double tu = time_lookups(unrolled, n);
+    printf("%u lookups, bucket length %u: solist %.3fs, unrolled %.3fs\n", n, bucket_length, tp, tu);
+}
+
+int main( int argc, char* argv[] )
+{
+    std::setlocale(LC_ALL, "en_US.UTF-8");
+    std::cout << "chunk size " << sizeof(solist_node<solist_chunk<uint64_t, 4>>) << std::endl;
+    auto table = std::make_shared<solist_unrolled<uint64_t>>(2);
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+    std::vector<std::thread> readers;
+    for(unsigned r = 0; r < num_readers; ++r)
+    {
+        readers.emplace_back(reader, table, std::ref(done));
+    }
+    for(unsigned t = 0; t < num_threads; ++t)
+    {
+        writers.emplace_back(writer, table, t);
+    }
+    for(auto& w : writers)
+    {
+        w.join();
+    }
+    done.store(true);
+    for(auto& r : readers)
+    {
+        r.join();
+    }
+    // Unlink any chunks left marked by failed unlinks.
+    {
+        solist_unrolled_accessor<uint64_t> acc(table);
+        uint64_t v;
+        for(hash_t k = 0; k < num_threads * num_keys; ++k)
+        {
+            acc.find_item(k, &v);
+        }
+    }
+    check_list(*table);
+    if (bench_requested(argc, argv))
+    {
+        bench();
+    }
+
+    return test_result();
+}